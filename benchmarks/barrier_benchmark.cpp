@@ -0,0 +1,132 @@
+#include <pthread.h>
+
+#if defined(__has_include)
+#	if __has_include(<barrier>) && __cplusplus > 201703L
+#		include <barrier>
+#		define FUTEX_BENCHMARK_STD_BARRIER
+#	endif
+#endif
+
+#include "benchmark_common.hpp"
+#include "../include/futex_barrier.hpp"
+#include "../include/futex_condition_variable.hpp"
+
+namespace
+{
+
+//! Generation-counting barrier made from futex_mutex and futex_condition_variable
+class cv_barrier
+{
+	using mutex_t = futex_mutex< shared_policy::inprocess >;
+
+public:
+	explicit cv_barrier(std::uint32_t expected) : m_expected(expected) {}
+
+	void arrive_and_wait()
+	{
+		futex_mutex_unique_lock< mutex_t > lock(m_mutex);
+		const std::uint32_t generation = m_generation;
+		if (++m_arrived == m_expected)
+		{
+			m_arrived = 0u;
+			++m_generation;
+			lock.unlock();
+			m_cond.notify_all();
+			return;
+		}
+		m_cond.wait(lock, [&]() { return m_generation != generation; });
+	}
+
+private:
+	mutex_t m_mutex;
+	futex_condition_variable< shared_policy::inprocess > m_cond;
+	const std::uint32_t m_expected;
+	std::uint32_t m_arrived{0u};
+	std::uint32_t m_generation{0u};
+};
+
+//! pthread_barrier_t wrapper with futex_barrier interface
+class pthread_barrier_wrapper
+{
+public:
+	explicit pthread_barrier_wrapper(std::uint32_t expected) { ::pthread_barrier_init(&m_barrier, nullptr, expected); }
+	~pthread_barrier_wrapper() { ::pthread_barrier_destroy(&m_barrier); }
+
+	pthread_barrier_wrapper(const pthread_barrier_wrapper&) = delete;
+	pthread_barrier_wrapper& operator=(const pthread_barrier_wrapper&) = delete;
+
+	void arrive_and_wait() { ::pthread_barrier_wait(&m_barrier); }
+
+private:
+	pthread_barrier_t m_barrier;
+};
+
+#if defined(FUTEX_BENCHMARK_STD_BARRIER)
+//! std::barrier wrapper with futex_barrier interface
+class std_barrier_wrapper
+{
+public:
+	explicit std_barrier_wrapper(std::uint32_t expected) : m_barrier(expected) {}
+
+	void arrive_and_wait() { m_barrier.arrive_and_wait(); }
+
+private:
+	std::barrier<> m_barrier;
+};
+#endif
+
+//! `threads` threads pass opts.iterations phases with short or long work between them.
+//! Latency is the time of one phase, fairness is not applicable.
+template< typename Barrier >
+void barrier_phase(const benchmark_options& opts, const char* name)
+{
+	for (auto cs : { critical_section::short_cs, critical_section::long_cs })
+	{
+		for (auto threads : opts.thread_counts(2u))
+		{
+			Barrier barrier(threads);
+			std::vector< std::thread > workers;
+			auto begin = std::chrono::steady_clock::now();
+			for (std::uint32_t id = 0; id < threads; ++id)
+			{
+				workers.emplace_back([&]() {
+					std::uint64_t local{0u};
+					for (std::uint32_t phase = 0; phase < opts.iterations; ++phase)
+					{
+						do_work(cs, local);
+						barrier.arrive_and_wait();
+					}
+				});
+			}
+			for (auto&& w : workers)
+				w.join();
+			auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+			benchmark_result r{};
+			r.benchmark = "barrier_phase";
+			r.primitive = name;
+			r.threads = threads;
+			r.params = to_string(cs);
+			r.ops_per_sec = opts.iterations / elapsed;
+			r.latency_ns = elapsed * 1e9 / opts.iterations;
+			r.fairness = 1.;
+			print_result(opts, r);
+		}
+	}
+}
+
+} // namespace
+
+
+void run_barrier_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("barrier_phase"))
+		return;
+
+	barrier_phase< futex_barrier< shared_policy::inprocess > >(opts, "futex_barrier<inprocess>");
+	barrier_phase< cv_barrier >(opts, "futex_mutex+futex_cv");
+#if defined(FUTEX_BENCHMARK_STD_BARRIER)
+	barrier_phase< std_barrier_wrapper >(opts, "std::barrier");
+#endif
+	barrier_phase< pthread_barrier_wrapper >(opts, "pthread_barrier_t");
+}
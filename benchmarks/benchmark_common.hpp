@@ -0,0 +1,221 @@
+#ifndef FUTEX_BENCHMARK_COMMON_HPP_
+#define FUTEX_BENCHMARK_COMMON_HPP_
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Benchmark run options (filled from the command line)
+struct benchmark_options
+{
+	//! Maximum number of threads, benchmarks run at 1, 2, 4 ... max_threads
+	std::uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	//! Duration of one throughput measurement
+	std::chrono::milliseconds duration{200};
+	//! Number of iterations for latency and ping-pong measurements
+	std::uint32_t iterations = 2000u;
+	//! Run only benchmarks whose name contains this substring
+	std::string filter;
+	//! Print results as csv
+	bool csv = false;
+
+	bool enabled(const std::string& name) const
+	{
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+
+	//! Thread counts for the scaling runs: powers of two and max_threads itself
+	std::vector< std::uint32_t > thread_counts(std::uint32_t min_threads = 1u) const
+	{
+		std::vector< std::uint32_t > res;
+		for (std::uint32_t n = 1u; n < max_threads; n *= 2u)
+		{
+			if (n >= min_threads)
+				res.push_back(n);
+		}
+		res.push_back(std::max(max_threads, min_threads));
+		return res;
+	}
+};
+
+
+//! Critical section length
+enum class critical_section
+{
+	short_cs,
+	long_cs
+};
+
+inline const char* to_string(critical_section cs)
+{
+	return cs == critical_section::short_cs ? "short" : "long";
+}
+
+//! Emulates work inside (or outside) of a critical section
+inline void do_work(critical_section cs, std::uint64_t& counter)
+{
+	if (cs == critical_section::short_cs)
+	{
+		++counter;
+		return;
+	}
+
+	// ~1us of dependent arithmetic on a modern core
+	volatile std::uint64_t acc = counter;
+	for (int i = 0; i < 1000; ++i)
+		acc = acc * 6364136223846793005ull + 1442695040888963407ull;
+	counter = acc + 1;
+}
+
+inline std::int64_t now_ns()
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//! One row of a report
+struct benchmark_result
+{
+	std::string benchmark;
+	std::string primitive;
+	std::uint32_t threads;
+	std::string params;
+	//! Throughput (operations per second), 0 if not applicable
+	double ops_per_sec;
+	//! Latency in nanoseconds (mean or median), 0 if not applicable
+	double latency_ns;
+	//! Tail latency (99th percentile), 0 if not applicable
+	double p99_ns;
+	//! min/max per-thread operations ratio, 1 - perfectly fair
+	double fairness;
+};
+
+inline void print_header(const benchmark_options& opts)
+{
+	if (opts.csv)
+		std::printf("benchmark,primitive,threads,params,ops_per_sec,latency_ns,p99_ns,fairness\n");
+	else
+		std::printf("%-18s %-34s %7s %-10s %14s %12s %12s %8s\n",
+			"benchmark", "primitive", "threads", "params", "ops/s", "latency,ns", "p99,ns", "fairness");
+}
+
+inline void print_result(const benchmark_options& opts, const benchmark_result& r)
+{
+	if (opts.csv)
+		std::printf("%s,%s,%u,%s,%.0f,%.1f,%.1f,%.3f\n",
+			r.benchmark.c_str(), r.primitive.c_str(), r.threads, r.params.c_str(),
+			r.ops_per_sec, r.latency_ns, r.p99_ns, r.fairness);
+	else
+		std::printf("%-18s %-34s %7u %-10s %14.0f %12.1f %12.1f %8.3f\n",
+			r.benchmark.c_str(), r.primitive.c_str(), r.threads, r.params.c_str(),
+			r.ops_per_sec, r.latency_ns, r.p99_ns, r.fairness);
+	std::fflush(stdout);
+}
+
+
+//! Runs `threads` copies of body(id, stop_flag) for opts.duration.
+//! body returns number of operations done by the thread.
+template< typename Body >
+benchmark_result run_for_duration(const benchmark_options& opts, std::uint32_t threads, Body body)
+{
+	std::atomic< bool > start{false}, stop{false};
+	std::vector< std::uint64_t > ops(threads, 0u);
+	std::vector< std::thread > workers;
+	workers.reserve(threads);
+
+	for (std::uint32_t i = 0; i < threads; ++i)
+	{
+		workers.emplace_back([&, i]() {
+			while (!start.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			ops[i] = body(i, stop);
+		});
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	start.store(true, std::memory_order_release);
+	std::this_thread::sleep_for(opts.duration);
+	stop.store(true, std::memory_order_release);
+	for (auto&& w : workers)
+		w.join();
+	auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+	std::uint64_t total = 0u, mn = ops.front(), mx = ops.front();
+	for (auto v : ops)
+	{
+		total += v;
+		mn = std::min(mn, v);
+		mx = std::max(mx, v);
+	}
+
+	benchmark_result r{};
+	r.threads = threads;
+	r.ops_per_sec = total / elapsed;
+	r.latency_ns = total ? elapsed * 1e9 * threads / total : 0.;
+	r.fairness = mx ? static_cast< double >(mn) / mx : 0.;
+	return r;
+}
+
+//! Median and 99th percentile of samples (in nanoseconds)
+inline void percentiles(std::vector< std::int64_t >& samples, double& median, double& p99)
+{
+	if (samples.empty())
+	{
+		median = p99 = 0.;
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	median = samples[samples.size() / 2];
+	p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+}
+
+
+//! pthread mutex wrapper with lock/unlock interface
+class pthread_mutex_wrapper
+{
+public:
+	explicit pthread_mutex_wrapper(bool adaptive = false)
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+#if defined(PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP)
+		if (adaptive)
+			pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#else
+		(void)adaptive;
+#endif
+		pthread_mutex_init(&m_mutex, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+	~pthread_mutex_wrapper() { pthread_mutex_destroy(&m_mutex); }
+
+	pthread_mutex_wrapper(const pthread_mutex_wrapper&) = delete;
+	pthread_mutex_wrapper& operator=(const pthread_mutex_wrapper&) = delete;
+
+	void lock() { pthread_mutex_lock(&m_mutex); }
+	void unlock() { pthread_mutex_unlock(&m_mutex); }
+
+private:
+	pthread_mutex_t m_mutex;
+};
+
+
+//! Benchmark groups
+void run_mutex_benchmarks(const benchmark_options& opts);
+void run_condition_variable_benchmarks(const benchmark_options& opts);
+void run_semaphore_benchmarks(const benchmark_options& opts);
+void run_shared_mutex_benchmarks(const benchmark_options& opts);
+void run_barrier_benchmarks(const benchmark_options& opts);
+void run_event_benchmarks(const benchmark_options& opts);
+void run_queue_benchmarks(const benchmark_options& opts);
+void run_thread_pool_benchmarks(const benchmark_options& opts);
+
+#endif
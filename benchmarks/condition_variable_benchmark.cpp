@@ -0,0 +1,87 @@
+#include <mutex>
+#include <condition_variable>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_condition_variable.hpp"
+#include "../include/futex_fifo_condition_variable.hpp"
+
+namespace
+{
+
+//! Token passing between `threads` threads through one mutex and one condition variable.
+//! Two threads use notify_one (classic ping-pong), more threads use notify_all.
+template< typename Mutex, typename Cond, typename Lock >
+benchmark_result cv_ring(const benchmark_options& opts, std::uint32_t threads)
+{
+	Mutex mutex;
+	Cond cond;
+	std::uint32_t turn{0u};
+	const std::uint32_t passes = opts.iterations * threads;
+	std::uint32_t done{0u};
+
+	std::vector< std::thread > workers;
+	auto begin = std::chrono::steady_clock::now();
+	for (std::uint32_t id = 0; id < threads; ++id)
+	{
+		workers.emplace_back([&, id]() {
+			for (;;)
+			{
+				Lock lock(mutex);
+				cond.wait(lock, [&]() { return turn == id || done >= passes; });
+				if (done >= passes)
+				{
+					lock.unlock();
+					cond.notify_all();
+					return;
+				}
+				turn = (turn + 1u) % threads;
+				++done;
+				lock.unlock();
+				if (threads == 2u)
+					cond.notify_one();
+				else
+					cond.notify_all();
+			}
+		});
+	}
+	for (auto&& w : workers)
+		w.join();
+	auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+	benchmark_result r{};
+	r.threads = threads;
+	r.ops_per_sec = passes / elapsed;
+	r.latency_ns = elapsed * 1e9 / passes;
+	r.fairness = 1.;
+	return r;
+}
+
+template< typename Mutex, typename Cond, typename Lock >
+void cv_pingpong(const benchmark_options& opts, const char* name)
+{
+	for (auto threads : opts.thread_counts(2u))
+	{
+		auto r = cv_ring< Mutex, Cond, Lock >(opts, threads);
+		r.benchmark = "cv_pingpong";
+		r.primitive = name;
+		r.params = threads == 2u ? "notify_one" : "notify_all";
+		print_result(opts, r);
+	}
+}
+
+} // namespace
+
+
+void run_condition_variable_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("cv_pingpong"))
+		return;
+
+	using futex_mutex_t = futex_mutex< shared_policy::inprocess >;
+	cv_pingpong< futex_mutex_t, futex_condition_variable< shared_policy::inprocess >, futex_mutex_unique_lock< futex_mutex_t > >(
+		opts, "futex_condition_variable");
+	cv_pingpong< futex_mutex_t, futex_fifo_condition_variable< shared_policy::inprocess >, futex_mutex_unique_lock< futex_mutex_t > >(
+		opts, "futex_fifo_condition_variable");
+	cv_pingpong< std::mutex, std::condition_variable, std::unique_lock< std::mutex > >(
+		opts, "std::condition_variable");
+}
@@ -0,0 +1,89 @@
+#include <mutex>
+#include <condition_variable>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_event.hpp"
+#include "../include/futex_condition_variable.hpp"
+
+namespace
+{
+
+//! Auto-reset event made from a mutex, a condition variable and a bool
+template< typename Mutex, typename Cond, typename Lock >
+class cv_event
+{
+public:
+	void set()
+	{
+		{
+			Lock lock(m_mutex);
+			m_signaled = true;
+		}
+		m_cond.notify_one();
+	}
+
+	void wait()
+	{
+		Lock lock(m_mutex);
+		m_cond.wait(lock, [&]() { return m_signaled; });
+		m_signaled = false;
+	}
+
+private:
+	Mutex m_mutex;
+	Cond m_cond;
+	bool m_signaled{false};
+};
+
+//! Two threads signal each other through two auto-reset events, latency is one round trip
+template< typename Event >
+void event_pingpong(const benchmark_options& opts, const char* name)
+{
+	Event ping, pong;
+	std::thread other([&]() {
+		for (std::uint32_t round = 0; round < opts.iterations; ++round)
+		{
+			ping.wait();
+			pong.set();
+		}
+	});
+
+	std::vector< std::int64_t > samples;
+	samples.reserve(opts.iterations);
+	auto begin = std::chrono::steady_clock::now();
+	for (std::uint32_t round = 0; round < opts.iterations; ++round)
+	{
+		const std::int64_t start = now_ns();
+		ping.set();
+		pong.wait();
+		samples.push_back(now_ns() - start);
+	}
+	auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+	other.join();
+
+	benchmark_result r{};
+	r.benchmark = "event_pingpong";
+	r.primitive = name;
+	r.threads = 2u;
+	r.params = "auto_reset";
+	r.ops_per_sec = opts.iterations / elapsed;
+	percentiles(samples, r.latency_ns, r.p99_ns);
+	r.fairness = 1.;
+	print_result(opts, r);
+}
+
+} // namespace
+
+
+void run_event_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("event_pingpong"))
+		return;
+
+	using futex_mutex_t = futex_mutex< shared_policy::inprocess >;
+	event_pingpong< futex_event< shared_policy::inprocess, futex_event_reset::automatic > >(opts, "futex_event<automatic>");
+	event_pingpong< cv_event< futex_mutex_t, futex_condition_variable< shared_policy::inprocess >, futex_mutex_unique_lock< futex_mutex_t > > >(
+		opts, "futex_mutex+futex_cv+bool");
+	event_pingpong< cv_event< std::mutex, std::condition_variable, std::unique_lock< std::mutex > > >(
+		opts, "std::mutex+std::cv+bool");
+}
@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "benchmark_common.hpp"
+
+namespace
+{
+
+void usage(const char* name)
+{
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --threads N       maximum number of threads (default: hardware concurrency)\n"
+		<< "  --duration-ms N   duration of one throughput run (default: 200)\n"
+		<< "  --iterations N    iterations of latency and ping-pong runs (default: 2000)\n"
+		<< "  --filter NAME     run only benchmarks which names contain NAME\n"
+		<< "                    (mutex_throughput, mutex_handoff, cv_pingpong, sem_throughput,\n"
+		<< "                    rwlock_throughput, barrier_phase, event_pingpong,\n"
+		<< "                    queue_throughput, ring_throughput, pool_task_graph)\n"
+		<< "  --csv             print results as csv\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	benchmark_options opts;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--threads") && has_value)
+			opts.max_threads = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--duration-ms") && has_value)
+			opts.duration = std::chrono::milliseconds(std::max(1, std::atoi(argv[++i])));
+		else if (!std::strcmp(argv[i], "--iterations") && has_value)
+			opts.iterations = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--filter") && has_value)
+			opts.filter = argv[++i];
+		else if (!std::strcmp(argv[i], "--csv"))
+			opts.csv = true;
+		else
+		{
+			usage(argv[0]);
+			return std::strcmp(argv[i], "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+	}
+
+	print_header(opts);
+	run_mutex_benchmarks(opts);
+	run_condition_variable_benchmarks(opts);
+	run_semaphore_benchmarks(opts);
+	run_shared_mutex_benchmarks(opts);
+	run_barrier_benchmarks(opts);
+	run_event_benchmarks(opts);
+	run_queue_benchmarks(opts);
+	run_thread_pool_benchmarks(opts);
+	return EXIT_SUCCESS;
+}
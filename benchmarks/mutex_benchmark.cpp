@@ -0,0 +1,117 @@
+#include <mutex>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_mutex.hpp"
+#include "../include/futex_pi_mutex.hpp"
+#include "../include/futex_robust_mutex.hpp"
+#include "../include/futex_queue_mutex.hpp"
+#include "../include/futex_byte_mutex.hpp"
+
+namespace
+{
+
+//! N threads lock/unlock the same mutex for opts.duration
+template< typename Mutex, typename... Args >
+void mutex_throughput(const benchmark_options& opts, const char* name, Args... args)
+{
+	for (auto cs : { critical_section::short_cs, critical_section::long_cs })
+	{
+		for (auto threads : opts.thread_counts())
+		{
+			Mutex mutex(args...);
+			std::uint64_t shared_counter{0u};
+			auto r = run_for_duration(opts, threads, [&](std::uint32_t, std::atomic< bool >& stop) {
+				std::uint64_t ops{0u};
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					mutex.lock();
+					do_work(cs, shared_counter);
+					mutex.unlock();
+					++ops;
+				}
+				return ops;
+			});
+			r.benchmark = "mutex_throughput";
+			r.primitive = name;
+			r.params = to_string(cs);
+			print_result(opts, r);
+		}
+	}
+}
+
+//! Time from unlock() by the owner to return from lock() in a parked waiter
+template< typename Mutex, typename... Args >
+void mutex_handoff(const benchmark_options& opts, const char* name, Args... args)
+{
+	Mutex mutex(args...);
+	std::atomic< int > phase{0};
+	std::atomic< std::int64_t > unlock_time{0};
+	std::vector< std::int64_t > samples;
+	samples.reserve(opts.iterations);
+
+	std::thread waiter([&]() {
+		for (std::uint32_t i = 0; i < opts.iterations; ++i)
+		{
+			while (phase.load(std::memory_order_acquire) != 1)
+				std::this_thread::yield();
+			mutex.lock();
+			samples.push_back(now_ns() - unlock_time.load(std::memory_order_relaxed));
+			mutex.unlock();
+			phase.store(2, std::memory_order_release);
+		}
+	});
+
+	for (std::uint32_t i = 0; i < opts.iterations; ++i)
+	{
+		mutex.lock();
+		phase.store(1, std::memory_order_release);
+		// give the waiter time to park inside lock()
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+		unlock_time.store(now_ns(), std::memory_order_relaxed);
+		mutex.unlock();
+		while (phase.load(std::memory_order_acquire) != 2)
+			std::this_thread::yield();
+	}
+	waiter.join();
+
+	benchmark_result r{};
+	r.benchmark = "mutex_handoff";
+	r.primitive = name;
+	r.threads = 2u;
+	r.params = "parked";
+	percentiles(samples, r.latency_ns, r.p99_ns);
+	print_result(opts, r);
+}
+
+} // namespace
+
+
+void run_mutex_benchmarks(const benchmark_options& opts)
+{
+	if (opts.enabled("mutex_throughput"))
+	{
+		mutex_throughput< futex_mutex< shared_policy::inprocess, false > >(opts, "futex_mutex<inprocess,false>");
+		mutex_throughput< futex_mutex< shared_policy::inprocess, true > >(opts, "futex_mutex<inprocess,true>");
+		mutex_throughput< futex_mutex< shared_policy::inprocess, true, fixed_backoff > >(opts, "futex_mutex<inprocess,true,fixed>");
+		mutex_throughput< futex_pi_mutex< shared_policy::inprocess > >(opts, "futex_pi_mutex<inprocess>");
+		mutex_throughput< futex_robust_mutex< shared_policy::interprocess > >(opts, "futex_robust_mutex<interprocess>");
+		mutex_throughput< futex_queue_mutex< shared_policy::inprocess > >(opts, "futex_queue_mutex<inprocess>");
+		mutex_throughput< futex_byte_mutex<> >(opts, "futex_byte_mutex");
+		mutex_throughput< std::mutex >(opts, "std::mutex");
+		mutex_throughput< pthread_mutex_wrapper >(opts, "pthread_mutex", false);
+		mutex_throughput< pthread_mutex_wrapper >(opts, "pthread_mutex(adaptive)", true);
+	}
+
+	if (opts.enabled("mutex_handoff"))
+	{
+		mutex_handoff< futex_mutex< shared_policy::inprocess, false > >(opts, "futex_mutex<inprocess,false>");
+		mutex_handoff< futex_mutex< shared_policy::inprocess, true > >(opts, "futex_mutex<inprocess,true>");
+		mutex_handoff< futex_pi_mutex< shared_policy::inprocess > >(opts, "futex_pi_mutex<inprocess>");
+		mutex_handoff< futex_robust_mutex< shared_policy::interprocess > >(opts, "futex_robust_mutex<interprocess>");
+		mutex_handoff< futex_queue_mutex< shared_policy::inprocess > >(opts, "futex_queue_mutex<inprocess>");
+		mutex_handoff< futex_byte_mutex<> >(opts, "futex_byte_mutex");
+		mutex_handoff< std::mutex >(opts, "std::mutex");
+		mutex_handoff< pthread_mutex_wrapper >(opts, "pthread_mutex", false);
+		mutex_handoff< pthread_mutex_wrapper >(opts, "pthread_mutex(adaptive)", true);
+	}
+}
@@ -0,0 +1,157 @@
+#include <cstring>
+#include <deque>
+#include <memory>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_mpmc_queue.hpp"
+#include "../include/futex_spsc_ring.hpp"
+#include "../include/futex_condition_variable.hpp"
+
+namespace
+{
+
+//! Items per producer in one run, in units of opts.iterations
+const std::uint32_t items_per_iteration = 50u;
+//! Capacity of the measured queues
+const std::size_t queue_capacity = 1024u;
+
+//! Bounded queue made from std::deque, futex_mutex and two condition variables
+class locked_queue
+{
+	using mutex_t = futex_mutex< shared_policy::inprocess >;
+
+public:
+	void push(std::uint64_t item)
+	{
+		futex_mutex_unique_lock< mutex_t > lock(m_mutex);
+		m_not_full.wait(lock, [&]() { return m_items.size() < queue_capacity; });
+		m_items.push_back(item);
+		lock.unlock();
+		m_not_empty.notify_one();
+	}
+
+	void pop(std::uint64_t& item)
+	{
+		futex_mutex_unique_lock< mutex_t > lock(m_mutex);
+		m_not_empty.wait(lock, [&]() { return !m_items.empty(); });
+		item = m_items.front();
+		m_items.pop_front();
+		lock.unlock();
+		m_not_full.notify_one();
+	}
+
+private:
+	mutex_t m_mutex;
+	futex_condition_variable< shared_policy::inprocess > m_not_empty;
+	futex_condition_variable< shared_policy::inprocess > m_not_full;
+	std::deque< std::uint64_t > m_items;
+};
+
+//! threads / 2 producers push items, threads / 2 consumers pop them, zeros stop the consumers
+template< typename Queue >
+void queue_throughput(const benchmark_options& opts, const char* name)
+{
+	for (auto threads : opts.thread_counts(2u))
+	{
+		const std::uint32_t producers = threads / 2u, consumers = threads - producers;
+		const std::uint64_t items = static_cast< std::uint64_t >(opts.iterations) * items_per_iteration;
+		auto queue = std::make_unique< Queue >();
+		std::vector< std::uint64_t > popped(consumers, 0u);
+		std::vector< std::thread > workers;
+		auto begin = std::chrono::steady_clock::now();
+		for (std::uint32_t id = 0; id < consumers; ++id)
+		{
+			workers.emplace_back([&, id]() {
+				std::uint64_t item{0u};
+				for (;;)
+				{
+					queue->pop(item);
+					if (!item)
+						return;
+					++popped[id];
+				}
+			});
+		}
+		std::vector< std::thread > pushers;
+		for (std::uint32_t id = 0; id < producers; ++id)
+		{
+			pushers.emplace_back([&]() {
+				for (std::uint64_t item = 1u; item <= items; ++item)
+					queue->push(item);
+			});
+		}
+		for (auto&& w : pushers)
+			w.join();
+		for (std::uint32_t id = 0; id < consumers; ++id)
+			queue->push(0u);
+		for (auto&& w : workers)
+			w.join();
+		auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+		const auto bounds = std::minmax_element(popped.begin(), popped.end());
+		benchmark_result r{};
+		r.benchmark = "queue_throughput";
+		r.primitive = name;
+		r.threads = threads;
+		r.params = "p=" + std::to_string(producers) + ",c=" + std::to_string(consumers);
+		r.ops_per_sec = items * producers / elapsed;
+		r.latency_ns = elapsed * 1e9 / (items * producers);
+		r.fairness = *bounds.second ? static_cast< double >(*bounds.first) / *bounds.second : 0.;
+		print_result(opts, r);
+	}
+}
+
+//! One producer writes records of record_size bytes in place, one consumer reads them in place
+template< std::size_t record_size >
+void ring_throughput(const benchmark_options& opts)
+{
+	using ring_t = futex_spsc_ring< shared_policy::interprocess, queue_capacity * 64u >;
+	const std::uint64_t records = static_cast< std::uint64_t >(opts.iterations) * items_per_iteration;
+	auto ring = std::make_unique< ring_t >();
+	auto begin = std::chrono::steady_clock::now();
+	std::thread consumer([&]() {
+		std::uint64_t sum{0u};
+		for (std::uint64_t record = 0; record < records; ++record)
+		{
+			const futex_ring_span span = ring->peek();
+			sum += static_cast< unsigned char >(span.data[0]);
+			ring->release();
+		}
+		(void)sum;
+	});
+	for (std::uint64_t record = 0; record < records; ++record)
+	{
+		const futex_ring_span span = ring->reserve(record_size);
+		std::memset(span.data, static_cast< int >(record), record_size);
+		ring->commit(record_size);
+	}
+	consumer.join();
+	auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+	benchmark_result r{};
+	r.benchmark = "ring_throughput";
+	r.primitive = "futex_spsc_ring<interprocess>";
+	r.threads = 2u;
+	r.params = std::to_string(record_size) + "B";
+	r.ops_per_sec = records / elapsed;
+	r.latency_ns = elapsed * 1e9 / records;
+	r.fairness = 1.;
+	print_result(opts, r);
+}
+
+} // namespace
+
+
+void run_queue_benchmarks(const benchmark_options& opts)
+{
+	if (opts.enabled("ring_throughput"))
+	{
+		ring_throughput< 16u >(opts);
+		ring_throughput< 256u >(opts);
+	}
+	if (!opts.enabled("queue_throughput"))
+		return;
+
+	queue_throughput< futex_mpmc_queue< shared_policy::inprocess, std::uint64_t, queue_capacity > >(opts, "futex_mpmc_queue<inprocess>");
+	queue_throughput< locked_queue >(opts, "deque+futex_mutex+futex_cv");
+}
@@ -0,0 +1,94 @@
+#include <semaphore.h>
+
+#if defined(__has_include)
+#	if __has_include(<semaphore>) && __cplusplus > 201703L
+#		include <semaphore>
+#		define FUTEX_BENCHMARK_STD_SEMAPHORE
+#	endif
+#endif
+
+#include "benchmark_common.hpp"
+#include "../include/futex_semaphore.hpp"
+#include "../include/futex_counting_semaphore.hpp"
+
+namespace
+{
+
+//! POSIX semaphore wrapper with futex_semaphore interface
+class posix_semaphore_wrapper
+{
+public:
+	explicit posix_semaphore_wrapper(std::int32_t limit) { ::sem_init(&m_sem, 0, limit); }
+	~posix_semaphore_wrapper() { ::sem_destroy(&m_sem); }
+
+	posix_semaphore_wrapper(const posix_semaphore_wrapper&) = delete;
+	posix_semaphore_wrapper& operator=(const posix_semaphore_wrapper&) = delete;
+
+	void wait() { while (::sem_wait(&m_sem) != 0 && errno == EINTR) {} }
+	void post() { ::sem_post(&m_sem); }
+
+private:
+	sem_t m_sem;
+};
+
+#if defined(FUTEX_BENCHMARK_STD_SEMAPHORE)
+//! std::counting_semaphore wrapper with futex_semaphore interface
+class std_semaphore_wrapper
+{
+public:
+	explicit std_semaphore_wrapper(std::int32_t limit) : m_sem(limit) {}
+
+	void wait() { m_sem.acquire(); }
+	void post() { m_sem.release(); }
+
+private:
+	std::counting_semaphore<> m_sem;
+};
+#endif
+
+//! N threads acquire/release a semaphore with `limit` simultaneous workers
+template< typename Semaphore >
+void semaphore_throughput(const benchmark_options& opts, const char* name)
+{
+	for (auto cs : { critical_section::short_cs, critical_section::long_cs })
+	{
+		for (auto threads : opts.thread_counts())
+		{
+			const std::int32_t limit = std::max(1u, threads / 2u);
+			Semaphore sem(limit);
+			std::atomic< std::uint64_t > shared_counter{0u};
+			auto r = run_for_duration(opts, threads, [&](std::uint32_t, std::atomic< bool >& stop) {
+				std::uint64_t ops{0u}, local{0u};
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					sem.wait();
+					do_work(cs, local);
+					shared_counter.fetch_add(1u, std::memory_order_relaxed);
+					sem.post();
+					++ops;
+				}
+				return ops;
+			});
+			r.benchmark = "sem_throughput";
+			r.primitive = name;
+			r.params = std::string(to_string(cs)) + ",k=" + std::to_string(limit);
+			print_result(opts, r);
+		}
+	}
+}
+
+} // namespace
+
+
+void run_semaphore_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("sem_throughput"))
+		return;
+
+	semaphore_throughput< futex_semaphore< shared_policy::inprocess > >(opts, "futex_semaphore<inprocess>");
+	semaphore_throughput< futex_counting_semaphore< shared_policy::inprocess > >(opts, "futex_counting_semaphore<inprocess>");
+#if defined(FUTEX_BENCHMARK_STD_SEMAPHORE)
+	semaphore_throughput< std_semaphore_wrapper >(opts, "std::counting_semaphore");
+#endif
+	semaphore_throughput< posix_semaphore_wrapper >(opts, "sem_t");
+}
@@ -0,0 +1,79 @@
+#include <shared_mutex>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_shared_mutex.hpp"
+
+namespace
+{
+
+//! pthread_rwlock_t wrapper with SharedLockable interface
+class pthread_rwlock_wrapper
+{
+public:
+	pthread_rwlock_wrapper() { pthread_rwlock_init(&m_rwlock, nullptr); }
+	~pthread_rwlock_wrapper() { pthread_rwlock_destroy(&m_rwlock); }
+
+	pthread_rwlock_wrapper(const pthread_rwlock_wrapper&) = delete;
+	pthread_rwlock_wrapper& operator=(const pthread_rwlock_wrapper&) = delete;
+
+	void lock() { pthread_rwlock_wrlock(&m_rwlock); }
+	void unlock() { pthread_rwlock_unlock(&m_rwlock); }
+	void lock_shared() { pthread_rwlock_rdlock(&m_rwlock); }
+	void unlock_shared() { pthread_rwlock_unlock(&m_rwlock); }
+
+private:
+	pthread_rwlock_t m_rwlock;
+};
+
+//! N threads take the lock shared in read_percent of operations and exclusively in the rest
+template< typename Mutex >
+void rwlock_throughput(const benchmark_options& opts, const char* name)
+{
+	for (std::uint32_t read_percent : { 90u, 99u, 100u })
+	{
+		for (auto threads : opts.thread_counts())
+		{
+			Mutex mutex;
+			std::uint64_t shared_counter{0u};
+			auto r = run_for_duration(opts, threads, [&](std::uint32_t, std::atomic< bool >& stop) {
+				std::uint64_t ops{0u}, local{0u};
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					if (ops % 100u < read_percent)
+					{
+						mutex.lock_shared();
+						local += shared_counter;
+						do_work(critical_section::short_cs, local);
+						mutex.unlock_shared();
+					}
+					else
+					{
+						mutex.lock();
+						do_work(critical_section::short_cs, shared_counter);
+						mutex.unlock();
+					}
+					++ops;
+				}
+				return ops;
+			});
+			r.benchmark = "rwlock_throughput";
+			r.primitive = name;
+			r.params = "reads=" + std::to_string(read_percent) + "%";
+			print_result(opts, r);
+		}
+	}
+}
+
+} // namespace
+
+
+void run_shared_mutex_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("rwlock_throughput"))
+		return;
+
+	rwlock_throughput< futex_shared_mutex< shared_policy::inprocess > >(opts, "futex_shared_mutex<inprocess>");
+	rwlock_throughput< futex_percpu_shared_mutex< shared_policy::inprocess > >(opts, "futex_percpu_shared_mutex<inprocess>");
+	rwlock_throughput< std::shared_mutex >(opts, "std::shared_mutex");
+	rwlock_throughput< pthread_rwlock_wrapper >(opts, "pthread_rwlock");
+}
@@ -0,0 +1,155 @@
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "benchmark_common.hpp"
+#include "../include/futex_latch.hpp"
+#include "../include/futex_thread_pool.hpp"
+
+namespace
+{
+
+//! Classic pool: one std::deque of std::function under a std::mutex, idle workers wait on a std::condition_variable
+class cv_thread_pool
+{
+public:
+	explicit cv_thread_pool(std::uint32_t threads)
+	{
+		for (std::uint32_t index = 0; index < threads; ++index)
+			m_threads.emplace_back([this]() { run_worker(); });
+	}
+
+	~cv_thread_pool()
+	{
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_stopping = true;
+		}
+		m_cond.notify_all();
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	template< typename F >
+	void submit(F&& f)
+	{
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_tasks.emplace_back(std::forward< F >(f));
+		}
+		m_cond.notify_one();
+	}
+
+private:
+	void run_worker()
+	{
+		for (;;)
+		{
+			std::function< void() > task;
+			{
+				std::unique_lock< std::mutex > lock(m_mutex);
+				m_cond.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+				if (m_tasks.empty())
+					return;
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque< std::function< void() > > m_tasks;
+	bool m_stopping{false};
+	std::vector< std::thread > m_threads;
+};
+
+//! Fine-grained task graph: every task spawns two children down to the leaves, the work per task is
+//! tiny or ~1us, so the scheduling cost (queueing, waking and parking workers) dominates
+template< typename Pool >
+struct task_tree
+{
+	void spawn(std::uint32_t level)
+	{
+		std::uint64_t counter = level;
+		do_work(cs, counter);
+		if (level == depth)
+		{
+			leaves->count_down();
+			return;
+		}
+		pool->submit([this, level]() { spawn(level + 1u); });
+		pool->submit([this, level]() { spawn(level + 1u); });
+	}
+
+	Pool* pool;
+	futex_latch< shared_policy::inprocess >* leaves;
+	std::uint32_t depth;
+	critical_section cs;
+};
+
+template< typename Pool, typename Factory >
+void pool_task_graph(const benchmark_options& opts, const char* name, Factory make_pool)
+{
+	const std::uint32_t depth = 12u;
+	const std::uint32_t tasks = (2u << depth) - 1u;
+	for (critical_section cs : { critical_section::short_cs, critical_section::long_cs })
+	{
+		for (std::uint32_t threads : opts.thread_counts())
+		{
+			std::unique_ptr< Pool > pool(make_pool(threads));
+			std::vector< std::int64_t > samples;
+			const std::uint32_t graphs = std::max(1u, opts.iterations / 100u);
+			samples.reserve(graphs);
+			auto begin = std::chrono::steady_clock::now();
+			for (std::uint32_t graph = 0; graph < graphs; ++graph)
+			{
+				const std::int64_t start = now_ns();
+				futex_latch< shared_policy::inprocess > leaves(1u << depth);
+				task_tree< Pool > tree{ pool.get(), &leaves, depth, cs };
+				pool->submit([&tree]() { tree.spawn(0u); });
+				leaves.wait();
+				samples.push_back(now_ns() - start);
+			}
+			auto elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - begin).count();
+
+			benchmark_result r{};
+			r.benchmark = "pool_task_graph";
+			r.primitive = name;
+			r.threads = threads;
+			r.params = to_string(cs);
+			r.ops_per_sec = static_cast< double >(tasks) * graphs / elapsed;
+			// latency of a whole graph
+			percentiles(samples, r.latency_ns, r.p99_ns);
+			r.fairness = 1.;
+			print_result(opts, r);
+		}
+	}
+}
+
+} // namespace
+
+
+void run_thread_pool_benchmarks(const benchmark_options& opts)
+{
+	if (!opts.enabled("pool_task_graph"))
+		return;
+
+	pool_task_graph< futex_thread_pool >(opts, "futex_thread_pool", [](std::uint32_t threads) {
+		futex_thread_pool_options options;
+		options.threads = threads;
+		return new futex_thread_pool(options);
+	});
+	pool_task_graph< futex_thread_pool >(opts, "futex_thread_pool<no_spin>", [](std::uint32_t threads) {
+		futex_thread_pool_options options;
+		options.threads = threads;
+		options.spin_time = std::chrono::nanoseconds(0);
+		return new futex_thread_pool(options);
+	});
+	pool_task_graph< cv_thread_pool >(opts, "std::mutex+std::cv+deque", [](std::uint32_t threads) {
+		return new cv_thread_pool(threads);
+	});
+}
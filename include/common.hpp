@@ -1,12 +1,13 @@
 #ifndef FUTEX_COMMON_HPP_
 #define FUTEX_COMMON_HPP_
 
-#include <immintrin.h>
-
 #include <cstring>
 #include <stdexcept>
 #include <atomic>
 
+#include <linux/futex.h>
+
+#include <boost/noncopyable.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/system/system_error.hpp>
 #include <boost/exception/info.hpp>
@@ -15,7 +16,7 @@
 
 //! Exception info wrapper
 template< typename ExceptionType >
-void throw_exception(const char* descr, const char* func, const char* file, std::uint32_t line)
+[[noreturn]] void throw_exception(const char* descr, const char* func, const char* file, std::uint32_t line)
 {
 	throw boost::enable_error_info(ExceptionType(descr)) << boost::throw_file(file) << boost::throw_line(line) << boost::throw_function(func);
 }
@@ -29,32 +30,6 @@ void throw_exception(const char* descr, const char* func, const char* file, std:
 #endif
 
 
-//! Spinlock pause function
-//! https://github.com/ifduyue/musl/blob/master/src/thread/pthread_spin_lock.c
-//! NOTE: very strange spinlock realisation via atomic CAS of temporary variable
-inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__)) spinlock_pause()
-{
-#if defined(USE_CAS_SPINLOCK)
-	std::atomic< std::uint32_t > tmp{0}; std::uint32_t tmp_ = 0;
-	std::atomic_compare_exchange_strong(&tmp, &tmp_, 0u);
-#elif defined(__linux__)
-	_mm_pause();
-#else
-#endif
-}
-
-
-//! On one-processor machine spinlock is dummy code
-inline bool __attribute__((__gnu_inline__, __always_inline__, __artificial__)) need_spinlock()
-{
-	long cores = ::sysconf(_SC_NPROCESSORS_ONLN);
-	//! On one-processor machine spinlock is dummy code
-	if (BOOST_UNLIKELY(cores == 1l))
-		return false;
-	return true;
-}
-
-
 //! The exception is used to indicate errors in futex syscall
 class futex_base_exception : public std::runtime_error
 {
@@ -75,6 +50,49 @@ public:
 };
 
 
+//! The exception is thrown to the new owner of a robust mutex whose previous owner died holding it.
+//! The mutex IS locked by the caller: repair the protected state, call consistent() and unlock.
+class futex_owner_dead : public futex_scoped_error
+{
+public:
+	futex_owner_dead() : futex_scoped_error("Previous owner of the mutex died") {}
+	explicit futex_owner_dead(const char* descr) : futex_scoped_error(descr) {}
+	~futex_owner_dead() noexcept = default;
+};
+
+
+//! The exception is used to indicate a robust mutex unlocked without consistent() after owner death
+class futex_not_recoverable : public futex_scoped_error
+{
+public:
+	futex_not_recoverable() : futex_scoped_error("Mutex is not recoverable") {}
+	explicit futex_not_recoverable(const char* descr) : futex_scoped_error(descr) {}
+	~futex_not_recoverable() noexcept = default;
+};
+
+
+//! Cache line size used to separate independently written data
+constexpr std::size_t futex_cache_line_size = 64u;
+
+
+namespace futex_detail
+{
+
+//! Holder of a policy object which is usually empty, e.g. futex_no_stats.
+//! A private base of this type costs no bytes if T is empty: [[no_unique_address]]
+//! would do the same for a member, but g++ before 9 ignores the attribute.
+//! index tells apart two holders of the same class.
+template< typename T, int index >
+class ebo_holder : private T
+{
+protected:
+	T& held() noexcept { return *this; }
+	const T& held() const noexcept { return *this; }
+};
+
+} // namespace futex_detail
+
+
 //! Access policy for futex-based synchronization primitives
 enum class shared_policy
 {
@@ -82,4 +100,32 @@ enum class shared_policy
 	interprocess	= 0x2u
 };
 
+
+//! Memory layout of a primitive
+enum class futex_layout
+{
+	//! the futex word with auxiliary data like spin statistics
+	standard,
+	//! only the futex word: dense arrays of per-record locks in shared memory
+	packed,
+	//! own cache line: no false sharing with the neighbour data
+	cache_aligned
+};
+
+
+//! Futex operations of the access policy, private ones let the kernel skip the shared mapping lookup
+template< shared_policy policy >
+struct futex_ops
+{
+	static constexpr bool is_private = (policy == shared_policy::inprocess);
+
+	static constexpr int wait = is_private ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT;
+	static constexpr int wait_bitset = is_private ? FUTEX_WAIT_BITSET_PRIVATE : FUTEX_WAIT_BITSET;
+	static constexpr int wake = is_private ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE;
+	static constexpr int cmp_requeue = is_private ? FUTEX_CMP_REQUEUE_PRIVATE : FUTEX_CMP_REQUEUE;
+	static constexpr int lock_pi = is_private ? FUTEX_LOCK_PI_PRIVATE : FUTEX_LOCK_PI;
+	static constexpr int trylock_pi = is_private ? FUTEX_TRYLOCK_PI_PRIVATE : FUTEX_TRYLOCK_PI;
+	static constexpr int unlock_pi = is_private ? FUTEX_UNLOCK_PI_PRIVATE : FUTEX_UNLOCK_PI;
+};
+
 #endif
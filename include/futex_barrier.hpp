@@ -0,0 +1,178 @@
+#ifndef FUTEX_BARRIER_HPP_
+#define FUTEX_BARRIER_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <cstdint>
+
+#include "common.hpp"
+#include "futex_spin_policy.hpp"
+
+//! Arrival token of futex_barrier::arrive, see futex_barrier::wait
+enum class futex_barrier_token : std::uint32_t {};
+
+//! Reusable sense-reversing barrier on a single futex word. Based on:
+//! https://www.cs.rochester.edu/u/scott/papers/1991_TOCS_synch.pdf (sense-reversing centralized barrier)
+//! https://github.com/bminor/glibc/blob/master/nptl/pthread_barrier_wait.c
+//!
+//! The word holds the sense, the expected and the arrived counts, so an arrival is one CAS.
+//! The last arrival resets the count and flips the sense, the others spin a bounded number
+//! of iterations on the sense and then sleep in futex on the whole word. Sleepers set a flag,
+//! the last arrival makes one FUTEX_WAKE per phase and only if somebody sleeps.
+//! Semantics of std::barrier without a completion function: arrive_and_wait, arrive_and_drop,
+//! arrive and wait for the split-phase use.
+//!
+//! shared policy: whether a barrier can synchronize different processes or not
+//! backoff: pause strategy while spinning on the sense, see futex_spin_policy.hpp
+//! NOTE: at most 32767 participants
+template< shared_policy policy, typename backoff = default_backoff >
+class futex_barrier : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Data layout: [ sense:1 | sleepers:1 | expected:15 | arrived:15 ]
+	enum : std::uint32_t
+	{
+		count_bits		= 15u,
+		count_mask		= (1u << count_bits) - 1u,
+		arrived_mask	= count_mask,
+		expected_shift	= count_bits,
+		sleepers_bit	= 1u << 30u,
+		sense_bit		= 1u << 31u
+	};
+
+	//! Spin attempts on the sense before sleeping
+	enum : std::uint32_t { spin_count = 100u };
+
+public:
+	//! Maximum number of participants
+	static constexpr std::uint32_t max() noexcept
+	{
+		return count_mask;
+	}
+
+	explicit futex_barrier(std::uint32_t expected) : m_state(expected << expected_shift)
+	{
+		if (!expected || expected > max())
+			THROW_EXCEPTION(futex_base_exception, "Barrier participants must be in [1, 32767]");
+		if (!m_state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	//! Arrives and waits for the other participants of the phase
+	void arrive_and_wait()
+	{
+		wait(arrive());
+	}
+
+	//! Arrives at the current phase and leaves the barrier: the next phases expect one participant less
+	void arrive_and_drop()
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			const std::uint32_t expected = expected_count(state) - 1u;
+			std::uint32_t next = (state & ~(count_mask << expected_shift)) | (expected << expected_shift);
+			const bool last = (state & arrived_mask) == expected;
+			if (last)
+				next = flip(next);
+			if (m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				if (last)
+					wake(state);
+				return;
+			}
+		}
+	}
+
+	//! Arrives without waiting, the token is passed to wait
+	futex_barrier_token arrive()
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			const bool last = (state & arrived_mask) + 1u == expected_count(state);
+			const std::uint32_t next = last ? flip(state) : state + 1u;
+			if (m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				if (last)
+					wake(state);
+				return static_cast< futex_barrier_token >(state & sense_bit);
+			}
+		}
+	}
+
+	//! Waits for the end of the phase of the token, the token must be of the current or the previous phase
+	void wait(futex_barrier_token token)
+	{
+		const std::uint32_t sense = static_cast< std::uint32_t >(token);
+		if (backoff::enabled())
+		{
+			backoff spin_backoff;
+			for (std::uint32_t spin = 0; spin < spin_count; ++spin)
+			{
+				if ((m_state.load(std::memory_order_acquire) & sense_bit) != sense)
+					return;
+				spin_backoff.pause();
+			}
+		}
+
+		std::uint32_t state = m_state.load(std::memory_order_acquire);
+		while ((state & sense_bit) == sense)
+		{
+			// the last arrival wakes only if the flag is set
+			if (!(state & sleepers_bit))
+			{
+				if (!m_state.compare_exchange_weak(state, state | sleepers_bit, std::memory_order_acquire, std::memory_order_acquire))
+					continue;
+				state |= sleepers_bit;
+			}
+
+			int res = futex(&m_state, ops::wait, static_cast< int >(state), nullptr, nullptr, 0);
+			if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			state = m_state.load(std::memory_order_acquire);
+		}
+	}
+
+	//! Participants expected in the current phase, for diagnostics
+	std::uint32_t expected() const noexcept
+	{
+		return expected_count(m_state.load(std::memory_order_relaxed));
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static std::uint32_t expected_count(std::uint32_t state) noexcept
+	{
+		return (state >> expected_shift) & count_mask;
+	}
+
+	//! Next phase: the sense flips, nobody arrived and nobody sleeps
+	static std::uint32_t flip(std::uint32_t state) noexcept
+	{
+		return (state ^ sense_bit) & ~(arrived_mask | sleepers_bit);
+	}
+
+	//! Wakes the sleepers of the completed phase, prev is the state before the flip
+	void wake(std::uint32_t prev) noexcept
+	{
+		if (prev & sleepers_bit)
+			futex(&m_state, ops::wake, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	//! Sense, sleepers flag, expected and arrived counts
+	std::atomic< std::uint32_t > m_state;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef FUTEX_BYTE_CONDITION_VARIABLE_HPP_
+#define FUTEX_BYTE_CONDITION_VARIABLE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "futex_parking_lot.hpp"
+#include "futex_condition_variable.hpp"
+
+//! One-byte in-process condition variable parking in futex_parking_lot, WebKit Condition design.
+//! The byte is only a hint whether somebody may be parked: notify without waiters is one load,
+//! the wait queue lives in the lot. Works with any lock which has lock() and unlock(),
+//! e.g. futex_mutex_unique_lock< futex_byte_mutex<> > or std::unique_lock.
+//! NOTE: notify_all wakes all the waiters at once, there is no room for the mutex address to requeue them
+class futex_byte_condition_variable : boost::noncopyable
+{
+public:
+	futex_byte_condition_variable() noexcept = default;
+
+	template< typename Lock >
+	void wait(Lock& lock)
+	{
+		wait_until(lock, nullptr);
+	}
+
+	template< typename Lock, typename Predicate >
+	void wait(Lock& lock, Predicate pred)
+	{
+		while (!pred())
+			wait(lock);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Lock, typename Clock, typename Duration >
+	futex_cv_status wait_until(Lock& lock, const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return wait_until(lock, &deadline);
+	}
+
+	template< typename Lock, typename Clock, typename Duration, typename Predicate >
+	bool wait_until(Lock& lock, const std::chrono::time_point< Clock, Duration >& timeout_time, Predicate pred)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		while (!pred())
+		{
+			if (wait_until(lock, &deadline) == futex_cv_status::timeout)
+				return pred();
+		}
+		return true;
+	}
+
+	template< typename Lock, typename Rep, typename Period >
+	futex_cv_status wait_for(Lock& lock, const std::chrono::duration< Rep, Period >& timeout_time)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return wait_until(lock, &deadline);
+	}
+
+	template< typename Lock, typename Rep, typename Period, typename Predicate >
+	bool wait_for(Lock& lock, const std::chrono::duration< Rep, Period >& timeout_time, Predicate pred)
+	{
+		return wait_until(lock, std::chrono::steady_clock::now() + std::chrono::duration_cast< std::chrono::steady_clock::duration >(timeout_time), pred);
+	}
+
+	void notify_one()
+	{
+		if (!m_has_waiters.load(std::memory_order_relaxed))
+			return;
+		futex_parking_lot::unpark_one(this, [this](const futex_unpark_result& res) -> std::intptr_t {
+			if (!res.more_parked)
+				m_has_waiters.store(0u, std::memory_order_relaxed);
+			return 0;
+		});
+	}
+
+	void notify_all()
+	{
+		if (!m_has_waiters.load(std::memory_order_relaxed))
+			return;
+		// a waiter parking after the store sets the hint again under the bucket lock
+		m_has_waiters.store(0u, std::memory_order_relaxed);
+		futex_parking_lot::unpark_all(this);
+	}
+
+private:
+	//! Parks until a notify or the deadline, the lock is released after the thread is queued
+	template< typename Lock >
+	futex_cv_status wait_until(Lock& lock, const futex_deadline* deadline)
+	{
+		const futex_park_result res = futex_parking_lot::park(this,
+			[this]() { m_has_waiters.store(1u, std::memory_order_relaxed); return true; },
+			[&lock]() { lock.unlock(); },
+			[this](bool more_parked) {
+				if (!more_parked)
+					m_has_waiters.store(0u, std::memory_order_relaxed);
+			},
+			deadline);
+		lock.lock();
+		return res.status == futex_park_status::timed_out ? futex_cv_status::timeout : futex_cv_status::no_timeout;
+	}
+
+	//! Whether a thread may be parked on the condition variable
+	std::atomic< std::uint8_t > m_has_waiters{0u};
+};
+
+static_assert(sizeof(futex_byte_condition_variable) == 1u, "futex_byte_condition_variable must be one byte");
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef FUTEX_BYTE_MUTEX_HPP_
+#define FUTEX_BYTE_MUTEX_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "futex_parking_lot.hpp"
+#include "futex_spin_policy.hpp"
+
+//! One-byte in-process mutex parking in futex_parking_lot, WebKit Lock design:
+//! https://webkit.org/blog/6161/locking-in-webkit/
+//! Two bits: locked and parked. Uncontended lock/unlock is one CAS, unlock goes to the
+//! parking lot only if a thread is parked. Waiters spin briefly while nobody is parked.
+//! Barging by default, eventually fair: when the lot reports be_fair the lock is handed
+//! over to the woken thread, so a parked thread waits about a millisecond at most.
+//! Zero-filled memory is an unlocked mutex.
+//!
+//! backoff: pause strategy between spin attempts, see futex_spin_policy.hpp
+template< typename backoff = default_backoff >
+class futex_byte_mutex : boost::noncopyable
+{
+	enum : std::uint8_t
+	{
+		locked_bit	= 1u,
+		parked_bit	= 2u
+	};
+
+	//! Spin attempts before parking
+	enum : std::uint32_t { spin_count = 40u };
+
+	//! Token of the unpark_one callback: the lock is handed over
+	enum : std::intptr_t { handoff_token = 1 };
+
+public:
+	futex_byte_mutex() noexcept = default;
+
+	void lock()
+	{
+		std::uint8_t state = 0u;
+		if (m_state.compare_exchange_weak(state, locked_bit, std::memory_order_acquire, std::memory_order_relaxed))
+			return;
+		lock_slow(nullptr);
+	}
+
+	bool try_lock() noexcept
+	{
+		std::uint8_t state = m_state.load(std::memory_order_relaxed);
+		while (!(state & locked_bit))
+		{
+			if (m_state.compare_exchange_weak(state, state | locked_bit, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	template< typename Rep, typename Period >
+	bool try_lock_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		if (try_lock())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(timeout_duration);
+		return lock_slow(&deadline);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool try_lock_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		if (try_lock())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return lock_slow(&deadline);
+	}
+
+	void unlock()
+	{
+		std::uint8_t state = locked_bit;
+		if (m_state.compare_exchange_strong(state, 0u, std::memory_order_release, std::memory_order_relaxed))
+			return;
+		unlock_slow();
+	}
+
+	//! Whether the mutex is locked, for diagnostics
+	bool is_locked() const noexcept
+	{
+		return m_state.load(std::memory_order_relaxed) & locked_bit;
+	}
+
+	//! Whether a thread may be parked on the mutex, for diagnostics
+	bool has_parked() const noexcept
+	{
+		return m_state.load(std::memory_order_relaxed) & parked_bit;
+	}
+
+private:
+	//! Spins while nobody is parked, then parks until the lock is free or handed over
+	bool lock_slow(const futex_deadline* deadline)
+	{
+		if (backoff::enabled())
+		{
+			backoff spin_backoff;
+			for (std::uint32_t spin = 0; spin < spin_count; ++spin)
+			{
+				std::uint8_t state = m_state.load(std::memory_order_relaxed);
+				if (!(state & locked_bit))
+				{
+					if (m_state.compare_exchange_weak(state, state | locked_bit, std::memory_order_acquire, std::memory_order_relaxed))
+						return true;
+					continue;
+				}
+				// don't overtake parked threads for long
+				if (state & parked_bit)
+					break;
+				spin_backoff.pause();
+			}
+		}
+
+		for (;;)
+		{
+			std::uint8_t state = m_state.load(std::memory_order_relaxed);
+			if (!(state & locked_bit))
+			{
+				if (m_state.compare_exchange_weak(state, state | locked_bit, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+				continue;
+			}
+			if (!(state & parked_bit) && !m_state.compare_exchange_weak(state, state | parked_bit, std::memory_order_relaxed, std::memory_order_relaxed))
+				continue;
+
+			const futex_park_result res = futex_parking_lot::park(this,
+				[this]() { return m_state.load(std::memory_order_relaxed) == (locked_bit | parked_bit); },
+				[]() {},
+				[this](bool more_parked) {
+					// the last parked thread left: lockers spin again and unlock takes the fast path
+					if (!more_parked)
+						m_state.fetch_and(locked_bit, std::memory_order_relaxed);
+				},
+				deadline);
+			if (res.status == futex_park_status::unparked && res.token == handoff_token)
+				return true;
+			else if (res.status == futex_park_status::timed_out)
+				return false;
+		}
+	}
+
+	//! Wakes a parked thread, clears the parked bit if it was the last one
+	void unlock_slow()
+	{
+		futex_parking_lot::unpark_one(this, [this](const futex_unpark_result& res) -> std::intptr_t {
+			if (res.unparked && res.be_fair)
+			{
+				// stays locked: the woken thread owns it
+				if (!res.more_parked)
+					m_state.store(locked_bit, std::memory_order_relaxed);
+				return handoff_token;
+			}
+			m_state.store(static_cast< std::uint8_t >(res.more_parked ? parked_bit : 0), std::memory_order_release);
+			return 0;
+		});
+	}
+
+	//! Locked and parked bits
+	std::atomic< std::uint8_t > m_state{0u};
+};
+
+static_assert(sizeof(futex_byte_mutex<>) == 1u, "futex_byte_mutex must be one byte");
+
+#endif
@@ -3,7 +3,10 @@
 
 #include <limits.h>
 #include <chrono>
+#include <cstddef>
 #include "futex_mutex.hpp"
+#include "futex_deadline.hpp"
+#include "futex_probes.hpp"
 
 
 //! CV returned status
@@ -49,28 +52,36 @@ enum class futex_cv_status
 //! https://www.remlab.net/op/futex-condvar.shtml
 //! NOTE: incorrect exception-safe all functions wait*
 //! TODO: except all errors. process SIGCHILD, SIGINTERRUPT in functions wait*
-template< shared_policy policy >
-class futex_condition_variable : boost::noncopyable
+//! stats: wait and notify statistics, see futex_stats.hpp. The default is declared in futex_mutex.hpp.
+template< shared_policy policy, typename stats >
+class futex_condition_variable : boost::noncopyable, private futex_detail::ebo_holder< stats, 0 >
 {
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+	//! Wait and notify statistics
+	using stats_holder = futex_detail::ebo_holder< stats, 0 >;
+
 	//! Mutex type
 	using mutex_t = futex_mutex< policy >;
+	//! Internal mutex guards a few fields only, so it doesn't spin and keeps no statistics
+	using internal_mutex_t = futex_mutex< policy, false, default_backoff, futex_layout::packed >;
 public:
 	//! ctor
 	futex_condition_variable()
-	: m_futex_val(0u), m_waiters(0u)
+	: m_futex_val(0u), m_waiters(0u), m_any_waiters(0u), m_mutex_offset(0)
 	{
-		m_wait_op = (policy == shared_policy::inprocess ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT);
-		m_wake_op = (policy == shared_policy::inprocess ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE);
-		m_req_op = (policy == shared_policy::inprocess ? FUTEX_REQUEUE_PRIVATE : FUTEX_REQUEUE);
 	}
 
 	void wait(futex_mutex_unique_lock< mutex_t >& lock)
 	{
 		std::int32_t val, res;
+		FUTEX_PROBE2(cond_wait_start, this, lock.mutex());
+		const std::uint64_t wait_start = stats::now();
 		// lock internal mutex
-		futex_mutex_unique_lock< mutex_t > internal_lock(m_internal_mutex);
+		futex_mutex_unique_lock< internal_mutex_t > internal_lock(m_internal_mutex);
 		val = m_futex_val;
 		++m_waiters;
+		m_mutex_offset = mutex_offset(lock);
 
 		// unlock external mutex
 		lock.unlock();
@@ -78,7 +89,9 @@ public:
 		do {
 			internal_lock.unlock();
 			// NOTE: don't care if futex wakes up spuriously. Because we used external flag
-			res = futex(&m_futex_val, m_wait_op, val, nullptr, nullptr, 0);
+			stats_holder::held().futex_wait();
+			FUTEX_PROBE2(futex_wait, &m_futex_val, val);
+			res = futex(&m_futex_val, ops::wait, val, nullptr, nullptr, 0);
 			internal_lock.lock();
 		}
 		while (!res || errno == EINTR);
@@ -87,9 +100,11 @@ public:
 
 		try
 		{
-			// lock external mutex
-			lock.lock();
+			// lock external mutex, other waiters may be requeued to it
+			lock.lock_contended();
 			--m_waiters;
+			stats_holder::held().waited(true, wait_start);
+			FUTEX_PROBE2(cond_wait_end, this, 0);
 		}
 		catch (...)
 		{
@@ -102,23 +117,63 @@ public:
 	template< typename Predicate >
 	void wait(futex_mutex_unique_lock< mutex_t >& lock, Predicate pred)
 	{
-		while (!pred())
+		if (pred())
+			return;
+		for (;;)
+		{
 			wait(lock);
+			if (pred())
+				return;
+			stats_holder::held().spurious_wakeup();
+		}
+	}
+
+	//! Waits until absolute deadline: steady_clock (CLOCK_MONOTONIC), system_clock (CLOCK_REALTIME)
+	//! or any other clock converted to steady_clock. EINTR and spurious wakeups don't extend the wait.
+	template< typename Clock, typename Duration >
+	futex_cv_status wait_until(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		return wait_until(lock, make_futex_deadline(timeout_time));
+	}
+
+	template< typename Clock, typename Duration, typename Predicate >
+	bool wait_until(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::time_point< Clock, Duration >& timeout_time, Predicate pred)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		if (pred())
+			return true;
+		for (;;)
+		{
+			if (wait_until(lock, deadline) == futex_cv_status::timeout)
+			{ return pred(); }
+			if (pred())
+				return true;
+			stats_holder::held().spurious_wakeup();
+		}
 	}
 
 	template< typename Rep, typename Period >
 	futex_cv_status wait_for(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::duration< Rep, Period >& timeout_time)
 	{
-		std::int32_t val, res;
-		std::chrono::system_clock::time_point timepoint{timeout_time};
-		auto seconds = std::chrono::time_point_cast< std::chrono::seconds >(timepoint);
-		auto nanoseconds = std::chrono::duration_cast< std::chrono::nanoseconds >(timepoint - seconds);
-		struct timespec timeout = { static_cast< std::time_t >(seconds.time_since_epoch().count()), nanoseconds.count() };
+		return wait_until(lock, make_futex_deadline(timeout_time));
+	}
+
+	template< typename Rep, typename Period, typename Predicate >
+	bool wait_for(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::duration< Rep, Period >& timeout_time, Predicate pred)
+	{
+		return wait_until(lock, std::chrono::steady_clock::now() + std::chrono::duration_cast< std::chrono::steady_clock::duration >(timeout_time), pred);
+	}
 
+	futex_cv_status wait_until(futex_mutex_unique_lock< mutex_t >& lock, const futex_deadline& deadline)
+	{
+		std::int32_t val, res;
+		FUTEX_PROBE2(cond_wait_start, this, lock.mutex());
+		const std::uint64_t wait_start = stats::now();
 		// lock internal mutex
-		futex_mutex_unique_lock< mutex_t > internal_lock(m_internal_mutex);
+		futex_mutex_unique_lock< internal_mutex_t > internal_lock(m_internal_mutex);
 		val = m_futex_val;
 		++m_waiters;
+		m_mutex_offset = mutex_offset(lock);
 
 		// unlock external mutex
 		lock.unlock();
@@ -126,7 +181,9 @@ public:
 		do {
 			internal_lock.unlock();
 			// NOTE: don't care if futex wakes up spuriously. Because we used external flag
-			res = futex(&m_futex_val, m_wait_op, val, &timeout, nullptr, 0);
+			stats_holder::held().futex_wait();
+			FUTEX_PROBE2(futex_wait, &m_futex_val, val);
+			res = futex(&m_futex_val, ops::wait_bitset | deadline.clock_flag, val, &deadline.abs_time, nullptr, FUTEX_BITSET_MATCH_ANY);
 			internal_lock.lock();
 		}
 		while (res != -1 || errno == EINTR);
@@ -135,9 +192,11 @@ public:
 
 		try
 		{
-			// lock external mutex
-			lock.lock();
+			// lock external mutex, other waiters may be requeued to it
+			lock.lock_contended();
 			--m_waiters;
+			stats_holder::held().waited(true, wait_start);
+			FUTEX_PROBE2(cond_wait_end, this, res == ETIMEDOUT ? 1 : 0);
 			return res == ETIMEDOUT ? futex_cv_status::timeout : futex_cv_status::no_timeout;
 		}
 		catch (...)
@@ -148,73 +207,135 @@ public:
 		}
 	}
 
-	template< typename Rep, typename Period, typename Predicate >
-	bool wait_for(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::duration< Rep, Period >& timeout_time, Predicate pred)
-	{
-		while (!pred())
-		{
-			if (wait_for(lock, timeout_time) == futex_cv_status::timeout)
-			{ return pred(); }
-		}
-		return true;
-	}
-
 	void notify_one() noexcept
 	{
 		// lock/unlock internal data
 		{
-			futex_mutex_lock_guard< mutex_t > lock(m_internal_mutex);
+			futex_mutex_lock_guard< internal_mutex_t > lock(m_internal_mutex);
 			// avoid extra futex syscall
 			if (m_waiters <= 0)
 				return;
 			++m_futex_val;
 		}
 
-		futex(&m_futex_val, m_wake_op, 1, nullptr, nullptr, 0);
+		stats_holder::held().futex_wake();
+		FUTEX_PROBE2(cond_notify, this, 0);
+		FUTEX_PROBE2(futex_wake, &m_futex_val, 1);
+		futex(&m_futex_val, ops::wake, 1, nullptr, nullptr, 0);
 	}
 
 
+	//! Wait morphing: wakes one waiter and requeues the rest to the futex of the external mutex,
+	//! so they are woken up one by one on unlock instead of stampeding on the mutex.
+	//! Interprocess condition variables wake all waiters instead, like glibc does for process-shared
+	//! mutexes: the mutex may live in another mapping, at another offset in every process.
 	void notify_all() noexcept
 	{
-		// TODO: rewrite to futex_requeue semantics
-		// FUTEX_REQUEUE:
-		// if m_futex_val != 0:
-		//     return EAGAIN
-		// else
-		//     requeue waiters to mutex's futex;
-		//
-		// ++m_futex_val;
-		// futex(&m_futex_val, m_req_op, 1, INT_MAX, &external_mutex_futex_addr, 1);
-
+		std::uint32_t val;
+		std::ptrdiff_t offset;
+		bool requeue;
 		// lock/unlock internal data
 		{
-			futex_mutex_lock_guard< mutex_t > lock(m_internal_mutex);
+			futex_mutex_lock_guard< internal_mutex_t > lock(m_internal_mutex);
 			// avoid extra futex syscall
 			if (m_waiters <= 0)
 				return;
-			++m_futex_val;
+			val = ++m_futex_val;
+			offset = m_mutex_offset;
+			// wait_any waiters don't own the mutex, they must not be requeued to it
+			requeue = (policy == shared_policy::inprocess && m_any_waiters == 0u);
+		}
+		stats_holder::held().futex_wake();
+		FUTEX_PROBE2(cond_notify, this, 1);
+
+		if (!requeue)
+		{
+			FUTEX_PROBE2(futex_wake, &m_futex_val, INT_MAX);
+			futex(&m_futex_val, ops::wake, INT_MAX, nullptr, nullptr, 0);
+			return;
+		}
+
+		// FUTEX_CMP_REQUEUE:
+		// if m_futex_val != val:
+		//     return EAGAIN
+		// else
+		//     wake 1 waiter, requeue the others to mutex's futex;
+		int* mutex_word = reinterpret_cast< int* >(reinterpret_cast< char* >(this) + offset);
+		const struct timespec* requeue_count = reinterpret_cast< const struct timespec* >(static_cast< std::uintptr_t >(INT_MAX));
+		FUTEX_PROBE2(cond_requeue, this, mutex_word);
+		if (futex(&m_futex_val, ops::cmp_requeue, 1, requeue_count, mutex_word, static_cast< int >(val)) < 0)
+		{
+			// concurrent notify changed the futex value, fall back to wake all
+			FUTEX_PROBE2(futex_wake, &m_futex_val, INT_MAX);
+			futex(&m_futex_val, ops::wake, INT_MAX, nullptr, nullptr, 0);
 		}
+	}
+
+	//! Wait and notify statistics, see futex_stats.hpp
+	const stats& statistics() const noexcept
+	{
+		return stats_holder::held();
+	}
 
-		futex(&m_futex_val, m_wake_op, INT_MAX, nullptr, nullptr, 0);
+	stats& statistics() noexcept
+	{
+		return stats_holder::held();
 	}
 
 private:
+	template< typename > friend class futex_waitable;
+
 	//! Base wrapper for futex syscall
 	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
 	{
 		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
 	}
 
-	//! Mutex for internal synchronization
-	mutex_t m_internal_mutex;
+	//! Offset of the mutex futex word from this condition variable
+	std::ptrdiff_t mutex_offset(futex_mutex_unique_lock< mutex_t >& lock) noexcept
+	{
+		return reinterpret_cast< char* >(lock.mutex()->native_handle()) - reinterpret_cast< char* >(this);
+	}
+
+	//! wait_any support: registers a waiter which sleeps in futex_waitv, returns the futex word and its value
+	std::uint32_t* any_arm(std::uint32_t& val)
+	{
+		futex_mutex_lock_guard< internal_mutex_t > lock(m_internal_mutex);
+		++m_waiters;
+		++m_any_waiters;
+		val = m_futex_val;
+		return &m_futex_val;
+	}
+
+	//! Unregisters the waiter, returns whether it was notified since any_arm.
+	//! Without consume a notification is passed on: it may have woken this waiter instead of another one.
+	bool any_disarm(std::uint32_t val, bool consume)
+	{
+		bool notified;
+		{
+			futex_mutex_lock_guard< internal_mutex_t > lock(m_internal_mutex);
+			--m_waiters;
+			--m_any_waiters;
+			notified = (m_futex_val != val);
+		}
+		if (notified && !consume)
+			futex(&m_futex_val, ops::wake, 1, nullptr, nullptr, 0);
+		return notified;
+	}
+
 	//! Futex value
 	std::uint32_t m_futex_val;
+	//! Mutex for internal synchronization, not the first member: the empty noncopyable bases can't share an address
+	internal_mutex_t m_internal_mutex;
 	//! Waiters count
 	std::uint32_t m_waiters;
-	//! Futex options
-	int m_wait_op;
-	int m_wake_op;
-	int m_req_op;
+	//! Waiters of wait_any among them
+	std::uint32_t m_any_waiters;
+	//! Offset of the external mutex futex word, used by inprocess notify_all only
+	std::ptrdiff_t m_mutex_offset;
 };
 
+static_assert(sizeof(futex_condition_variable< shared_policy::interprocess >) == 4 * sizeof(std::uint32_t) + sizeof(std::ptrdiff_t),
+	"condition variable must keep the compact layout");
+
 #endif
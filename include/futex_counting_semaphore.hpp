@@ -0,0 +1,203 @@
+#ifndef FUTEX_COUNTING_SEMAPHORE_HPP_
+#define FUTEX_COUNTING_SEMAPHORE_HPP_
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_stats.hpp"
+#include "futex_probes.hpp"
+
+//! Counting semaphore on a single futex word, semantics of <semaphore.h>.
+//! Value and number of waiters live in one 64-bit atomic, futex waits on the value half:
+//! https://github.com/bminor/glibc/blob/master/nptl/sem_waitcommon.c
+//! Uncontended wait/try_wait/post is one atomic operation, post wakes only if somebody sleeps.
+//!
+//! shared policy: whether a semaphore can synchronize different processes or not
+//! stats: wait and post statistics, see futex_stats.hpp
+template< shared_policy policy, typename stats = futex_no_stats >
+class futex_counting_semaphore : boost::noncopyable, private futex_detail::ebo_holder< stats, 0 >
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+	//! Wait and post statistics
+	using stats_holder = futex_detail::ebo_holder< stats, 0 >;
+
+	//! Data layout: [ waiters:32 | value:32 ]
+	enum : std::uint64_t
+	{
+		value_mask		= 0xffffffffull,
+		waiters_shift	= 32u,
+		one_waiter		= 1ull << waiters_shift
+	};
+
+public:
+	explicit futex_counting_semaphore(std::uint32_t initial_value = 0u) : m_data(initial_value)
+	{
+		if (!m_data.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_data must be lock-free");
+	}
+
+	//! Decrements the value if it is positive, never blocks
+	bool try_wait() noexcept
+	{
+		std::uint64_t data = m_data.load(std::memory_order_relaxed);
+		while (data & value_mask)
+		{
+			if (m_data.compare_exchange_weak(data, data - 1u, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				stats_holder::held().waited(false, 0u);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void wait()
+	{
+		if (try_wait())
+			return;
+		wait_slow(nullptr);
+	}
+
+	template< typename Rep, typename Period >
+	bool wait_for(const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(waited_time);
+		return wait_slow(&deadline);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool wait_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return wait_slow(&deadline);
+	}
+
+	//! Increments the value by n and wakes up to n waiters with one FUTEX_WAKE
+	void post(std::uint32_t n = 1u)
+	{
+		if (!n)
+			return;
+
+		std::uint64_t data = m_data.load(std::memory_order_relaxed);
+		do
+		{
+			if ((data & value_mask) > value_mask - n)
+				THROW_EXCEPTION(futex_base_exception, "Semaphore value overflow");
+		}
+		while (!m_data.compare_exchange_weak(data, data + n, std::memory_order_release, std::memory_order_relaxed));
+
+		// avoid extra futex syscall
+		const std::uint64_t waiters = data >> waiters_shift;
+		if (waiters)
+		{
+			stats_holder::held().futex_wake();
+			FUTEX_PROBE2(futex_wake, value_word(), n < waiters ? n : static_cast< std::uint32_t >(waiters));
+			futex(value_word(), ops::wake, n < waiters ? n : static_cast< std::uint32_t >(waiters), nullptr, nullptr, 0);
+		}
+	}
+
+	//! Current value, for diagnostics
+	std::uint32_t value() const noexcept
+	{
+		return static_cast< std::uint32_t >(m_data.load(std::memory_order_relaxed) & value_mask);
+	}
+
+	//! Wait and post statistics, see futex_stats.hpp
+	const stats& statistics() const noexcept
+	{
+		return stats_holder::held();
+	}
+
+	stats& statistics() noexcept
+	{
+		return stats_holder::held();
+	}
+
+private:
+	template< typename > friend class futex_waitable;
+
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! 32-bit value half of m_data, the futex word
+	std::uint32_t* value_word() noexcept
+	{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return reinterpret_cast< std::uint32_t* >(&m_data) + 1;
+#else
+		return reinterpret_cast< std::uint32_t* >(&m_data);
+#endif
+	}
+
+	//! Registers as a waiter and sleeps while the value is zero
+	bool wait_slow(const futex_deadline* deadline)
+	{
+		FUTEX_PROBE1(sem_block, this);
+		const std::uint64_t wait_start = stats::now();
+		std::uint64_t data = m_data.fetch_add(one_waiter, std::memory_order_relaxed) + one_waiter;
+		for (;;)
+		{
+			if (data & value_mask)
+			{
+				// take a unit and unregister in one step
+				if (m_data.compare_exchange_weak(data, data - 1u - one_waiter, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					stats_holder::held().waited(true, wait_start);
+					FUTEX_PROBE2(sem_unblock, this, 1);
+					return true;
+				}
+				continue;
+			}
+
+			stats_holder::held().futex_wait();
+			FUTEX_PROBE2(futex_wait, value_word(), 0);
+			int res = deadline
+				? futex(value_word(), ops::wait_bitset | deadline->clock_flag, 0, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(value_word(), ops::wait, 0, nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				// the last chance, a post may come together with the timeout
+				data = m_data.load(std::memory_order_relaxed);
+				while (data & value_mask)
+				{
+					if (m_data.compare_exchange_weak(data, data - 1u - one_waiter, std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						stats_holder::held().waited(true, wait_start);
+						FUTEX_PROBE2(sem_unblock, this, 1);
+						return true;
+					}
+				}
+				m_data.fetch_sub(one_waiter, std::memory_order_relaxed);
+				FUTEX_PROBE2(sem_unblock, this, 0);
+				return false;
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				m_data.fetch_sub(one_waiter, std::memory_order_relaxed);
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+			data = m_data.load(std::memory_order_relaxed);
+		}
+	}
+
+	//! Semaphore value and waiters count
+	std::atomic< std::uint64_t > m_data;
+};
+
+#endif
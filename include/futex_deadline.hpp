@@ -0,0 +1,65 @@
+#ifndef FUTEX_DEADLINE_HPP_
+#define FUTEX_DEADLINE_HPP_
+
+#include <time.h>
+#include <linux/futex.h>
+
+#include <chrono>
+#include <cstdint>
+
+//! Absolute timeout for FUTEX_WAIT_BITSET.
+//! Unlike FUTEX_WAIT timeout it doesn't restart after EINTR or spurious wakeups:
+//! http://man7.org/linux/man-pages/man2/futex.2.html
+//! steady_clock deadlines use CLOCK_MONOTONIC, system_clock deadlines use FUTEX_CLOCK_REALTIME
+//! (and follow clock changes like pthread_cond_timedwait), other clocks are converted to steady_clock.
+struct futex_deadline
+{
+	struct timespec abs_time;
+	//! 0 or FUTEX_CLOCK_REALTIME, must be OR'ed to FUTEX_WAIT_BITSET
+	int clock_flag;
+};
+
+namespace futex_detail
+{
+
+template< typename Clock, typename Duration >
+struct timespec to_timespec(const std::chrono::time_point< Clock, Duration >& tp) noexcept
+{
+	auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >(tp.time_since_epoch()).count();
+	// before the epoch: already expired
+	if (ns < 0)
+		ns = 0;
+	struct timespec ts = { static_cast< std::time_t >(ns / 1000000000), static_cast< long >(ns % 1000000000) };
+	return ts;
+}
+
+} // namespace futex_detail
+
+
+template< typename Duration >
+futex_deadline make_futex_deadline(const std::chrono::time_point< std::chrono::steady_clock, Duration >& tp) noexcept
+{
+	return futex_deadline{ futex_detail::to_timespec(tp), 0 };
+}
+
+template< typename Duration >
+futex_deadline make_futex_deadline(const std::chrono::time_point< std::chrono::system_clock, Duration >& tp) noexcept
+{
+	return futex_deadline{ futex_detail::to_timespec(tp), FUTEX_CLOCK_REALTIME };
+}
+
+template< typename Clock, typename Duration >
+futex_deadline make_futex_deadline(const std::chrono::time_point< Clock, Duration >& tp) noexcept
+{
+	const auto left = std::chrono::duration_cast< std::chrono::steady_clock::duration >(tp - Clock::now());
+	return make_futex_deadline(std::chrono::steady_clock::now() + left);
+}
+
+//! Deadline after relative timeout
+template< typename Rep, typename Period >
+futex_deadline make_futex_deadline(const std::chrono::duration< Rep, Period >& timeout) noexcept
+{
+	return make_futex_deadline(std::chrono::steady_clock::now() + std::chrono::duration_cast< std::chrono::steady_clock::duration >(timeout));
+}
+
+#endif
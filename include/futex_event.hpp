@@ -0,0 +1,167 @@
+#ifndef FUTEX_EVENT_HPP_
+#define FUTEX_EVENT_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+
+//! What a signaled futex_event does with a released waiter
+enum class futex_event_reset
+{
+	//! stays signaled until reset(), set() releases all the waiters
+	manual,
+	//! the released waiter resets the event, set() releases one waiter
+	automatic
+};
+
+//! Event on a single futex word, semantics of Win32 events.
+//! The signaled flag and the number of sleepers share the word: set() is one atomic operation
+//! and makes a FUTEX_WAKE only if somebody sleeps, waiting on a signaled event doesn't write.
+//! set() of a signaled event does nothing, automatic events don't count the signals.
+//!
+//! shared policy: whether an event can synchronize different processes or not
+//! reset: manual or automatic reset, see futex_event_reset
+template< shared_policy policy, futex_event_reset reset_mode = futex_event_reset::manual >
+class futex_event : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Data layout: [ sleepers:31 | signaled:1 ]
+	enum : std::uint32_t
+	{
+		signaled_bit	= 1u,
+		one_sleeper		= 2u
+	};
+
+public:
+	explicit futex_event(bool signaled = false) : m_state(signaled ? signaled_bit : 0u)
+	{
+		if (!m_state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	//! Signals the event and releases all the waiters (manual) or one waiter (automatic)
+	void set() noexcept
+	{
+		const std::uint32_t state = m_state.fetch_or(signaled_bit, std::memory_order_release);
+		if (!(state & signaled_bit) && state >= one_sleeper)
+			futex(&m_state, ops::wake, reset_mode == futex_event_reset::manual ? INT_MAX : 1, nullptr, nullptr, 0);
+	}
+
+	//! Clears the signal
+	void reset() noexcept
+	{
+		m_state.fetch_and(~static_cast< std::uint32_t >(signaled_bit), std::memory_order_relaxed);
+	}
+
+	//! Whether the event is signaled, for diagnostics
+	bool is_set() const noexcept
+	{
+		return m_state.load(std::memory_order_relaxed) & signaled_bit;
+	}
+
+	//! Takes the signal if the event is signaled, never blocks
+	bool try_wait() noexcept
+	{
+		if (reset_mode == futex_event_reset::manual)
+			return m_state.load(std::memory_order_acquire) & signaled_bit;
+
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		while (state & signaled_bit)
+		{
+			if (m_state.compare_exchange_weak(state, state & ~static_cast< std::uint32_t >(signaled_bit), std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	void wait()
+	{
+		if (!try_wait())
+			wait_slow(nullptr);
+	}
+
+	template< typename Rep, typename Period >
+	bool wait_for(const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(waited_time);
+		return wait_slow(&deadline);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool wait_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return wait_slow(&deadline);
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! Takes the signal (automatic) and unregisters in one step
+	bool try_leave(std::uint32_t& state) noexcept
+	{
+		while (state & signaled_bit)
+		{
+			const std::uint32_t next = reset_mode == futex_event_reset::manual
+				? state - one_sleeper
+				: (state - one_sleeper) & ~static_cast< std::uint32_t >(signaled_bit);
+			if (m_state.compare_exchange_weak(state, next, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	//! Registers as a sleeper and sleeps while the event isn't signaled
+	bool wait_slow(const futex_deadline* deadline)
+	{
+		std::uint32_t state = m_state.fetch_add(one_sleeper, std::memory_order_relaxed) + one_sleeper;
+		for (;;)
+		{
+			if (try_leave(state))
+				return true;
+
+			int res = deadline
+				? futex(&m_state, ops::wait_bitset | deadline->clock_flag, static_cast< int >(state), &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&m_state, ops::wait, static_cast< int >(state), nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				// the last chance, a set may come together with the timeout
+				state = m_state.load(std::memory_order_relaxed);
+				if (try_leave(state))
+					return true;
+				m_state.fetch_sub(one_sleeper, std::memory_order_relaxed);
+				return false;
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				m_state.fetch_sub(one_sleeper, std::memory_order_relaxed);
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+			state = m_state.load(std::memory_order_relaxed);
+		}
+	}
+
+	//! Sleepers count and signaled flag
+	std::atomic< std::uint32_t > m_state;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef FUTEX_EVENTCOUNT_HPP_
+#define FUTEX_EVENTCOUNT_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+
+//! Eventcount: lets a thread sleep until a condition of a lock-free structure may have changed,
+//! without a lock and without a syscall on the notifying side while nobody sleeps.
+//! Based on:
+//! https://www.1024cores.net/home/lock-free-algorithms/eventcounts
+//! One futex word [ epoch:16 | waiters:16 ]. The waiting protocol is
+//!     auto key = ec.prepare_wait();
+//!     if (condition()) ec.cancel_wait(key); else ec.commit_wait(key);
+//! and the notifier changes the condition and then calls notify_one or notify_all.
+//! prepare_wait registers the waiter with a full barrier, notify has one too: either the waiter's
+//! check sees the change or the notifier sees the waiter, bumps the epoch and wakes it.
+//! Every waiter takes itself off the count in cancel_wait or when commit_wait returns, so the count
+//! is exact: a notify makes a syscall only while a waiter is registered, and only bumps the epoch.
+//!
+//! shared policy: whether an eventcount can be shared by different processes or not
+//! NOTE: at most 65535 threads wait at once
+template< shared_policy policy >
+class futex_eventcount : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	enum : std::uint32_t
+	{
+		waiters_mask	= 0xffffu,
+		epoch_one		= 0x10000u
+	};
+
+public:
+	//! Registration of a waiter, passed to cancel_wait or commit_wait
+	using key_type = std::uint32_t;
+
+	futex_eventcount() noexcept = default;
+
+	//! Registers the caller as a waiter, the condition must be checked after it
+	key_type prepare_wait() noexcept
+	{
+		return m_state.fetch_add(1u, std::memory_order_seq_cst) + 1u;
+	}
+
+	//! The condition became true: takes the waiter off the count
+	void cancel_wait(key_type) noexcept
+	{
+		m_state.fetch_sub(1u, std::memory_order_relaxed);
+	}
+
+	//! Sleeps until a notify after prepare_wait. Returns at once if there was one already.
+	void commit_wait(key_type key)
+	{
+		wait(key, nullptr);
+	}
+
+	//! Sleeps until a notify or the deadline, see futex_deadline.hpp. Returns false on timeout.
+	bool commit_wait(key_type key, const futex_deadline& deadline)
+	{
+		return wait(key, &deadline);
+	}
+
+	//! Wakes one waiter, no syscall if nobody waits
+	void notify_one() noexcept
+	{
+		notify(1u);
+	}
+
+	//! Wakes all the waiters, no syscall if nobody waits
+	void notify_all() noexcept
+	{
+		notify(waiters_mask);
+	}
+
+	//! Number of registered waiters, may be outdated at once
+	std::uint32_t waiters_approx() const noexcept
+	{
+		return m_state.load(std::memory_order_relaxed) & waiters_mask;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! Sleeps while the epoch of the key lasts, then takes the waiter off the count
+	bool wait(key_type key, const futex_deadline* deadline)
+	{
+		bool notified = true;
+		std::uint32_t state = m_state.load(std::memory_order_acquire);
+		// the word also changes when other waiters come and go, only the epoch matters
+		while ((state & ~waiters_mask) == (key & ~waiters_mask))
+		{
+			int res = deadline
+				? futex(&m_state, ops::wait_bitset | deadline->clock_flag, static_cast< int >(state), &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&m_state, ops::wait, static_cast< int >(state), nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				notified = false;
+				break;
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				const int error = errno;
+				cancel_wait(key);
+				THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+			}
+			state = m_state.load(std::memory_order_acquire);
+		}
+		cancel_wait(key);
+		return notified;
+	}
+
+	//! Bumps the epoch if a waiter is registered, the epoch wraps around in the upper half of the word
+	void notify(std::uint32_t count) noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		while (state & waiters_mask)
+		{
+			const std::uint32_t waiters = state & waiters_mask;
+			const std::uint32_t woken = count < waiters ? count : waiters;
+			if (m_state.compare_exchange_weak(state, state + epoch_one, std::memory_order_release, std::memory_order_relaxed))
+			{
+				futex(&m_state, ops::wake, count == waiters_mask ? INT_MAX : static_cast< int >(woken), nullptr, nullptr, 0);
+				return;
+			}
+		}
+	}
+
+	std::atomic< std::uint32_t > m_state{0u};
+};
+
+#endif
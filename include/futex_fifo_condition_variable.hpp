@@ -0,0 +1,263 @@
+#ifndef FUTEX_FIFO_CONDITION_VARIABLE_HPP_
+#define FUTEX_FIFO_CONDITION_VARIABLE_HPP_
+
+#include <sched.h>
+#include <limits.h>
+#include <chrono>
+#include "futex_mutex.hpp"
+#include "futex_condition_variable.hpp"
+#include "futex_deadline.hpp"
+
+
+//! Condition variable with a FIFO queue of waiters. Every waiter links a node with own futex word
+//! into the intrusive list, so notify_one wakes exactly the oldest waiter and there are no
+//! spurious wakeups. The list is guarded by a short spinlock instead of an internal futex_mutex,
+//! notify_* without waiters doesn't touch the lock at all.
+//! Based on ideas from:
+//! musl pthread_cond_timedwait: https://github.com/ifduyue/musl/blob/master/src/thread/pthread_cond_timedwait.c
+//! NOTE: nodes live on the stacks of waiting threads, so only shared_policy::inprocess is supported
+template< shared_policy policy >
+class futex_fifo_condition_variable : boost::noncopyable
+{
+	static_assert(policy == shared_policy::inprocess, "futex_fifo_condition_variable supports only shared_policy::inprocess");
+
+	//! Mutex type
+	using mutex_t = futex_mutex< policy >;
+
+	//! Waiter states
+	enum : std::uint32_t
+	{
+		waiting		= 0u,
+		signaled	= 1u
+	};
+
+	//! Waiter node, lives on the stack of waiting thread
+	struct waiter_node
+	{
+		std::atomic< std::uint32_t > state{waiting};
+		waiter_node* prev = nullptr;
+		waiter_node* next = nullptr;
+		bool queued = true;
+	};
+
+public:
+	//! ctor
+	futex_fifo_condition_variable() : m_head(nullptr), m_tail(nullptr), m_queue_lock(false) {}
+
+	void wait(futex_mutex_unique_lock< mutex_t >& lock)
+	{
+		waiter_node node;
+		enqueue(node);
+		lock.unlock();
+
+		while (node.state.load(std::memory_order_acquire) == waiting)
+		{
+			int res = futex(&node.state, FUTEX_WAIT_PRIVATE, waiting, nullptr, nullptr, 0);
+			if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				cancel(node);
+				lock.lock();
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+		}
+
+		lock.lock();
+	}
+
+	template< typename Predicate >
+	void wait(futex_mutex_unique_lock< mutex_t >& lock, Predicate pred)
+	{
+		while (!pred())
+			wait(lock);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	futex_cv_status wait_until(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		return wait_until(lock, make_futex_deadline(timeout_time));
+	}
+
+	template< typename Clock, typename Duration, typename Predicate >
+	bool wait_until(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::time_point< Clock, Duration >& timeout_time, Predicate pred)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		while (!pred())
+		{
+			if (wait_until(lock, deadline) == futex_cv_status::timeout)
+			{ return pred(); }
+		}
+		return true;
+	}
+
+	template< typename Rep, typename Period >
+	futex_cv_status wait_for(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::duration< Rep, Period >& timeout_time)
+	{
+		return wait_until(lock, make_futex_deadline(timeout_time));
+	}
+
+	template< typename Rep, typename Period, typename Predicate >
+	bool wait_for(futex_mutex_unique_lock< mutex_t >& lock, const std::chrono::duration< Rep, Period >& timeout_time, Predicate pred)
+	{
+		return wait_until(lock, std::chrono::steady_clock::now() + std::chrono::duration_cast< std::chrono::steady_clock::duration >(timeout_time), pred);
+	}
+
+	futex_cv_status wait_until(futex_mutex_unique_lock< mutex_t >& lock, const futex_deadline& deadline)
+	{
+		waiter_node node;
+		enqueue(node);
+		lock.unlock();
+
+		futex_cv_status status = futex_cv_status::no_timeout;
+		while (node.state.load(std::memory_order_acquire) == waiting)
+		{
+			int res = futex(&node.state, FUTEX_WAIT_BITSET_PRIVATE | deadline.clock_flag, waiting, &deadline.abs_time, nullptr, FUTEX_BITSET_MATCH_ANY);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				status = cancel(node) ? futex_cv_status::timeout : futex_cv_status::no_timeout;
+				break;
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				cancel(node);
+				lock.lock();
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+		}
+
+		lock.lock();
+		return status;
+	}
+
+	//! Wakes the oldest waiter
+	void notify_one() noexcept
+	{
+		// avoid the lock and futex syscall
+		if (!m_head.load(std::memory_order_acquire))
+			return;
+
+		lock_queue();
+		waiter_node* node = m_head.load(std::memory_order_relaxed);
+		if (node)
+			unlink(node);
+		unlock_queue();
+
+		if (node)
+			signal(node);
+	}
+
+	//! Wakes all waiters in FIFO order
+	void notify_all() noexcept
+	{
+		// avoid the lock and futex syscall
+		if (!m_head.load(std::memory_order_acquire))
+			return;
+
+		lock_queue();
+		waiter_node* node = m_head.load(std::memory_order_relaxed);
+		for (waiter_node* it = node; it; it = it->next)
+			it->queued = false;
+		m_head.store(nullptr, std::memory_order_relaxed);
+		m_tail = nullptr;
+		unlock_queue();
+
+		while (node)
+		{
+			// the node is destroyed by its owner as soon as it is signaled
+			waiter_node* next = node->next;
+			signal(node);
+			node = next;
+		}
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! Marks the node signaled and wakes its owner.
+	//! NOTE: the owner may return and reuse its stack before FUTEX_WAKE, then the wake is spurious
+	//! for somebody else who waits on the same address. Such waiter rechecks its state and sleeps again.
+	static void signal(waiter_node* node) noexcept
+	{
+		node->state.store(signaled, std::memory_order_release);
+		futex(&node->state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+
+	void enqueue(waiter_node& node) noexcept
+	{
+		lock_queue();
+		node.prev = m_tail;
+		if (m_tail)
+			m_tail->next = &node;
+		else
+			m_head.store(&node, std::memory_order_relaxed);
+		m_tail = &node;
+		unlock_queue();
+	}
+
+	//! Must be called under the queue lock
+	void unlink(waiter_node* node) noexcept
+	{
+		if (node->prev)
+			node->prev->next = node->next;
+		else
+			m_head.store(node->next, std::memory_order_relaxed);
+		if (node->next)
+			node->next->prev = node->prev;
+		else
+			m_tail = node->prev;
+		node->queued = false;
+	}
+
+	//! Removes the node of a waiter which gives up (timeout or error).
+	//! Returns false if a notifier has already taken the node: the notification is consumed then,
+	//! and we must wait until the notifier stops touching the node.
+	bool cancel(waiter_node& node) noexcept
+	{
+		lock_queue();
+		const bool queued = node.queued;
+		if (queued)
+			unlink(&node);
+		unlock_queue();
+
+		if (!queued)
+		{
+			while (node.state.load(std::memory_order_acquire) == waiting)
+				::sched_yield();
+		}
+		return queued;
+	}
+
+	//! Short spinlock for the list, critical sections are a few pointer updates
+	void lock_queue() noexcept
+	{
+		int spins{0};
+		while (m_queue_lock.exchange(true, std::memory_order_acquire))
+		{
+			while (m_queue_lock.load(std::memory_order_relaxed))
+			{
+				if (++spins < 64 && need_spinlock())
+					cpu_relax();
+				else
+					::sched_yield();
+			}
+		}
+	}
+
+	void unlock_queue() noexcept
+	{
+		m_queue_lock.store(false, std::memory_order_release);
+	}
+
+	//! Oldest waiter, read without the lock on the notify fast path
+	std::atomic< waiter_node* > m_head;
+	//! Newest waiter
+	waiter_node* m_tail;
+	//! List lock
+	std::atomic< bool > m_queue_lock;
+};
+
+#endif
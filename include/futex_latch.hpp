@@ -0,0 +1,150 @@
+#ifndef FUTEX_LATCH_HPP_
+#define FUTEX_LATCH_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+
+//! Single-use downward counter on a single futex word, semantics of std::latch.
+//! Waiters set a flag before sleeping, so count_down makes a FUTEX_WAKE only if it
+//! reaches zero and somebody sleeps.
+//!
+//! shared policy: whether a latch can synchronize different processes or not
+//! NOTE: the counter is at most 2^31 - 1
+template< shared_policy policy >
+class futex_latch : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Data layout: [ sleepers:1 | count:31 ]
+	enum : std::uint32_t
+	{
+		count_mask		= 0x7fffffffu,
+		sleepers_bit	= 1u << 31u
+	};
+
+public:
+	//! Maximum initial count
+	static constexpr std::uint32_t max() noexcept
+	{
+		return count_mask;
+	}
+
+	explicit futex_latch(std::uint32_t expected) : m_state(expected)
+	{
+		if (expected > max())
+			THROW_EXCEPTION(futex_base_exception, "Latch count must be at most 2^31 - 1");
+		if (!m_state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	//! Decrements the counter by n, the last decrement releases all the waiters
+	void count_down(std::uint32_t n = 1u)
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		std::uint32_t next;
+		do
+		{
+			if ((state & count_mask) < n)
+				THROW_EXCEPTION(futex_base_exception, "Latch count_down below zero");
+			next = state - n;
+			// nobody sleeps on a released latch
+			if (!(next & count_mask))
+				next = 0u;
+		}
+		while (!m_state.compare_exchange_weak(state, next, std::memory_order_release, std::memory_order_relaxed));
+
+		if (!next && (state & sleepers_bit))
+			futex(&m_state, ops::wake, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	//! Whether the counter reached zero, never blocks
+	bool try_wait() const noexcept
+	{
+		return !(m_state.load(std::memory_order_acquire) & count_mask);
+	}
+
+	void wait()
+	{
+		if (!try_wait())
+			wait_slow(nullptr);
+	}
+
+	template< typename Rep, typename Period >
+	bool wait_for(const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(waited_time);
+		return wait_slow(&deadline);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool wait_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		if (try_wait())
+			return true;
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return wait_slow(&deadline);
+	}
+
+	//! count_down(n) and wait
+	void arrive_and_wait(std::uint32_t n = 1u)
+	{
+		count_down(n);
+		wait();
+	}
+
+	//! Current counter, for diagnostics
+	std::uint32_t count() const noexcept
+	{
+		return m_state.load(std::memory_order_relaxed) & count_mask;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! Sets the sleepers flag and sleeps while the counter is positive
+	bool wait_slow(const futex_deadline* deadline)
+	{
+		std::uint32_t state = m_state.load(std::memory_order_acquire);
+		while (state & count_mask)
+		{
+			if (!(state & sleepers_bit))
+			{
+				if (!m_state.compare_exchange_weak(state, state | sleepers_bit, std::memory_order_acquire, std::memory_order_acquire))
+					continue;
+				state |= sleepers_bit;
+			}
+
+			int res = deadline
+				? futex(&m_state, ops::wait_bitset | deadline->clock_flag, static_cast< int >(state), &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&m_state, ops::wait, static_cast< int >(state), nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+				return try_wait();
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			state = m_state.load(std::memory_order_acquire);
+		}
+		return true;
+	}
+
+	//! Sleepers flag and counter
+	std::atomic< std::uint32_t > m_state;
+};
+
+#endif
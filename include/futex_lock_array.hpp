@@ -0,0 +1,163 @@
+#ifndef FUTEX_LOCK_ARRAY_HPP_
+#define FUTEX_LOCK_ARRAY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+#include "common.hpp"
+#include "futex_mutex.hpp"
+
+//! Striped lock table: a fixed array of mutexes, a key is hashed into one of the stripes.
+//! Locks rows of a big table without a mutex per row, concurrency is bounded by the stripe count.
+//!
+//! The table holds the mutexes only, so it can be placed in shared memory with placement new
+//! and used by several processes with shared_policy::interprocess. The stripe of a key depends
+//! on its hash only: all the processes must use the same hash function.
+//!
+//! Several keys are locked together with futex_lock_array_guard: the stripes are locked
+//! in ascending order, so two threads locking {A, B} and {B, A} don't deadlock.
+//!
+//! stripes: count of the mutexes, any positive number
+//! layout: cache_aligned puts every stripe on its own cache line (stripes * 64 bytes),
+//! packed keeps the futex words only (stripes * 4 bytes) at the price of false sharing
+//! backoff: pause strategy of the mutexes, which spin before they sleep while backoff::enabled(),
+//! no_spin_backoff makes them sleep at once, see futex_spin_policy.hpp
+//! NOTE: not derived from boost::noncopyable, the empty base would pad the first stripe;
+//! the mutexes make the table noncopyable anyway
+template< shared_policy policy, std::size_t stripes, futex_layout layout = futex_layout::cache_aligned, typename backoff = default_backoff >
+class futex_lock_array
+{
+	static_assert(stripes > 0u, "Lock array must have at least one stripe");
+
+public:
+	//! Stripe mutex type
+	using mutex_t = futex_mutex< policy, true, backoff, layout >;
+
+	//! Count of the stripes
+	static constexpr std::size_t size() noexcept
+	{
+		return stripes;
+	}
+
+	//! Stripe index of a precomputed hash, the hash bits are mixed so the low entropy hashes
+	//! like std::hash of integers spread evenly
+	static constexpr std::size_t index_of_hash(std::uint64_t hash) noexcept
+	{
+		hash ^= hash >> 32u;
+		hash *= 0x9e3779b97f4a7c15ull;
+		return static_cast< std::size_t >((hash >> 32u) % stripes);
+	}
+
+	//! Stripe index of a key
+	template< typename Key, typename Hash = std::hash< Key > >
+	static std::size_t index_of(const Key& key) noexcept(noexcept(Hash{}(key)))
+	{
+		return index_of_hash(Hash{}(key));
+	}
+
+	mutex_t& stripe(std::size_t index) noexcept
+	{
+		return m_stripes[index];
+	}
+
+	//! Mutex of a key
+	template< typename Key, typename Hash = std::hash< Key > >
+	mutex_t& operator[](const Key& key) noexcept(noexcept(Hash{}(key)))
+	{
+		return m_stripes[index_of< Key, Hash >(key)];
+	}
+
+	//! Sorts and deduplicates the indices and locks the stripes in ascending order.
+	//! Returns the count of the distinct stripes, they are at the beginning of the array.
+	template< std::size_t count >
+	std::size_t lock_ordered(std::array< std::size_t, count >& indices)
+	{
+		const std::size_t distinct = sort_unique(indices);
+		for (std::size_t cc = 0; cc < distinct; ++cc)
+		{
+			try
+			{
+				m_stripes[indices[cc]].lock();
+			}
+			catch (...)
+			{
+				unlock_ordered(indices, cc);
+				throw;
+			}
+		}
+		return distinct;
+	}
+
+	//! Tries to lock all the stripes, nothing stays locked on failure
+	template< std::size_t count >
+	bool try_lock_ordered(std::array< std::size_t, count >& indices, std::size_t& distinct)
+	{
+		distinct = sort_unique(indices);
+		for (std::size_t cc = 0; cc < distinct; ++cc)
+		{
+			if (!m_stripes[indices[cc]].try_lock())
+			{
+				unlock_ordered(indices, cc);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//! Unlocks the first distinct stripes locked by lock_ordered in reverse order
+	template< std::size_t count >
+	void unlock_ordered(const std::array< std::size_t, count >& indices, std::size_t distinct) noexcept
+	{
+		while (distinct)
+			m_stripes[indices[--distinct]].unlock();
+	}
+
+private:
+	template< std::size_t count >
+	static std::size_t sort_unique(std::array< std::size_t, count >& indices) noexcept
+	{
+		std::sort(indices.begin(), indices.end());
+		return static_cast< std::size_t >(std::unique(indices.begin(), indices.end()) - indices.begin());
+	}
+
+	std::array< mutex_t, stripes > m_stripes;
+};
+
+
+//! RAII locker of the stripes of several keys, the keys sharing a stripe lock it once.
+//! Usage:
+//!     futex_lock_array_guard guard(locks, from_account, to_account);
+template< typename LockArray, std::size_t count >
+class futex_lock_array_guard : boost::noncopyable
+{
+public:
+	template< typename... Keys >
+	explicit futex_lock_array_guard(LockArray& locks, const Keys&... keys)
+	: m_locks(locks), m_indices{{ LockArray::index_of(keys)... }}, m_distinct(0u)
+	{
+		static_assert(sizeof...(Keys) == count, "Key count must match the guard size");
+		m_distinct = m_locks.lock_ordered(m_indices);
+	}
+
+	~futex_lock_array_guard() noexcept
+	{
+		m_locks.unlock_ordered(m_indices, m_distinct);
+	}
+
+	//! Count of the locked stripes
+	std::size_t locked() const noexcept
+	{
+		return m_distinct;
+	}
+
+private:
+	LockArray& m_locks;
+	std::array< std::size_t, count > m_indices;
+	std::size_t m_distinct;
+};
+
+template< typename LockArray, typename... Keys >
+futex_lock_array_guard(LockArray&, const Keys&...) -> futex_lock_array_guard< LockArray, sizeof...(Keys) >;
+
+#endif
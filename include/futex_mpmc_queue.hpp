@@ -0,0 +1,408 @@
+#ifndef FUTEX_MPMC_QUEUE_HPP_
+#define FUTEX_MPMC_QUEUE_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_spin_policy.hpp"
+
+//! Bounded multi-producer multi-consumer ring queue, Vyukov design:
+//! https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+//! Every slot has a sequence number which tells producers and consumers of which lap the slot is,
+//! so push and pop are one CAS on the position while the queue is neither full nor empty.
+//! Blocking operations spin briefly and then sleep in futex on the word of their side:
+//! consumers on the empty boundary, producers on the full one. The other side bumps the epoch
+//! of the word and makes a FUTEX_WAKE only if the sleepers count in the word is nonzero.
+//! Batch operations claim a run of consecutive slots with one CAS and wake with one syscall.
+//!
+//! shared policy: whether a queue can be shared by different processes or not.
+//! The items are stored inline, interprocess queues require trivially copyable items.
+//! capacity: number of slots, a power of two
+//! NOTE: at most 65535 threads sleep on one side
+template< shared_policy policy, typename T, std::size_t capacity, typename backoff = default_backoff >
+class futex_mpmc_queue : boost::noncopyable
+{
+	static_assert(capacity >= 2u && !(capacity & (capacity - 1u)), "Capacity must be a power of two");
+	static_assert(policy == shared_policy::inprocess || std::is_trivially_copyable< T >::value,
+		"Items of an interprocess queue must be trivially copyable");
+
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Spin attempts before sleeping
+	enum : std::uint32_t { spin_count = 100u };
+
+	//! Slot of the ring: the sequence is the position which may use the slot next,
+	//! position for producers, position + 1 for consumers.
+	//! The items are reached through std::launder (C++17): each one is a new object in the storage.
+	struct slot
+	{
+		std::atomic< std::uint64_t > sequence;
+		typename std::aligned_storage< sizeof(T), alignof(T) >::type storage;
+	};
+
+	//! Sleepers of one boundary: one futex word [ epoch:16 | sleepers:16 ].
+	//! Every sleeper takes itself off the count when it stops waiting, so the count is exact;
+	//! a notify only bumps the epoch, which fails the FUTEX_WAIT of a sleeper not asleep yet.
+	struct alignas(64) sleep_side
+	{
+		std::atomic< std::uint32_t > state{0u};
+	};
+
+	enum : std::uint32_t
+	{
+		sleepers_mask	= 0xffffu,
+		epoch_one		= 0x10000u
+	};
+
+public:
+	futex_mpmc_queue()
+	{
+		for (std::size_t index = 0; index < capacity; ++index)
+			m_slots[index].sequence.store(index, std::memory_order_relaxed);
+		if (!m_enqueue_pos.is_lock_free() || !m_not_empty.state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "Queue positions must be lock-free");
+	}
+
+	//! Destroys the items left in the queue
+	~futex_mpmc_queue()
+	{
+		const std::uint64_t tail = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (std::uint64_t pos = m_dequeue_pos.load(std::memory_order_relaxed); pos < tail; ++pos)
+		{
+			slot& cell = m_slots[pos & (capacity - 1u)];
+			if (cell.sequence.load(std::memory_order_relaxed) == pos + 1u)
+				std::launder(reinterpret_cast< T* >(&cell.storage))->~T();
+		}
+	}
+
+	//! Number of slots
+	static constexpr std::size_t size() noexcept
+	{
+		return capacity;
+	}
+
+	//! Number of items, may be outdated at once
+	std::size_t size_approx() const noexcept
+	{
+		const std::uint64_t head = m_dequeue_pos.load(std::memory_order_relaxed);
+		const std::uint64_t tail = m_enqueue_pos.load(std::memory_order_relaxed);
+		return tail > head ? static_cast< std::size_t >(tail - head) : 0u;
+	}
+
+	//! Pushes if the queue isn't full, never blocks
+	template< typename U >
+	bool try_push(U&& item)
+	{
+		if (!push_one(std::forward< U >(item)))
+			return false;
+		notify(m_not_empty, 1u);
+		return true;
+	}
+
+	//! Pushes, sleeps while the queue is full
+	template< typename U >
+	void push(U&& item)
+	{
+		wait(m_not_full, [&]() { return push_one(std::forward< U >(item)); }, nullptr);
+		notify(m_not_empty, 1u);
+	}
+
+	template< typename U, typename Rep, typename Period >
+	bool push_for(U&& item, const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		if (!push_one(std::forward< U >(item)))
+		{
+			const futex_deadline deadline = make_futex_deadline(waited_time);
+			if (!wait(m_not_full, [&]() { return push_one(std::forward< U >(item)); }, &deadline))
+				return false;
+		}
+		notify(m_not_empty, 1u);
+		return true;
+	}
+
+	//! Pops if the queue isn't empty, never blocks
+	bool try_pop(T& item)
+	{
+		if (!pop_one(item))
+			return false;
+		notify(m_not_full, 1u);
+		return true;
+	}
+
+	//! Pops, sleeps while the queue is empty
+	void pop(T& item)
+	{
+		wait(m_not_empty, [&]() { return pop_one(item); }, nullptr);
+		notify(m_not_full, 1u);
+	}
+
+	template< typename Rep, typename Period >
+	bool pop_for(T& item, const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		if (!pop_one(item))
+		{
+			const futex_deadline deadline = make_futex_deadline(waited_time);
+			if (!wait(m_not_empty, [&]() { return pop_one(item); }, &deadline))
+				return false;
+		}
+		notify(m_not_full, 1u);
+		return true;
+	}
+
+	//! Copies up to count items into the free slots, never blocks. Returns number of pushed items.
+	std::size_t try_push_batch(const T* items, std::size_t count)
+	{
+		const std::size_t pushed = push_run(items, count);
+		if (pushed)
+			notify(m_not_empty, pushed);
+		return pushed;
+	}
+
+	//! Pushes all the items, sleeps while the queue is full
+	void push_batch(const T* items, std::size_t count)
+	{
+		while (count)
+		{
+			std::size_t pushed = 0u;
+			wait(m_not_full, [&]() { return (pushed = push_run(items, count)) != 0u; }, nullptr);
+			notify(m_not_empty, pushed);
+			items += pushed;
+			count -= pushed;
+		}
+	}
+
+	//! Moves up to count items out of the queue, never blocks. Returns number of popped items.
+	std::size_t try_pop_batch(T* items, std::size_t count)
+	{
+		const std::size_t popped = pop_run(items, count);
+		if (popped)
+			notify(m_not_full, popped);
+		return popped;
+	}
+
+	//! Sleeps while the queue is empty, then pops up to count items. Returns number of popped items.
+	std::size_t pop_batch(T* items, std::size_t count)
+	{
+		if (!count)
+			return 0u;
+		std::size_t popped = 0u;
+		wait(m_not_empty, [&]() { return (popped = pop_run(items, count)) != 0u; }, nullptr);
+		notify(m_not_full, popped);
+		return popped;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! The item is moved only if the push succeeds, so a failed attempt may be repeated
+	template< typename U >
+	bool push_one(U&& item)
+	{
+		std::uint64_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot& cell = m_slots[pos & (capacity - 1u)];
+			const std::int64_t diff = static_cast< std::int64_t >(cell.sequence.load(std::memory_order_acquire) - pos);
+			if (!diff)
+			{
+				if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed, std::memory_order_relaxed))
+				{
+					new (&cell.storage) T(std::forward< U >(item));
+					cell.sequence.store(pos + 1u, std::memory_order_release);
+					return true;
+				}
+			}
+			// the slot still holds an item of the previous lap
+			else if (diff < 0)
+				return false;
+			else
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	bool pop_one(T& item)
+	{
+		std::uint64_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot& cell = m_slots[pos & (capacity - 1u)];
+			const std::int64_t diff = static_cast< std::int64_t >(cell.sequence.load(std::memory_order_acquire) - (pos + 1u));
+			if (!diff)
+			{
+				if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed, std::memory_order_relaxed))
+				{
+					take(cell, pos, item);
+					return true;
+				}
+			}
+			// the slot isn't filled yet
+			else if (diff < 0)
+				return false;
+			else
+				pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	//! Claims a run of consecutive free slots with one CAS. A free slot stays free until
+	//! its position is claimed, so the slots checked before the CAS are still free after it.
+	std::size_t push_run(const T* items, std::size_t count)
+	{
+		std::uint64_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			std::size_t run = 0u;
+			while (run < count && run < capacity && m_slots[(pos + run) & (capacity - 1u)].sequence.load(std::memory_order_acquire) == pos + run)
+				++run;
+			if (!run)
+			{
+				// full or the position is outdated
+				const std::uint64_t current = m_enqueue_pos.load(std::memory_order_relaxed);
+				if (current == pos)
+					return 0u;
+				pos = current;
+				continue;
+			}
+			if (m_enqueue_pos.compare_exchange_weak(pos, pos + run, std::memory_order_relaxed, std::memory_order_relaxed))
+			{
+				for (std::size_t index = 0; index < run; ++index)
+				{
+					slot& cell = m_slots[(pos + index) & (capacity - 1u)];
+					new (&cell.storage) T(items[index]);
+					cell.sequence.store(pos + index + 1u, std::memory_order_release);
+				}
+				return run;
+			}
+		}
+	}
+
+	//! Claims a run of consecutive filled slots with one CAS, see push_run
+	std::size_t pop_run(T* items, std::size_t count)
+	{
+		std::uint64_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			std::size_t run = 0u;
+			while (run < count && run < capacity && m_slots[(pos + run) & (capacity - 1u)].sequence.load(std::memory_order_acquire) == pos + run + 1u)
+				++run;
+			if (!run)
+			{
+				// empty or the position is outdated
+				const std::uint64_t current = m_dequeue_pos.load(std::memory_order_relaxed);
+				if (current == pos)
+					return 0u;
+				pos = current;
+				continue;
+			}
+			if (m_dequeue_pos.compare_exchange_weak(pos, pos + run, std::memory_order_relaxed, std::memory_order_relaxed))
+			{
+				for (std::size_t index = 0; index < run; ++index)
+					take(m_slots[(pos + index) & (capacity - 1u)], pos + index, items[index]);
+				return run;
+			}
+		}
+	}
+
+	//! Moves the item out of a claimed slot and frees the slot for the next lap
+	static void take(slot& cell, std::uint64_t pos, T& item)
+	{
+		T* stored = std::launder(reinterpret_cast< T* >(&cell.storage));
+		item = std::move(*stored);
+		stored->~T();
+		cell.sequence.store(pos + capacity, std::memory_order_release);
+	}
+
+	//! Runs op until it succeeds: a bounded spin, then sleeps on the word of the side.
+	//! The sleeper registers before the last check, so the other side either sees it
+	//! after its own update or the check sees the update.
+	template< typename Op >
+	bool wait(sleep_side& side, Op op, const futex_deadline* deadline)
+	{
+		if (op())
+			return true;
+		if (backoff::enabled())
+		{
+			backoff spin_backoff;
+			for (std::uint32_t spin = 0; spin < spin_count; ++spin)
+			{
+				spin_backoff.pause();
+				if (op())
+					return true;
+			}
+		}
+
+		for (;;)
+		{
+			const std::uint32_t state = side.state.fetch_add(1u, std::memory_order_seq_cst) + 1u;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (op())
+			{
+				unregister(side);
+				return true;
+			}
+
+			int res = deadline
+				? futex(&side.state, ops::wait_bitset | deadline->clock_flag, static_cast< int >(state), &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&side.state, ops::wait, static_cast< int >(state), nullptr, nullptr, 0);
+			unregister(side);
+			if (res != 0 && errno == ETIMEDOUT)
+				return op();
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			if (op())
+				return true;
+		}
+	}
+
+	//! Takes the sleeper off the count, whatever the epoch is now
+	static void unregister(sleep_side& side) noexcept
+	{
+		side.state.fetch_sub(1u, std::memory_order_relaxed);
+	}
+
+	//! Wakes up to count sleepers of the side, no syscall if nobody sleeps.
+	//! The epoch wraps around in the upper half of the word.
+	void notify(sleep_side& side, std::size_t count) noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::uint32_t state = side.state.load(std::memory_order_relaxed);
+		while (state & sleepers_mask)
+		{
+			const std::uint32_t sleepers = state & sleepers_mask;
+			const std::uint32_t woken = count < sleepers ? static_cast< std::uint32_t >(count) : sleepers;
+			if (side.state.compare_exchange_weak(state, state + epoch_one, std::memory_order_release, std::memory_order_relaxed))
+			{
+				futex(&side.state, ops::wake, static_cast< int >(woken), nullptr, nullptr, 0);
+				return;
+			}
+		}
+	}
+
+	//! Next position of producers
+	alignas(64) std::atomic< std::uint64_t > m_enqueue_pos{0u};
+	//! Next position of consumers
+	alignas(64) std::atomic< std::uint64_t > m_dequeue_pos{0u};
+	//! Consumers sleeping on an empty queue
+	sleep_side m_not_empty;
+	//! Producers sleeping on a full queue
+	sleep_side m_not_full;
+	alignas(64) slot m_slots[capacity];
+};
+
+#endif
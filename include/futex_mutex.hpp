@@ -9,9 +9,55 @@
 #include <linux/futex.h>
 
 #include "common.hpp"
+#include "futex_spin_policy.hpp"
+#include "futex_deadline.hpp"
+#include "futex_stats.hpp"
+#include "futex_probes.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <iostream>
 
+template< shared_policy policy, typename stats = futex_no_stats >
+class futex_condition_variable;
+
+namespace futex_detail
+{
+
+//! Running statistics of the adaptive spin, see futex_mutex::spin_loop.
+//! NOTE: updated racy with relaxed order, it is a hint only
+//! Upper bound of the spin success rate in 1/1024 units
+constexpr std::int16_t adaptive_spin_score_max = 1024;
+
+template< bool enabled, std::int16_t initial_score >
+class adaptive_spin_stats
+{
+public:
+	//! Estimate of spin iterations needed for success
+	std::int16_t estimate() const noexcept { return m_estimate.load(std::memory_order_relaxed); }
+	//! Spin success rate
+	std::int16_t score() const noexcept { return m_score.load(std::memory_order_relaxed); }
+	void set_estimate(std::int16_t estimate) noexcept { m_estimate.store(estimate, std::memory_order_relaxed); }
+	void set_score(std::int16_t score) noexcept { m_score.store(score, std::memory_order_relaxed); }
+
+private:
+	std::atomic< std::int16_t > m_estimate{0};
+	std::atomic< std::int16_t > m_score{initial_score};
+};
+
+//! No room for statistics: the spin always runs to its upper bound
+template< std::int16_t initial_score >
+class adaptive_spin_stats< false, initial_score >
+{
+public:
+	std::int16_t estimate() const noexcept { return std::numeric_limits< std::int8_t >::max(); }
+	std::int16_t score() const noexcept { return initial_score; }
+	void set_estimate(std::int16_t) noexcept {}
+	void set_score(std::int16_t) noexcept {}
+};
+
+} // namespace futex_detail
+
 //! Simplest mutex realization via futex syscall. Based on:
 //! https://preshing.com/20120226/roll-your-own-lightweight-mutex/
 //! https://akkadia.org/drepper/futex.pdf
@@ -19,11 +65,26 @@
 //!
 //! shared policy: whether a mutex can synchronize different processes or not
 //! use_spinlock: whether to use a spinlock at the beginning of a lock.
+//! backoff: pause strategy between spin attempts, see futex_spin_policy.hpp
 //! http://www.alexonlinux.com/pthread-mutex-vs-pthread-spinlock
 //! NOTE: with a spin loop it got even worse.
-template< shared_policy policy, bool use_spinlock = false >
-class futex_mutex : boost::noncopyable
+//! The spin is adaptive like PTHREAD_MUTEX_ADAPTIVE_NP in glibc:
+//! https://github.com/bminor/glibc/blob/master/nptl/pthread_mutex_lock.c
+//! every mutex keeps a running estimate of spin iterations needed to get the lock
+//! and spins at most twice that, and stops spinning at all if the spin rarely succeeds.
+//! Meets the TimedLockable requirements: try_lock, try_lock_for and try_lock_until.
+//!
+//! layout: memory layout, see futex_layout. The packed mutex is exactly its 32-bit futex word,
+//! zero-filled memory is an unlocked mutex. It keeps no spin statistics and spins to the upper bound.
+//! stats: contention statistics, see futex_stats.hpp. futex_no_stats costs nothing.
+template< shared_policy policy, bool use_spinlock = false, typename backoff = default_backoff, futex_layout layout = futex_layout::standard, typename stats = futex_no_stats >
+class alignas(layout == futex_layout::cache_aligned ? futex_cache_line_size : alignof(std::uint32_t)) futex_mutex : boost::noncopyable
+	, private futex_detail::ebo_holder< futex_detail::adaptive_spin_stats< layout != futex_layout::packed, futex_detail::adaptive_spin_score_max >, 0 >
+	, private futex_detail::ebo_holder< stats, 1 >
 {
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
 	//! States of mutex
 	enum : std::uint32_t
 	{
@@ -37,21 +98,16 @@ public:
 	{
 		if (!m_state.is_lock_free())
 			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
-		m_wait_op = (policy == shared_policy::inprocess ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT);
-		m_wake_op = (policy == shared_policy::inprocess ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE);
 	}
 
 	void lock()
 	{
-		// simple spin loop
-		if (use_spinlock && need_spinlock())
+		std::uint32_t prev{0};
+		if (std::atomic_compare_exchange_strong(&m_state, &prev, (std::uint32_t)locked_no_waiters))
 		{
-			if (spin_loop())
-				return;
+			stats_holder::held().acquired(false, 0u);
+			return;
 		}
-
-		std::uint32_t prev{0};
-		if (!std::atomic_compare_exchange_strong(&m_state, &prev, (std::uint32_t)locked_no_waiters))
 		// NOTE: previous string emulated this CAS semantics:
 		//int CAS( int * pAddr, int nExpected, int nNew )
 		//atomically {
@@ -62,41 +118,143 @@ public:
 		//	else
 		//		return *pAddr
 		//	}
+
+		FUTEX_PROBE1(mutex_acquire_start, this);
+		const std::uint64_t wait_start = stats::now();
+		if (spin_acquire(prev))
 		{
-			if (prev != locked_no_waiters)
-				prev = std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters);
+			stats_holder::held().acquired(true, wait_start);
+			FUTEX_PROBE2(mutex_acquire_end, this, 1);
+			return;
+		}
 
-			while (prev != unlocked)
-			{
-				int res = futex(&m_state, m_wait_op, locked_has_waiters, nullptr, nullptr, 0);
-				if (res != 0 && errno != EAGAIN)
-					THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		if (prev != locked_no_waiters)
+			prev = std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters);
+		wait_unlocked(prev, nullptr);
+		stats_holder::held().acquired(true, wait_start);
+		FUTEX_PROBE2(mutex_acquire_end, this, 1);
+	}
 
-				// now retry
-				prev = std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters);
-			}
+	bool try_lock() noexcept
+	{
+		std::uint32_t prev{0};
+		if (!std::atomic_compare_exchange_strong(&m_state, &prev, (std::uint32_t)locked_no_waiters))
+			return false;
+		stats_holder::held().acquired(false, 0u);
+		return true;
+	}
+
+	template< typename Rep, typename Period >
+	bool try_lock_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		return try_lock_until(make_futex_deadline(timeout_duration));
+	}
+
+	//! Deadline clocks, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool try_lock_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		return try_lock_until(make_futex_deadline(timeout_time));
+	}
+
+	bool try_lock_until(const futex_deadline& deadline)
+	{
+		std::uint32_t prev{0};
+		if (std::atomic_compare_exchange_strong(&m_state, &prev, (std::uint32_t)locked_no_waiters))
+		{
+			stats_holder::held().acquired(false, 0u);
+			return true;
+		}
+
+		FUTEX_PROBE1(mutex_acquire_start, this);
+		const std::uint64_t wait_start = stats::now();
+		if (spin_acquire(prev))
+		{
+			stats_holder::held().acquired(true, wait_start);
+			FUTEX_PROBE2(mutex_acquire_end, this, 1);
+			return true;
+		}
+
+		if (prev != locked_no_waiters)
+			prev = std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters);
+		// NOTE: on timeout the state stays locked_has_waiters, the next unlock makes one extra wake syscall
+		if (!wait_unlocked(prev, &deadline))
+		{
+			FUTEX_PROBE2(mutex_acquire_end, this, 0);
+			return false;
 		}
+		stats_holder::held().acquired(true, wait_start);
+		FUTEX_PROBE2(mutex_acquire_end, this, 1);
+		return true;
+	}
+
+	//! Lock for a thread woken up by a condition variable.
+	//! Always marks the mutex as having waiters: notify_all requeues the other waiters
+	//! of the condition variable to the mutex futex, and unlock() must wake them up.
+	void lock_contended()
+	{
+		FUTEX_PROBE1(mutex_acquire_start, this);
+		const std::uint64_t wait_start = stats::now();
+		wait_unlocked(std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters), nullptr);
+		stats_holder::held().acquired(true, wait_start);
+		FUTEX_PROBE2(mutex_acquire_end, this, 1);
 	}
 
 	void unlock() noexcept
 	{
 		std::uint32_t prev;
+		stats_holder::held().released();
 		// if (atomic_dec (val) != 1)
 		if ((prev = std::atomic_fetch_sub(&m_state, 1u)) != locked_no_waiters)
 		{
 			m_state.store(unlocked);
 
 			// Wake just one thread/process
-			futex(&m_state, m_wake_op, 1, nullptr, nullptr, 0);
+			stats_holder::held().futex_wake();
+			FUTEX_PROBE2(futex_wake, &m_state, 1);
+			futex(&m_state, ops::wake, 1, nullptr, nullptr, 0);
 		}
 	}
 
+	//! Futex word of the mutex, used by condition variable to requeue waiters
+	std::atomic< std::uint32_t >* native_handle() noexcept
+	{
+		return &m_state;
+	}
+
+	//! Contention statistics, see futex_stats.hpp
+	const stats& statistics() const noexcept
+	{
+		return stats_holder::held();
+	}
+
+	stats& statistics() noexcept
+	{
+		return stats_holder::held();
+	}
+
 private:
+	//! Adaptive spin constants
+	enum : std::int16_t
+	{
+		//! upper bound of spin iterations (glibc default)
+		spin_count_max		= 100,
+		//! spin success rate in 1/1024 units, below threshold spin is skipped
+		spin_score_max		= futex_detail::adaptive_spin_score_max,
+		spin_score_threshold	= 128
+	};
+
 	//! Mutex current state
 	std::atomic< std::uint32_t > m_state;
-	//! Futex options
-	int m_wait_op;
-	int m_wake_op;
+	//! Adaptive spin statistics, none in the packed layout
+	using spin_stats_holder = futex_detail::ebo_holder< futex_detail::adaptive_spin_stats< layout != futex_layout::packed, spin_score_max >, 0 >;
+	//! Contention statistics
+	using stats_holder = futex_detail::ebo_holder< stats, 1 >;
+
+	auto& spin_stats() noexcept
+	{
+		return spin_stats_holder::held();
+	}
 
 	//! Base wrapper for futex syscall
 	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
@@ -104,26 +262,86 @@ private:
 		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
 	}
 
-	//! Spin loop
+	//! Slow path: sleep until the mutex is unlocked, prev is result of exchange to locked_has_waiters.
+	//! Returns false if the deadline expired.
+	bool wait_unlocked(std::uint32_t prev, const futex_deadline* deadline)
+	{
+		while (prev != unlocked)
+		{
+			stats_holder::held().futex_wait();
+			FUTEX_PROBE2(futex_wait, &m_state, locked_has_waiters);
+			int res = deadline
+				? futex(&m_state, ops::wait_bitset | deadline->clock_flag, locked_has_waiters, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&m_state, ops::wait, locked_has_waiters, nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+				return false;
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+
+			// now retry
+			prev = std::atomic_exchange(&m_state, (std::uint32_t)locked_has_waiters);
+			if (res == 0 && prev != unlocked)
+				stats_holder::held().spurious_wakeup();
+		}
+		return true;
+	}
+
+	//! Spins if the mutex is contended and spinning is enabled, prev is updated with the last seen state
+	bool spin_acquire(std::uint32_t& prev) noexcept
+	{
+		if (use_spinlock && backoff::enabled())
+		{
+			if (spin_loop())
+				return true;
+			prev = m_state.load();
+		}
+		return false;
+	}
+
+	//! Adaptive spin loop
 	bool spin_loop() noexcept
 	{
-		int spin{100};
-		while (spin--)
+		std::int16_t score = spin_stats().score();
+		if (score < spin_score_threshold)
+		{
+			// spinning doesn't pay off for this mutex, go to sleep at once
+			// but let the score recover slowly to probe spinning again later
+			spin_stats().set_score(score + 1);
+			return false;
+		}
+
+		const std::int16_t estimate = spin_stats().estimate();
+		const std::int16_t max_spin = std::min< std::int16_t >(spin_count_max, estimate * 2 + 10);
+		backoff spin_backoff;
+		for (std::int16_t spin = 0; spin < max_spin; ++spin)
 		{
-			if (m_state.load() == (std::uint32_t)unlocked)
+			if (m_state.load(std::memory_order_relaxed) == (std::uint32_t)unlocked)
 			{
 				std::uint32_t val = (std::uint32_t)unlocked;
 				if (std::atomic_compare_exchange_strong(&m_state, &val, (std::uint32_t)locked_no_waiters))
+				{
+					stats_holder::held().spin_success();
+					spin_stats().set_estimate(estimate + (spin - estimate) / 8);
+					spin_stats().set_score(score + (spin_score_max - score) / 8);
 					return true;
+				}
 			}
 
 			//pause
-			spinlock_pause();
+			spin_backoff.pause();
 		}
+
+		spin_stats().set_estimate(estimate + (max_spin - estimate) / 8);
+		spin_stats().set_score(score - score / 8);
 		return false;
 	}
 };
 
+static_assert(sizeof(futex_mutex< shared_policy::interprocess, false, default_backoff, futex_layout::packed >) == sizeof(std::uint32_t),
+	"packed mutex must be the futex word only");
+static_assert(sizeof(futex_mutex< shared_policy::interprocess, false, default_backoff, futex_layout::cache_aligned >) == futex_cache_line_size,
+	"cache aligned mutex must fill one cache line");
+
 
 //! Basic RAII locker
 template < typename MutexType >
@@ -192,7 +410,30 @@ public:
 		return ret;
 	}
 
+	MutexType* mutex() const noexcept
+	{
+		return m_mutex;
+	}
+
+	bool owns_lock() const noexcept
+	{
+		return m_owns;
+	}
+
 private:
+	template< shared_policy, typename > friend class futex_condition_variable;
+
+	//! Relock after wake up from condition variable
+	void lock_contended()
+	{
+		if (!m_mutex)
+			THROW_EXCEPTION(futex_scoped_error, "Mutex cannot be nullptr");
+		else if (m_owns)
+			THROW_EXCEPTION(futex_scoped_error, "Mutex already locked");
+		m_mutex->lock_contended();
+		m_owns = true;
+	}
+
 	MutexType*	m_mutex;
 	bool m_owns;
 };
@@ -0,0 +1,113 @@
+#ifndef FUTEX_ONCE_HPP_
+#define FUTEX_ONCE_HPP_
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "common.hpp"
+
+//! One-time initialization flag on a single futex word, semantics of std::call_once.
+//! Unlike std::once_flag it may be placed in shared memory and used by several processes
+//! with shared_policy::interprocess. Completed call is one acquire load.
+//! If the callable throws, the flag returns to the initial state and another caller runs it.
+//!
+//! shared policy: whether a flag can synchronize different processes or not
+//! NOTE: if a process dies inside the callable, the other callers wait forever
+template< shared_policy policy >
+class futex_once : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Flag states
+	enum : std::uint32_t
+	{
+		initial				= 0u,
+		running				= 1u,
+		running_sleepers	= 2u,
+		done				= 3u
+	};
+
+public:
+	futex_once() noexcept = default;
+
+	//! Invokes f(args...) if no call completed yet, otherwise waits for the running call.
+	//! f may be a member pointer like in std::call_once, std::invoke needs C++17.
+	template< typename Callable, typename... Args >
+	void call(Callable&& f, Args&&... args)
+	{
+		if (m_state.load(std::memory_order_acquire) == done)
+			return;
+
+		std::uint32_t state = initial;
+		while (!m_state.compare_exchange_strong(state, running, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			if (state == done)
+				return;
+			wait_running(state);
+			state = initial;
+		}
+
+		try
+		{
+			std::invoke(std::forward< Callable >(f), std::forward< Args >(args)...);
+		}
+		catch (...)
+		{
+			// one of the sleepers takes over
+			if (m_state.exchange(initial, std::memory_order_release) == running_sleepers)
+				futex(&m_state, ops::wake, INT_MAX, nullptr, nullptr, 0);
+			throw;
+		}
+
+		if (m_state.exchange(done, std::memory_order_release) == running_sleepers)
+			futex(&m_state, ops::wake, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	//! Whether a call completed
+	bool is_done() const noexcept
+	{
+		return m_state.load(std::memory_order_acquire) == done;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	//! Sleeps while another caller runs the callable
+	void wait_running(std::uint32_t state)
+	{
+		while (state == running || state == running_sleepers)
+		{
+			if (state == running && !m_state.compare_exchange_weak(state, running_sleepers, std::memory_order_acquire, std::memory_order_acquire))
+				continue;
+
+			int res = futex(&m_state, ops::wait, static_cast< int >(running_sleepers), nullptr, nullptr, 0);
+			if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			state = m_state.load(std::memory_order_acquire);
+		}
+	}
+
+	//! Call state
+	std::atomic< std::uint32_t > m_state{initial};
+};
+
+//! std::call_once analog
+template< shared_policy policy, typename Callable, typename... Args >
+void futex_call_once(futex_once< policy >& flag, Callable&& f, Args&&... args)
+{
+	flag.call(std::forward< Callable >(f), std::forward< Args >(args)...);
+}
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef FUTEX_PARKING_LOT_HPP_
+#define FUTEX_PARKING_LOT_HPP_
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "futex_mutex.hpp"
+#include "futex_deadline.hpp"
+
+//! How park returned
+enum class futex_park_status
+{
+	//! unpark_one or unpark_all dequeued the thread
+	unparked,
+	//! validate returned false, the thread didn't sleep
+	invalid,
+	//! the deadline expired before an unpark
+	timed_out
+};
+
+//! Result of futex_parking_lot::park
+struct futex_park_result
+{
+	futex_park_status status;
+	//! Token returned by the unpark_one callback, 0 otherwise
+	std::intptr_t token;
+};
+
+//! Passed to the unpark_one callback under the bucket lock
+struct futex_unpark_result
+{
+	//! Whether a thread was dequeued
+	bool unparked;
+	//! Whether more threads are parked on the address
+	bool more_parked;
+	//! Time to hand the resource over directly, see futex_parking_lot
+	bool be_fair;
+};
+
+namespace futex_detail
+{
+
+//! Wait queue entry of a thread, one per thread. The unparker signals the word,
+//! a late FUTEX_WAKE only causes a spurious wakeup of a later park of the same thread.
+struct park_node
+{
+	const void* address;
+	park_node* next;
+	std::intptr_t token;
+	std::atomic< std::uint32_t > unparked;
+};
+
+//! Wait queues of the addresses hashed to the bucket, FIFO per address
+struct alignas(64) park_bucket
+{
+	//! Bucket lock is held for a few pointer operations, so it spins
+	futex_mutex< shared_policy::inprocess, true, default_backoff, futex_layout::packed > mutex;
+	park_node* head = nullptr;
+	park_node* tail = nullptr;
+	//! Next time an unpark_one reports be_fair, in steady_clock nanoseconds
+	std::uint64_t fair_time_ns = 0u;
+	//! xorshift state of the fairness interval
+	std::uint32_t random = 0x9e3779b9u;
+};
+
+} // namespace futex_detail
+
+//! Global hashed table of wait queues keyed by address, in the spirit of WebKit ParkingLot:
+//! https://webkit.org/blog/6161/locking-in-webkit/
+//! https://github.com/Amanieu/parking_lot
+//! Primitives built on it keep only a few state bits, the queue of sleeping threads lives
+//! in the lot: park sleeps on a per-thread futex word, unpark_one/unpark_all wake threads
+//! parked on an address. The callbacks run under the bucket lock, so a primitive updates
+//! its state atomically with the queue, also when its last parked thread times out.
+//! Eventual fairness: about once per millisecond per bucket unpark_one reports be_fair,
+//! a mutex then hands the lock over to the woken thread instead of letting barging threads take it.
+//! NOTE: in-process only, the queues are in the process memory
+class futex_parking_lot
+{
+	//! Buckets in the table, a power of two
+	enum : std::uint32_t { bucket_count = 1024u };
+
+	//! Upper bound of the fairness interval
+	enum : std::uint32_t { fair_interval_ns = 1000000u };
+
+public:
+	//! Parks the thread on the address if validate() returns true under the bucket lock.
+	//! before_sleep runs after the thread is queued and before it sleeps, e.g. to unlock a mutex.
+	//! timed_out(more_parked) runs under the bucket lock when the deadline dequeues the thread,
+	//! more_parked tells whether other threads are still parked on the address.
+	template< typename Validate, typename BeforeSleep, typename TimedOut >
+	static futex_park_result park(const void* address, Validate validate, BeforeSleep before_sleep, TimedOut timed_out,
+		const futex_deadline* deadline = nullptr)
+	{
+		futex_detail::park_node& node = this_thread_node();
+		futex_detail::park_bucket& bucket = bucket_of(address);
+		{
+			futex_mutex_lock_guard< decltype(bucket.mutex) > lock(bucket.mutex);
+			if (!validate())
+				return { futex_park_status::invalid, 0 };
+			node.address = address;
+			node.next = nullptr;
+			node.token = 0;
+			node.unparked.store(0u, std::memory_order_relaxed);
+			if (bucket.tail)
+				bucket.tail->next = &node;
+			else
+				bucket.head = &node;
+			bucket.tail = &node;
+		}
+		before_sleep();
+
+		while (!node.unparked.load(std::memory_order_acquire))
+		{
+			int res = deadline
+				? futex(&node.unparked, FUTEX_WAIT_BITSET_PRIVATE | deadline->clock_flag, 0, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&node.unparked, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				{
+					futex_mutex_lock_guard< decltype(bucket.mutex) > lock(bucket.mutex);
+					if (dequeue(bucket, &node))
+					{
+						timed_out(is_parked(bucket, address));
+						return { futex_park_status::timed_out, 0 };
+					}
+				}
+				// an unparker has already dequeued the thread and signals it soon
+				while (!node.unparked.load(std::memory_order_acquire))
+					futex(&node.unparked, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+				break;
+			}
+		}
+		return { futex_park_status::unparked, node.token };
+	}
+
+	//! Dequeues the first thread parked on the address. callback(futex_unpark_result) runs
+	//! under the bucket lock even if nobody is parked, its return value is the token of the woken thread.
+	template< typename Callback >
+	static void unpark_one(const void* address, Callback callback)
+	{
+		futex_detail::park_bucket& bucket = bucket_of(address);
+		futex_detail::park_node* node = nullptr;
+		{
+			futex_mutex_lock_guard< decltype(bucket.mutex) > lock(bucket.mutex);
+			futex_detail::park_node* prev = nullptr;
+			for (futex_detail::park_node* it = bucket.head; it; prev = it, it = it->next)
+			{
+				if (it->address == address)
+				{
+					node = it;
+					unlink(bucket, prev, it);
+					break;
+				}
+			}
+
+			bool more_parked = false;
+			for (futex_detail::park_node* it = node ? node->next : nullptr; it && !more_parked; it = it->next)
+				more_parked = it->address == address;
+			const bool be_fair = node && time_to_be_fair(bucket);
+			const std::intptr_t token = callback(futex_unpark_result{ node != nullptr, more_parked, be_fair });
+			if (node)
+				node->token = token;
+		}
+		if (node)
+			wake(*node);
+	}
+
+	//! Dequeues all the threads parked on the address, returns their number
+	static std::uint32_t unpark_all(const void* address)
+	{
+		futex_detail::park_bucket& bucket = bucket_of(address);
+		futex_detail::park_node* woken = nullptr;
+		std::uint32_t count{0u};
+		{
+			futex_mutex_lock_guard< decltype(bucket.mutex) > lock(bucket.mutex);
+			futex_detail::park_node* prev = nullptr;
+			futex_detail::park_node* it = bucket.head;
+			while (it)
+			{
+				futex_detail::park_node* next = it->next;
+				if (it->address == address)
+				{
+					unlink(bucket, prev, it);
+					it->next = woken;
+					woken = it;
+					++count;
+				}
+				else
+					prev = it;
+				it = next;
+			}
+		}
+		// queue order doesn't matter, all of them are woken
+		while (woken)
+		{
+			futex_detail::park_node* next = woken->next;
+			wake(*woken);
+			woken = next;
+		}
+		return count;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static futex_detail::park_node& this_thread_node() noexcept
+	{
+		static thread_local futex_detail::park_node node{ nullptr, nullptr, 0, {0u} };
+		return node;
+	}
+
+	static futex_detail::park_bucket& bucket_of(const void* address) noexcept
+	{
+		static futex_detail::park_bucket buckets[bucket_count];
+		std::uint64_t h = reinterpret_cast< std::uintptr_t >(address);
+		h ^= h >> 32u;
+		h *= 0x9e3779b97f4a7c15ull;
+		return buckets[(h >> 32u) & (bucket_count - 1u)];
+	}
+
+	static void unlink(futex_detail::park_bucket& bucket, futex_detail::park_node* prev, futex_detail::park_node* node) noexcept
+	{
+		if (prev)
+			prev->next = node->next;
+		else
+			bucket.head = node->next;
+		if (bucket.tail == node)
+			bucket.tail = prev;
+	}
+
+	//! Removes the node if it is still queued
+	static bool dequeue(futex_detail::park_bucket& bucket, futex_detail::park_node* node) noexcept
+	{
+		futex_detail::park_node* prev = nullptr;
+		for (futex_detail::park_node* it = bucket.head; it; prev = it, it = it->next)
+		{
+			if (it == node)
+			{
+				unlink(bucket, prev, it);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//! Whether a thread is parked on the address
+	static bool is_parked(const futex_detail::park_bucket& bucket, const void* address) noexcept
+	{
+		for (const futex_detail::park_node* it = bucket.head; it; it = it->next)
+		{
+			if (it->address == address)
+				return true;
+		}
+		return false;
+	}
+
+	//! Whether the fairness interval of the bucket expired, starts a new random one
+	static bool time_to_be_fair(futex_detail::park_bucket& bucket) noexcept
+	{
+		const std::uint64_t now = std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		if (now < bucket.fair_time_ns)
+			return false;
+		bucket.random ^= bucket.random << 13u;
+		bucket.random ^= bucket.random >> 17u;
+		bucket.random ^= bucket.random << 5u;
+		bucket.fair_time_ns = now + bucket.random % fair_interval_ns;
+		return true;
+	}
+
+	//! Signals a dequeued node, the thread may return from park at once
+	static void wake(futex_detail::park_node& node) noexcept
+	{
+		node.unparked.store(1u, std::memory_order_release);
+		futex(&node.unparked, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+};
+
+#endif
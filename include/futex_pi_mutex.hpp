@@ -0,0 +1,136 @@
+#ifndef FUTEX_PI_MUTEX_HPP_
+#define FUTEX_PI_MUTEX_HPP_
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_thread.hpp"
+
+//! Priority-inheritance mutex via FUTEX_LOCK_PI/FUTEX_UNLOCK_PI. Based on:
+//! http://man7.org/linux/man-pages/man2/futex.2.html (Priority-inheritance futexes)
+//! https://www.kernel.org/doc/Documentation/pi-futex.txt
+//!
+//! The futex word holds TID of the owner. Uncontended lock/unlock is a CAS in userspace,
+//! contended ones go to the kernel, which boosts the owner to the priority of the highest waiter,
+//! so a preempted low-priority owner can't block SCHED_FIFO threads for unbounded time.
+//! Waiters are woken in priority order.
+//!
+//! shared policy: whether a mutex can synchronize different processes or not
+//! NOTE: the mutex must be unlocked by the owner thread
+template< shared_policy policy >
+class futex_pi_mutex : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+public:
+	futex_pi_mutex() : m_state(0u)
+	{
+		if (!m_state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	void lock()
+	{
+		if (try_lock_fast())
+			return;
+		lock_slow(nullptr);
+	}
+
+	bool try_lock()
+	{
+		if (try_lock_fast())
+			return true;
+
+		// the word may be 0 with FUTEX_WAITERS bit only in the middle of kernel handoff
+		if (m_state.load(std::memory_order_relaxed) & FUTEX_TID_MASK)
+			return false;
+		if (futex(&m_state, ops::trylock_pi, 0, nullptr, nullptr, 0) == 0)
+			return true;
+		if (errno == EDEADLK)
+			THROW_EXCEPTION(futex_scoped_error, "Mutex already locked by this thread");
+		return false;
+	}
+
+	template< typename Rep, typename Period >
+	bool try_lock_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		return try_lock_until(std::chrono::system_clock::now() + std::chrono::duration_cast< std::chrono::system_clock::duration >(timeout_duration));
+	}
+
+	//! NOTE: FUTEX_LOCK_PI measures timeout only by CLOCK_REALTIME, other clocks are converted to it
+	template< typename Clock, typename Duration >
+	bool try_lock_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		if (try_lock_fast())
+			return true;
+		const auto realtime = std::chrono::system_clock::now() + std::chrono::duration_cast< std::chrono::system_clock::duration >(timeout_time - Clock::now());
+		const futex_deadline deadline = make_futex_deadline(realtime);
+		return lock_slow(&deadline.abs_time);
+	}
+
+	void unlock() noexcept
+	{
+		std::uint32_t tid = static_cast< std::uint32_t >(futex_detail::current_tid());
+		// FUTEX_WAITERS bit is set: the kernel hands the lock over to the top waiter
+		if (!m_state.compare_exchange_strong(tid, 0u, std::memory_order_release, std::memory_order_relaxed))
+			futex(&m_state, ops::unlock_pi, 0, nullptr, nullptr, 0);
+	}
+
+	//! TID of the owner thread, 0 if unlocked
+	pid_t owner() const noexcept
+	{
+		return static_cast< pid_t >(m_state.load(std::memory_order_relaxed) & FUTEX_TID_MASK);
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	bool try_lock_fast() noexcept
+	{
+		std::uint32_t expected{0u};
+		return m_state.compare_exchange_strong(expected, static_cast< std::uint32_t >(futex_detail::current_tid()),
+			std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	//! The kernel enqueues us by priority and boosts the owner. Timeout is absolute CLOCK_REALTIME.
+	bool lock_slow(const struct timespec* abs_timeout)
+	{
+		for (;;)
+		{
+			if (futex(&m_state, ops::lock_pi, 0, abs_timeout, nullptr, 0) == 0)
+				return true;
+
+			switch (errno)
+			{
+			case ETIMEDOUT:
+				return false;
+			// owner is exiting or a race with the fast path, retry
+			case EAGAIN:
+			case EINTR:
+				if (try_lock_fast())
+					return true;
+				break;
+			case EDEADLK:
+				THROW_EXCEPTION(futex_scoped_error, "Mutex already locked by this thread");
+			default:
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+		}
+	}
+
+	//! Owner TID | FUTEX_WAITERS | FUTEX_OWNER_DIED
+	std::atomic< std::uint32_t > m_state;
+};
+
+#endif
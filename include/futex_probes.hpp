@@ -0,0 +1,30 @@
+#ifndef FUTEX_PROBES_HPP_
+#define FUTEX_PROBES_HPP_
+
+//! USDT static tracepoints of the slow paths, provider dummy_futex.
+//! Compiled out unless FUTEX_ENABLE_USDT is defined (CMake option FUTEX_USDT). When compiled in,
+//! a probe is a nop and an ELF note until a tracer attaches, e.g. off-CPU time of contended locks:
+//!     bpftrace -e 'usdt:./app:dummy_futex:mutex_acquire_start { @start[tid] = nsecs; }
+//!         usdt:./app:dummy_futex:mutex_acquire_end /@start[tid]/ { @wait_ns[arg0] = hist(nsecs - @start[tid]); delete(@start[tid]); }'
+//!
+//! Probes and arguments:
+//! mutex_acquire_start(mutex)		contended lock, before the spin and the sleep
+//! mutex_acquire_end(mutex, acquired)	acquired is 0 on timeout
+//! futex_wait(uaddr, val)			before FUTEX_WAIT of a mutex, condition variable or semaphore
+//! futex_wake(uaddr, count)		before FUTEX_WAKE
+//! cond_wait_start(cond, mutex)
+//! cond_wait_end(cond, timeout)		timeout is 1 if the deadline expired
+//! cond_notify(cond, all)
+//! cond_requeue(cond, mutex_word)		notify_all moves the waiters to the mutex futex
+//! sem_block(sem)				wait has to sleep
+//! sem_unblock(sem, acquired)		acquired is 0 on timeout
+#if defined(FUTEX_ENABLE_USDT)
+#	include <sys/sdt.h>
+#	define FUTEX_PROBE1(name, arg1) DTRACE_PROBE1(dummy_futex, name, arg1)
+#	define FUTEX_PROBE2(name, arg1, arg2) DTRACE_PROBE2(dummy_futex, name, arg1, arg2)
+#else
+#	define FUTEX_PROBE1(name, arg1) do {} while (false)
+#	define FUTEX_PROBE2(name, arg1, arg2) do {} while (false)
+#endif
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FUTEX_QUEUE_MUTEX_HPP_
+#define FUTEX_QUEUE_MUTEX_HPP_
+
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+#include <vector>
+
+#include "common.hpp"
+#include "futex_spin_policy.hpp"
+#include "futex_deadline.hpp"
+
+namespace futex_detail
+{
+
+//! Queue node of a waiter, every waiter spins and sleeps on its own cache line
+struct alignas(futex_cache_line_size) queue_node
+{
+	//! Node states
+	enum : std::uint32_t
+	{
+		//! free in the pool of the owner thread
+		idle		= 0u,
+		waiting		= 1u,
+		//! waiting in futex, the handoff must wake
+		sleeping	= 2u,
+		//! the lock is handed over to the node
+		granted		= 3u,
+		//! timed out waiter left the queue, the next unlock skips the node and makes it idle
+		abandoned	= 4u
+	};
+
+	std::atomic< queue_node* > next{nullptr};
+	std::atomic< std::uint32_t > state{idle};
+	//! Taken from the pool, accessed by the owner thread only
+	bool in_use = false;
+};
+
+//! Per-thread node pool: a thread needs one node per queue mutex it holds or waits for
+class queue_node_pool : boost::noncopyable
+{
+public:
+	static queue_node_pool& instance()
+	{
+		static thread_local queue_node_pool pool;
+		return pool;
+	}
+
+	queue_node* acquire()
+	{
+		for (queue_node* node : m_nodes)
+		{
+			if (!node->in_use && node->state.load(std::memory_order_acquire) == queue_node::idle)
+			{
+				node->in_use = true;
+				return node;
+			}
+		}
+		m_nodes.push_back(new queue_node);
+		m_nodes.back()->in_use = true;
+		return m_nodes.back();
+	}
+
+	//! The state is set to idle (or abandoned) by the caller
+	void release(queue_node* node) noexcept
+	{
+		node->in_use = false;
+	}
+
+	~queue_node_pool()
+	{
+		// abandoned nodes may be still linked in a queue, they are leaked
+		for (queue_node* node : m_nodes)
+		{
+			if (node->state.load(std::memory_order_acquire) != queue_node::abandoned)
+				delete node;
+		}
+	}
+
+private:
+	queue_node_pool() = default;
+
+	std::vector< queue_node* > m_nodes;
+};
+
+} // namespace futex_detail
+
+
+//! Queue lock: MCS list of waiters with FIFO handoff. Based on:
+//! https://www.cs.rochester.edu/u/scott/papers/1991_TOCS_synch.pdf (MCS lock)
+//! https://www.cs.rochester.edu/u/scott/papers/2001_PPoPP_Timeout.pdf (abandoning the queue on timeout)
+//! https://lwn.net/Articles/590243/ (MCS locks in the kernel)
+//!
+//! The mutex word is the tail of the queue, a thread touches it once per lock and once per unlock.
+//! A waiter spins on its own node and then sleeps in futex on it, unlock hands the lock over
+//! to the next node directly, so there is no thundering herd and no stealing by newcomers.
+//! The price is the convoy: a sleeping successor must be woken before anybody can proceed.
+//! Nodes come from a per-thread pool, the owner node is kept in the mutex.
+//! Meets the TimedLockable requirements like futex_mutex, a timed out waiter marks its node
+//! abandoned and the unlock skips it.
+//!
+//! shared policy: only inprocess, the queue is made of pointers
+//! backoff: pause strategy while spinning on the node, see futex_spin_policy.hpp
+//! NOTE: the mutex must be unlocked by the owner thread
+template< shared_policy policy, typename backoff = default_backoff >
+class futex_queue_mutex : boost::noncopyable
+{
+	static_assert(policy == shared_policy::inprocess, "Queue nodes are process local, interprocess is not supported");
+
+	using node_t = futex_detail::queue_node;
+
+	//! Spin attempts on the own node before sleeping
+	enum : std::uint32_t { spin_count = 100u };
+
+public:
+	futex_queue_mutex() : m_tail(nullptr), m_owner(nullptr)
+	{
+		if (!m_tail.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_tail must be lock-free");
+	}
+
+	void lock()
+	{
+		lock_impl(nullptr);
+	}
+
+	bool try_lock()
+	{
+		auto& pool = futex_detail::queue_node_pool::instance();
+		node_t* node = pool.acquire();
+		node->next.store(nullptr, std::memory_order_relaxed);
+		node->state.store(node_t::waiting, std::memory_order_relaxed);
+
+		node_t* expected{nullptr};
+		if (m_tail.compare_exchange_strong(expected, node, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			m_owner = node;
+			return true;
+		}
+		node->state.store(node_t::idle, std::memory_order_relaxed);
+		pool.release(node);
+		return false;
+	}
+
+	template< typename Rep, typename Period >
+	bool try_lock_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		return try_lock_until(make_futex_deadline(timeout_duration));
+	}
+
+	//! Deadline clocks, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	bool try_lock_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		return try_lock_until(make_futex_deadline(timeout_time));
+	}
+
+	bool try_lock_until(const futex_deadline& deadline)
+	{
+		return lock_impl(&deadline);
+	}
+
+	void unlock() noexcept
+	{
+		node_t* node = m_owner;
+		node_t* next = node->next.load(std::memory_order_acquire);
+		if (!next)
+		{
+			// no waiters: the queue becomes empty
+			node_t* expected = node;
+			if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+			{
+				release_node(node);
+				return;
+			}
+			next = wait_next(node);
+		}
+		release_node(node);
+
+		for (;;)
+		{
+			std::uint32_t state = next->state.load(std::memory_order_relaxed);
+			while (state != node_t::abandoned)
+			{
+				if (next->state.compare_exchange_weak(state, node_t::granted, std::memory_order_release, std::memory_order_relaxed))
+				{
+					if (state == node_t::sleeping)
+						futex(&next->state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+					return;
+				}
+			}
+
+			// skip the timed out waiter, its node goes back to its pool when we are done with it
+			node_t* abandoned = next;
+			next = abandoned->next.load(std::memory_order_acquire);
+			if (!next)
+			{
+				node_t* expected = abandoned;
+				if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+				{
+					abandoned->state.store(node_t::idle, std::memory_order_release);
+					return;
+				}
+				next = wait_next(abandoned);
+			}
+			abandoned->state.store(node_t::idle, std::memory_order_release);
+		}
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static void release_node(node_t* node) noexcept
+	{
+		node->state.store(node_t::idle, std::memory_order_relaxed);
+		futex_detail::queue_node_pool::instance().release(node);
+	}
+
+	//! A new waiter has swapped the tail but hasn't linked itself yet
+	static node_t* wait_next(node_t* node) noexcept
+	{
+		node_t* next;
+		std::uint32_t spins{0u};
+		while (!(next = node->next.load(std::memory_order_acquire)))
+		{
+			// the waiter may be preempted between the two steps
+			if (++spins < spin_count)
+				cpu_relax();
+			else
+				::sched_yield();
+		}
+		return next;
+	}
+
+	//! Enqueues and waits for the handoff. Returns false if the deadline expired.
+	bool lock_impl(const futex_deadline* deadline)
+	{
+		auto& pool = futex_detail::queue_node_pool::instance();
+		node_t* node = pool.acquire();
+		node->next.store(nullptr, std::memory_order_relaxed);
+		node->state.store(node_t::waiting, std::memory_order_relaxed);
+
+		node_t* prev = m_tail.exchange(node, std::memory_order_acq_rel);
+		if (prev)
+		{
+			prev->next.store(node, std::memory_order_release);
+			if (!wait_granted(node, deadline))
+			{
+				pool.release(node);
+				return false;
+			}
+		}
+		m_owner = node;
+		return true;
+	}
+
+	bool wait_granted(node_t* node, const futex_deadline* deadline)
+	{
+		if (backoff::enabled())
+		{
+			backoff spin_backoff;
+			for (std::uint32_t spin = 0; spin < spin_count; ++spin)
+			{
+				if (node->state.load(std::memory_order_acquire) == node_t::granted)
+					return true;
+				spin_backoff.pause();
+			}
+		}
+
+		std::uint32_t state = node_t::waiting;
+		if (!node->state.compare_exchange_strong(state, node_t::sleeping, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
+
+		for (;;)
+		{
+			int res = deadline
+				? futex(&node->state, FUTEX_WAIT_BITSET_PRIVATE | deadline->clock_flag, node_t::sleeping, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&node->state, FUTEX_WAIT_PRIVATE, node_t::sleeping, nullptr, nullptr, 0);
+			if (node->state.load(std::memory_order_acquire) == node_t::granted)
+				return true;
+
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				// the handoff may come together with the timeout
+				state = node_t::sleeping;
+				return !node->state.compare_exchange_strong(state, node_t::abandoned, std::memory_order_acquire, std::memory_order_relaxed);
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		}
+	}
+
+	//! Tail of the waiters queue, nullptr if unlocked
+	std::atomic< node_t* > m_tail;
+	//! Node of the owner, accessed by the owner only
+	node_t* m_owner;
+};
+
+#endif
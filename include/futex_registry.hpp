@@ -0,0 +1,522 @@
+#ifndef FUTEX_REGISTRY_HPP_
+#define FUTEX_REGISTRY_HPP_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "common.hpp"
+#include "futex_stats.hpp"
+#include "futex_mutex.hpp"
+#include "futex_condition_variable.hpp"
+#include "futex_counting_semaphore.hpp"
+
+//! Kind of a registered primitive
+enum class futex_registry_kind : std::uint32_t
+{
+	other				= 0u,
+	mutex				= 1u,
+	condition_variable	= 2u,
+	semaphore			= 3u
+};
+
+template< typename Primitive >
+struct futex_registry_kind_of { static constexpr futex_registry_kind value = futex_registry_kind::other; };
+
+template< shared_policy policy, bool use_spinlock, typename backoff, futex_layout layout, typename stats >
+struct futex_registry_kind_of< futex_mutex< policy, use_spinlock, backoff, layout, stats > >
+{ static constexpr futex_registry_kind value = futex_registry_kind::mutex; };
+
+template< shared_policy policy, typename stats >
+struct futex_registry_kind_of< futex_condition_variable< policy, stats > >
+{ static constexpr futex_registry_kind value = futex_registry_kind::condition_variable; };
+
+template< shared_policy policy, typename stats >
+struct futex_registry_kind_of< futex_counting_semaphore< policy, stats > >
+{ static constexpr futex_registry_kind value = futex_registry_kind::semaphore; };
+
+
+namespace futex_detail
+{
+
+constexpr std::uint32_t registry_magic = 0x47524658u;
+constexpr std::uint32_t registry_version = 2u;
+constexpr std::size_t registry_name_size = 48u;
+
+//! Published counters of one primitive in the segment
+struct registry_slot
+{
+	//! Slot states
+	enum : std::uint32_t
+	{
+		free		= 0u,
+		active		= 2u,
+		//! flag of a slot being filled, the rest is the pid of the registering process
+		claimed		= 0x80000000u
+	};
+
+	std::atomic< std::uint32_t > state;
+	std::atomic< std::int32_t > pid;
+	std::uint32_t kind;
+	char name[registry_name_size];
+	std::atomic< std::uint64_t > acquisitions;
+	std::atomic< std::uint64_t > contended;
+	std::atomic< std::uint64_t > spin_successes;
+	std::atomic< std::uint64_t > futex_waits;
+	std::atomic< std::uint64_t > futex_wakes;
+	std::atomic< std::uint64_t > spurious_wakeups;
+	std::array< std::atomic< std::uint64_t >, futex_stats_buckets > wait_ns;
+	std::array< std::atomic< std::uint64_t >, futex_stats_buckets > hold_ns;
+
+	void store(const futex_stats_snapshot& snapshot) noexcept
+	{
+		acquisitions.store(snapshot.acquisitions, std::memory_order_relaxed);
+		contended.store(snapshot.contended, std::memory_order_relaxed);
+		spin_successes.store(snapshot.spin_successes, std::memory_order_relaxed);
+		futex_waits.store(snapshot.futex_waits, std::memory_order_relaxed);
+		futex_wakes.store(snapshot.futex_wakes, std::memory_order_relaxed);
+		spurious_wakeups.store(snapshot.spurious_wakeups, std::memory_order_relaxed);
+		for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+		{
+			wait_ns[index].store(snapshot.wait_ns[index], std::memory_order_relaxed);
+			hold_ns[index].store(snapshot.hold_ns[index], std::memory_order_relaxed);
+		}
+	}
+
+	futex_stats_snapshot load() const noexcept
+	{
+		futex_stats_snapshot res;
+		res.acquisitions = acquisitions.load(std::memory_order_relaxed);
+		res.contended = contended.load(std::memory_order_relaxed);
+		res.spin_successes = spin_successes.load(std::memory_order_relaxed);
+		res.futex_waits = futex_waits.load(std::memory_order_relaxed);
+		res.futex_wakes = futex_wakes.load(std::memory_order_relaxed);
+		res.spurious_wakeups = spurious_wakeups.load(std::memory_order_relaxed);
+		for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+		{
+			res.wait_ns[index] = wait_ns[index].load(std::memory_order_relaxed);
+			res.hold_ns[index] = hold_ns[index].load(std::memory_order_relaxed);
+		}
+		return res;
+	}
+};
+
+//! Segment header, the slots follow it
+struct registry_header
+{
+	//! Set last by the creator, the segment is ready when it is valid
+	std::atomic< std::uint32_t > magic;
+	std::uint32_t version;
+	std::uint32_t capacity;
+	std::uint32_t slot_size;
+	//! Incremented by every publish
+	std::atomic< std::uint64_t > generation;
+};
+
+inline std::size_t registry_size(std::uint32_t capacity) noexcept
+{
+	return sizeof(registry_header) + capacity * sizeof(registry_slot);
+}
+
+inline bool process_alive(std::int32_t pid) noexcept
+{
+	return ::kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+//! Mapping of a registry segment, creates the segment or waits until its creator initializes it
+class registry_mapping : boost::noncopyable
+{
+	//! Time for the creator to initialize the segment
+	enum : std::uint32_t { init_timeout_ms = 1000u };
+
+public:
+	registry_mapping(const char* segment, std::uint32_t capacity, bool read_only)
+	{
+		if (!read_only)
+		{
+			int fd = ::shm_open(segment, O_RDWR | O_CREAT | O_EXCL, 0660);
+			if (fd >= 0)
+			{
+				create(fd, capacity);
+				return;
+			}
+			else if (errno != EEXIST)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		}
+
+		int fd = ::shm_open(segment, read_only ? O_RDONLY : O_RDWR, 0);
+		if (fd < 0)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		attach(fd, read_only);
+	}
+
+	~registry_mapping()
+	{
+		::munmap(m_addr, m_size);
+	}
+
+	registry_header& header() const noexcept
+	{
+		return *static_cast< registry_header* >(m_addr);
+	}
+
+	registry_slot& slot(std::uint32_t index) const noexcept
+	{
+		return reinterpret_cast< registry_slot* >(static_cast< char* >(m_addr) + sizeof(registry_header))[index];
+	}
+
+	std::uint32_t capacity() const noexcept
+	{
+		return header().capacity;
+	}
+
+private:
+	void create(int fd, std::uint32_t capacity)
+	{
+		m_size = registry_size(capacity);
+		// the new segment is zero-filled: all the slots are free
+		if (::ftruncate(fd, static_cast< off_t >(m_size)) != 0)
+			close_and_throw(fd);
+		map(fd, PROT_READ | PROT_WRITE);
+		::close(fd);
+
+		registry_header& head = header();
+		head.version = registry_version;
+		head.capacity = capacity;
+		head.slot_size = sizeof(registry_slot);
+		head.magic.store(registry_magic, std::memory_order_release);
+	}
+
+	void attach(int fd, bool read_only)
+	{
+		const int prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(init_timeout_ms);
+		for (;;)
+		{
+			// the header is mapped once the creator has sized the segment
+			struct stat st;
+			if (::fstat(fd, &st) != 0)
+				close_and_throw(fd);
+			if (static_cast< std::size_t >(st.st_size) >= registry_size(0u))
+			{
+				m_size = static_cast< std::size_t >(st.st_size);
+				map(fd, prot);
+				if (header().magic.load(std::memory_order_acquire) == registry_magic)
+					break;
+				::munmap(m_addr, m_size);
+			}
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				::close(fd);
+				THROW_EXCEPTION(futex_base_exception, "Registry segment is not initialized");
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		::close(fd);
+
+		const registry_header& head = header();
+		if (head.version != registry_version || head.slot_size != sizeof(registry_slot) || registry_size(head.capacity) > m_size)
+		{
+			::munmap(m_addr, m_size);
+			THROW_EXCEPTION(futex_base_exception, "Registry segment has incompatible layout");
+		}
+	}
+
+	void map(int fd, int prot)
+	{
+		m_addr = ::mmap(nullptr, m_size, prot, MAP_SHARED, fd, 0);
+		if (m_addr == MAP_FAILED)
+			close_and_throw(fd);
+	}
+
+	[[noreturn]] static void close_and_throw(int fd)
+	{
+		const int error = errno;
+		::close(fd);
+		THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+	}
+
+	void* m_addr = nullptr;
+	std::size_t m_size = 0u;
+};
+
+} // namespace futex_detail
+
+
+class futex_registry;
+
+//! Registration of a primitive, unregisters on destruction.
+//! NOTE: must be destroyed before the registered primitive and before the registry
+class futex_registration
+{
+public:
+	futex_registration() noexcept = default;
+
+	futex_registration(futex_registration&& other) noexcept
+	: m_registry(other.m_registry), m_slot(other.m_slot)
+	{
+		other.m_registry = nullptr;
+	}
+
+	futex_registration& operator=(futex_registration&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_registry = other.m_registry;
+			m_slot = other.m_slot;
+			other.m_registry = nullptr;
+		}
+		return *this;
+	}
+
+	~futex_registration()
+	{
+		reset();
+	}
+
+	//! Unregisters, the slot is freed
+	void reset() noexcept;
+
+	explicit operator bool() const noexcept
+	{
+		return m_registry != nullptr;
+	}
+
+	//! Index of the slot in the segment
+	std::uint32_t slot() const noexcept
+	{
+		return m_slot;
+	}
+
+private:
+	friend class futex_registry;
+
+	futex_registration(futex_registry* registry, std::uint32_t slot) noexcept : m_registry(registry), m_slot(slot) {}
+
+	futex_registry* m_registry = nullptr;
+	std::uint32_t m_slot = 0u;
+};
+
+
+//! Opt-in registry of named primitives. The statistics of the registered primitives
+//! (see futex_stats.hpp) are published into a POSIX shared memory segment, several processes
+//! may share one segment. tools/lock_top reads the segment and shows the hottest locks.
+//!
+//! Publishing copies the snapshots in publish() or in a background thread, see start_publisher:
+//! the lock paths only update the statistics of their primitive, the registry adds nothing to them.
+//! Slots of dead processes are reused.
+//! Usage:
+//!     futex_registry registry;
+//!     futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats > mutex;
+//!     auto registration = registry.add("orders", mutex);
+//!     registry.start_publisher(std::chrono::milliseconds(500));
+class futex_registry : boost::noncopyable
+{
+	using slot_t = futex_detail::registry_slot;
+	using mutex_t = futex_mutex< shared_policy::inprocess >;
+
+public:
+	static constexpr const char* default_segment = "/futex_registry";
+	static constexpr std::uint32_t default_capacity = 1024u;
+
+	//! Opens the segment, creates it with capacity slots if it doesn't exist
+	explicit futex_registry(const char* segment = default_segment, std::uint32_t capacity = default_capacity)
+	: m_mapping(segment, capacity, false), m_stop(false)
+	{
+	}
+
+	~futex_registry()
+	{
+		stop_publisher();
+		futex_mutex_lock_guard< mutex_t > lock(m_mutex);
+		for (const entry& item : m_entries)
+			m_mapping.slot(item.slot).state.store(slot_t::free, std::memory_order_release);
+	}
+
+	//! Registers a primitive with enabled statistics under a name, the name is truncated to 47 chars
+	template< typename Primitive >
+	futex_registration add(const char* name, const Primitive& primitive, futex_registry_kind kind = futex_registry_kind_of< Primitive >::value)
+	{
+		using stats_t = std::decay_t< decltype(primitive.statistics()) >;
+		static_assert(stats_t::enabled, "Only primitives with statistics can be registered, see futex_stats.hpp");
+
+		const std::uint32_t index = claim_slot(name, kind);
+		futex_mutex_lock_guard< mutex_t > lock(m_mutex);
+		m_entries.push_back({ index, [&primitive]() { return primitive.statistics().snapshot(); } });
+		return futex_registration(this, index);
+	}
+
+	//! Copies the statistics of all registered primitives into the segment
+	void publish()
+	{
+		futex_mutex_lock_guard< mutex_t > lock(m_mutex);
+		for (const entry& item : m_entries)
+			m_mapping.slot(item.slot).store(item.snapshot());
+		m_mapping.header().generation.fetch_add(1u, std::memory_order_release);
+	}
+
+	//! Publishes periodically in a background thread
+	void start_publisher(std::chrono::milliseconds period)
+	{
+		stop_publisher();
+		m_stop = false;
+		m_publisher = std::thread([this, period]() {
+			futex_mutex_unique_lock< mutex_t > lock(m_stop_mutex);
+			while (!m_stop_cond.wait_for(lock, period, [this]() { return m_stop; }))
+			{
+				lock.unlock();
+				publish();
+				lock.lock();
+			}
+		});
+	}
+
+	void stop_publisher()
+	{
+		if (!m_publisher.joinable())
+			return;
+		{
+			futex_mutex_lock_guard< mutex_t > lock(m_stop_mutex);
+			m_stop = true;
+		}
+		m_stop_cond.notify_all();
+		m_publisher.join();
+	}
+
+	//! Removes the segment name, the mapped segments stay valid
+	static void remove(const char* segment = default_segment) noexcept
+	{
+		::shm_unlink(segment);
+	}
+
+private:
+	friend class futex_registration;
+
+	struct entry
+	{
+		std::uint32_t slot;
+		std::function< futex_stats_snapshot() > snapshot;
+	};
+
+	//! Takes a free slot or a slot of a dead process
+	std::uint32_t claim_slot(const char* name, futex_registry_kind kind)
+	{
+		for (std::uint32_t index = 0; index < m_mapping.capacity(); ++index)
+		{
+			slot_t& slot = m_mapping.slot(index);
+			std::uint32_t state = slot.state.load(std::memory_order_acquire);
+			// the claim CAS stores the pid, so a process dying before activation doesn't leak the slot
+			if ((state & slot_t::claimed) && futex_detail::process_alive(static_cast< std::int32_t >(state & ~slot_t::claimed)))
+				continue;
+			if (state == slot_t::active && futex_detail::process_alive(slot.pid.load(std::memory_order_relaxed)))
+				continue;
+			if (!slot.state.compare_exchange_strong(state, slot_t::claimed | static_cast< std::uint32_t >(::getpid()), std::memory_order_acquire, std::memory_order_relaxed))
+				continue;
+
+			slot.pid.store(static_cast< std::int32_t >(::getpid()), std::memory_order_relaxed);
+			slot.kind = static_cast< std::uint32_t >(kind);
+			std::strncpy(slot.name, name, sizeof(slot.name) - 1u);
+			slot.name[sizeof(slot.name) - 1u] = '\0';
+			slot.store(futex_stats_snapshot{});
+			slot.state.store(slot_t::active, std::memory_order_release);
+			return index;
+		}
+		THROW_EXCEPTION(futex_base_exception, "Registry segment is full");
+	}
+
+	void remove_entry(std::uint32_t index) noexcept
+	{
+		futex_mutex_lock_guard< mutex_t > lock(m_mutex);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			if (it->slot == index)
+			{
+				m_entries.erase(it);
+				break;
+			}
+		}
+		m_mapping.slot(index).state.store(slot_t::free, std::memory_order_release);
+	}
+
+	futex_detail::registry_mapping m_mapping;
+	//! Guards the entries
+	mutex_t m_mutex;
+	std::vector< entry > m_entries;
+	//! Publisher thread stop
+	mutex_t m_stop_mutex;
+	futex_condition_variable< shared_policy::inprocess > m_stop_cond;
+	bool m_stop;
+	std::thread m_publisher;
+};
+
+inline void futex_registration::reset() noexcept
+{
+	if (m_registry)
+	{
+		m_registry->remove_entry(m_slot);
+		m_registry = nullptr;
+	}
+}
+
+
+//! Published statistics of one primitive
+struct futex_registry_record
+{
+	std::uint32_t slot;
+	std::int32_t pid;
+	futex_registry_kind kind;
+	std::string name;
+	futex_stats_snapshot stats;
+};
+
+//! Read-only view of a registry segment for inspection tools
+class futex_registry_view : boost::noncopyable
+{
+	using slot_t = futex_detail::registry_slot;
+
+public:
+	explicit futex_registry_view(const char* segment = futex_registry::default_segment)
+	: m_mapping(segment, 0u, true)
+	{
+	}
+
+	//! Count of publishes, unchanged if nothing was published since the last read
+	std::uint64_t generation() const noexcept
+	{
+		return m_mapping.header().generation.load(std::memory_order_acquire);
+	}
+
+	//! Records of the live processes
+	std::vector< futex_registry_record > read() const
+	{
+		std::vector< futex_registry_record > records;
+		for (std::uint32_t index = 0; index < m_mapping.capacity(); ++index)
+		{
+			const slot_t& slot = m_mapping.slot(index);
+			if (slot.state.load(std::memory_order_acquire) != slot_t::active)
+				continue;
+			const std::int32_t pid = slot.pid.load(std::memory_order_relaxed);
+			if (!futex_detail::process_alive(pid))
+				continue;
+			records.push_back({ index, pid, static_cast< futex_registry_kind >(slot.kind),
+				std::string(slot.name, ::strnlen(slot.name, sizeof(slot.name))), slot.load() });
+		}
+		return records;
+	}
+
+private:
+	futex_detail::registry_mapping m_mapping;
+};
+
+#endif
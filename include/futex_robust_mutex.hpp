@@ -0,0 +1,368 @@
+#ifndef FUTEX_ROBUST_MUTEX_HPP_
+#define FUTEX_ROBUST_MUTEX_HPP_
+
+#include <errno.h>
+#include <climits>
+#include <cstddef>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <chrono>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_thread.hpp"
+
+//! Lock result of futex_robust_mutex
+enum class futex_robust_status
+{
+	//! locked
+	acquired,
+	//! locked, but the previous owner died holding the mutex: the protected state may be inconsistent
+	owner_dead,
+	//! not locked: try_lock failed or timeout expired
+	busy,
+	//! not locked: the mutex was unlocked without consistent() after owner death
+	not_recoverable
+};
+
+
+namespace futex_detail
+{
+
+//! Node of the kernel robust list, the same as glibc __pthread_list_t on LP64:
+//! links point to `next` fields, `prev` is right before it.
+//! https://www.kernel.org/doc/Documentation/robust-futex-ABI.txt
+struct robust_node
+{
+	void* prev;
+	void* next;
+};
+
+//! Part of the robust mutex seen by the kernel. glibc registers its robust list head for every thread
+//! (and a thread has only one), so our nodes join that list and must sit where glibc keeps __list
+//! in pthread_mutex_t: futex word 32 bytes before `next`.
+struct robust_layout
+{
+	std::atomic< std::uint32_t > state;
+	//! The owner took the mutex with owner_dead and hasn't called consistent() yet
+	std::uint32_t inconsistent;
+	std::uint32_t reserved[4];
+	robust_node node;
+};
+
+constexpr long robust_futex_offset = -32;
+
+static_assert(sizeof(void*) == 8, "robust list layout is defined for LP64");
+static_assert(offsetof(robust_layout, node) + offsetof(robust_node, next) == -robust_futex_offset,
+	"futex word must be at futex_offset from the list entry");
+
+//! Head for threads without one from libc, the slot before it takes `prev` writes while the list is empty
+struct robust_list_storage
+{
+	void* prev;
+	struct robust_list_head head;
+};
+
+inline struct robust_list_head*& cached_robust_head() noexcept
+{
+	static thread_local struct robust_list_head* head = nullptr;
+	return head;
+}
+
+//! The kernel drops the registration in a forked child, libc registers its head again
+inline void reset_cached_robust_head() noexcept
+{
+	cached_robust_head() = nullptr;
+}
+
+//! Robust list head of the calling thread: the libc one or our own registered via set_robust_list
+inline struct robust_list_head* robust_head()
+{
+	struct robust_list_head*& head = cached_robust_head();
+	if (BOOST_LIKELY(head != nullptr))
+		return head;
+
+	static const int registered = ::pthread_atfork(nullptr, nullptr, &reset_cached_robust_head);
+	(void)registered;
+
+	struct robust_list_head* current = nullptr;
+	std::size_t len = 0;
+	if (::syscall(SYS_get_robust_list, 0, &current, &len) != 0)
+		THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+	if (!current)
+	{
+		static thread_local robust_list_storage own;
+		own.prev = &own.head.list;
+		own.head.list.next = &own.head.list;
+		own.head.futex_offset = robust_futex_offset;
+		own.head.list_op_pending = nullptr;
+		if (::syscall(SYS_set_robust_list, &own.head, sizeof(own.head)) != 0)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		current = &own.head;
+	}
+	else if (current->futex_offset != robust_futex_offset)
+		THROW_EXCEPTION(futex_base_exception, "Incompatible robust list of libc");
+	head = current;
+	return head;
+}
+
+inline void* robust_unmark(void* entry) noexcept
+{
+	// glibc marks PI mutexes with the lowest bit
+	return reinterpret_cast< void* >(reinterpret_cast< std::uintptr_t >(entry) & ~std::uintptr_t(1u));
+}
+
+//! `prev` field of the node whose `next` is at entry
+inline void*& robust_prev_of(void* entry) noexcept
+{
+	return static_cast< void** >(robust_unmark(entry))[-1];
+}
+
+//! Links the node first, like glibc ENQUEUE_MUTEX
+inline void robust_enqueue(struct robust_list_head* head, robust_node& node) noexcept
+{
+	robust_prev_of(head->list.next) = &node.next;
+	node.next = head->list.next;
+	node.prev = &head->list;
+	// the kernel may walk the list at any moment the thread dies
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	head->list.next = reinterpret_cast< struct robust_list* >(&node.next);
+}
+
+//! Unlinks the node, like glibc DEQUEUE_MUTEX
+inline void robust_dequeue(robust_node& node) noexcept
+{
+	robust_prev_of(node.next) = node.prev;
+	*static_cast< void** >(robust_unmark(node.prev)) = node.next;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	node.prev = nullptr;
+	node.next = nullptr;
+}
+
+} // namespace futex_detail
+
+
+//! Robust mutex: if the owner thread or process dies holding the mutex, the kernel marks the futex word
+//! with FUTEX_OWNER_DIED and wakes a waiter, the next locker gets owner_dead instead of blocking forever.
+//! Based on:
+//! https://www.kernel.org/doc/Documentation/robust-futexes.txt
+//! https://github.com/bminor/glibc/blob/master/nptl/pthread_mutex_lock.c (PTHREAD_MUTEX_ROBUST_NORMAL_NP)
+//!
+//! The futex word holds TID of the owner, held mutexes are linked into the robust list of the owner thread.
+//! Protocol is the one of pthread_mutex_consistent: the owner_dead locker repairs the protected state and
+//! calls consistent(), unlock without it makes the mutex not recoverable for everybody.
+//! lock()/try_lock() report both cases with futex_owner_dead/futex_not_recoverable exceptions,
+//! lock_robust()/try_lock_robust() return futex_robust_status instead.
+//!
+//! shared policy: whether a mutex can synchronize different processes or not.
+//! NOTE: the kernel wakes a waiter of a dead owner with a shared futex op, so shared ops are used for both policies
+//! NOTE: the mutex must be unlocked by the owner thread
+template< shared_policy policy >
+class futex_robust_mutex : boost::noncopyable
+{
+	//! Never a TID: PID_MAX_LIMIT is 2^22
+	enum : std::uint32_t { not_recoverable_state = FUTEX_TID_MASK };
+
+public:
+	futex_robust_mutex() : m_data{}
+	{
+		if (!m_data.state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	void lock()
+	{
+		check_status(lock_robust());
+	}
+
+	bool try_lock()
+	{
+		return check_status(try_lock_robust());
+	}
+
+	template< typename Rep, typename Period >
+	bool try_lock_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		return check_status(try_lock_robust_for(timeout_duration));
+	}
+
+	template< typename Clock, typename Duration >
+	bool try_lock_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		return check_status(try_lock_robust_until(timeout_time));
+	}
+
+	futex_robust_status lock_robust()
+	{
+		return lock_impl(true, nullptr);
+	}
+
+	futex_robust_status try_lock_robust()
+	{
+		return lock_impl(false, nullptr);
+	}
+
+	template< typename Rep, typename Period >
+	futex_robust_status try_lock_robust_for(const std::chrono::duration< Rep, Period >& timeout_duration)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_duration);
+		return lock_impl(true, &deadline);
+	}
+
+	//! Waits until absolute deadline, see futex_deadline.hpp
+	template< typename Clock, typename Duration >
+	futex_robust_status try_lock_robust_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
+	{
+		const futex_deadline deadline = make_futex_deadline(timeout_time);
+		return lock_impl(true, &deadline);
+	}
+
+	//! Marks the state protected by the mutex as repaired after owner_dead
+	void consistent()
+	{
+		if (owner() != futex_detail::current_tid() || !m_data.inconsistent)
+			THROW_EXCEPTION(futex_scoped_error, "Mutex is not locked with owner_dead by this thread");
+		m_data.inconsistent = 0u;
+	}
+
+	void unlock()
+	{
+		if (owner() != futex_detail::current_tid())
+			THROW_EXCEPTION(futex_scoped_error, "Mutex is not locked by this thread");
+
+		struct robust_list_head* head = futex_detail::robust_head();
+		head->list_op_pending = reinterpret_cast< struct robust_list* >(&m_data.node.next);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		futex_detail::robust_dequeue(m_data.node);
+
+		const bool recoverable = !m_data.inconsistent;
+		const std::uint32_t state = m_data.state.exchange(recoverable ? 0u : not_recoverable_state, std::memory_order_release);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		head->list_op_pending = nullptr;
+
+		// avoid extra futex syscall, not recoverable mutex fails all the waiters
+		if (state & FUTEX_WAITERS)
+			futex(&m_data.state, FUTEX_WAKE, recoverable ? 1 : INT_MAX, nullptr, nullptr, 0);
+	}
+
+	//! TID of the owner thread, 0 if unlocked
+	pid_t owner() const noexcept
+	{
+		const std::uint32_t state = m_data.state.load(std::memory_order_relaxed);
+		return state == not_recoverable_state ? 0 : static_cast< pid_t >(state & FUTEX_TID_MASK);
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static bool check_status(futex_robust_status status)
+	{
+		switch (status)
+		{
+		case futex_robust_status::acquired:
+			return true;
+		case futex_robust_status::busy:
+			return false;
+		case futex_robust_status::owner_dead:
+			THROW_EXCEPTION(futex_owner_dead, "Previous owner of the mutex died, the mutex is locked");
+		default:
+			THROW_EXCEPTION(futex_not_recoverable, "Mutex is not recoverable");
+		}
+	}
+
+	//! Links the mutex into the robust list of the owner thread
+	futex_robust_status acquired(struct robust_list_head* head, futex_robust_status status) noexcept
+	{
+		futex_detail::robust_enqueue(head, m_data.node);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		head->list_op_pending = nullptr;
+		return status;
+	}
+
+	//! The word is owner TID | FUTEX_WAITERS | FUTEX_OWNER_DIED. The node is announced in list_op_pending
+	//! before the word changes: the kernel cleans the word up if we die between the CAS and enqueue.
+	futex_robust_status lock_impl(bool block, const futex_deadline* deadline)
+	{
+		struct robust_list_head* head = futex_detail::robust_head();
+		const std::uint32_t tid = static_cast< std::uint32_t >(futex_detail::current_tid());
+		head->list_op_pending = reinterpret_cast< struct robust_list* >(&m_data.node.next);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+
+		std::uint32_t state{0u};
+		if (m_data.state.compare_exchange_strong(state, tid, std::memory_order_acquire, std::memory_order_relaxed))
+			return acquired(head, futex_robust_status::acquired);
+
+		// after a sleep other waiters may sleep too, keep FUTEX_WAITERS when locking
+		std::uint32_t waiters_bit{0u};
+		for (;;)
+		{
+			if (state == not_recoverable_state)
+			{
+				head->list_op_pending = nullptr;
+				return futex_robust_status::not_recoverable;
+			}
+
+			if (state & FUTEX_OWNER_DIED)
+			{
+				if (m_data.state.compare_exchange_weak(state, tid | (state & FUTEX_WAITERS), std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					m_data.inconsistent = 1u;
+					return acquired(head, futex_robust_status::owner_dead);
+				}
+				continue;
+			}
+
+			const std::uint32_t owner_tid = state & FUTEX_TID_MASK;
+			if (!owner_tid)
+			{
+				if (m_data.state.compare_exchange_weak(state, tid | waiters_bit | state, std::memory_order_acquire, std::memory_order_relaxed))
+					return acquired(head, futex_robust_status::acquired);
+				continue;
+			}
+			if (owner_tid == tid)
+			{
+				head->list_op_pending = nullptr;
+				THROW_EXCEPTION(futex_scoped_error, "Mutex already locked by this thread");
+			}
+			if (!block)
+			{
+				head->list_op_pending = nullptr;
+				return futex_robust_status::busy;
+			}
+
+			if (!(state & FUTEX_WAITERS))
+			{
+				if (!m_data.state.compare_exchange_weak(state, state | FUTEX_WAITERS, std::memory_order_relaxed))
+					continue;
+				state |= FUTEX_WAITERS;
+			}
+
+			int res = deadline
+				? futex(&m_data.state, FUTEX_WAIT_BITSET | deadline->clock_flag, state, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&m_data.state, FUTEX_WAIT, state, nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				head->list_op_pending = nullptr;
+				return futex_robust_status::busy;
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				head->list_op_pending = nullptr;
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+			waiters_bit = FUTEX_WAITERS;
+			state = m_data.state.load(std::memory_order_relaxed);
+		}
+	}
+
+	//! Futex word, consistency flag and robust list node
+	futex_detail::robust_layout m_data;
+};
+
+#endif
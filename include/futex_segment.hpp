@@ -0,0 +1,677 @@
+#ifndef FUTEX_SEGMENT_HPP_
+#define FUTEX_SEGMENT_HPP_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <linux/futex.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "common.hpp"
+
+//! Backing and prefault options of a futex_segment
+struct futex_segment_options
+{
+	//! Huge pages: a file in hugetlbfs_dir for named segments, MAP_HUGETLB for anonymous ones.
+	//! A named segment without hugetlbfs_dir asks for transparent huge pages with MADV_HUGEPAGE.
+	bool huge_pages = false;
+	//! hugetlbfs mount point for named segments, e.g. /dev/hugepages
+	std::string hugetlbfs_dir;
+	//! Use normal pages if no huge pages are available instead of throwing
+	bool huge_pages_fallback = true;
+	//! Prefault the pages with MAP_POPULATE
+	bool populate = false;
+	//! Keep the pages resident with mlock, fails beyond RLIMIT_MEMLOCK
+	bool lock = false;
+	//! Number of named objects in the segment, used only by the creator
+	std::uint32_t directory_capacity = 64u;
+	//! Time an opener waits for the creator to initialize the segment
+	std::chrono::milliseconds init_timeout{1000};
+};
+
+namespace futex_detail
+{
+
+//! Segment header, the segment is ready when the creator has set the magic
+struct segment_header
+{
+	std::atomic< std::uint32_t > magic;
+	std::uint32_t version;
+	std::uint64_t size;
+	std::uint32_t directory_capacity;
+	std::uint32_t huge_pages;
+	//! Bump allocator of the object area
+	std::atomic< std::uint64_t > next_offset;
+};
+
+//! Directory entry of a named object
+struct segment_entry
+{
+	//! futex word, see futex_segment::entry_state. A busy entry holds the pid of its constructing process.
+	std::atomic< std::uint32_t > state;
+	std::uint32_t reserved;
+	std::uint64_t type_tag;
+	std::uint64_t offset;
+	std::uint64_t size;
+	char name[40];
+};
+
+//! FNV-1a hash of the type name, the same in every process built by the same compiler
+template< typename T >
+std::uint64_t segment_type_tag() noexcept
+{
+	std::uint64_t hash = 0xcbf29ce484222325ull;
+	for (const char* it = __PRETTY_FUNCTION__; *it; ++it)
+		hash = (hash ^ static_cast< unsigned char >(*it)) * 0x100000001b3ull;
+	return hash ^ (sizeof(T) << 48u);
+}
+
+} // namespace futex_detail
+
+//! Shared memory segment with a directory of named objects constructed in place exactly once.
+//! Replaces the shared_memory_object/truncate/mapped_region/placement new sequence:
+//!     futex_segment segment("/orders", 1 << 20);
+//!     auto& mutex = segment.find_or_construct< futex_mutex< shared_policy::interprocess > >("orders_mutex");
+//! Init handshake:
+//! - an existing segment is opened first, the hugetlbfs file before the /dev/shm object;
+//! - the segment is created with O_EXCL, the creator holds flock on it, sizes it and sets the header magic last,
+//!   openers wait for the magic (init_timeout) instead of using a half-initialized segment;
+//! - a creator without huge pages creates the /dev/shm object before it removes its hugetlbfs file,
+//!   and a hugetlbfs creator backs off if the /dev/shm object exists, so a name never splits in two segments;
+//! - an opener whose file is removed before the magic (the creator fell back or gave up) starts over,
+//!   the file of a creator which died before the magic (no flock after init_timeout) is removed and created again;
+//! - an object is claimed by a CAS which puts the pid of the claiming process into its directory entry,
+//!   the other processes sleep in futex on the entry until the constructor has finished;
+//! - entries are claimed in order and never freed: an entry whose constructor threw or whose
+//!   constructing process died keeps the name as a tombstone, which only a caller of that name retries.
+//! Named segments live in /dev/shm or in a hugetlbfs mount, anonymous ones are shared with children by fork.
+//! MAP_POPULATE and mlock move the page faults of the first touch to the creation.
+//! NOTE: objects must not contain pointers, their destructors are never called
+class futex_segment : boost::noncopyable
+{
+	enum : std::uint32_t
+	{
+		segment_magic	= 0x46534547u,
+		segment_version	= 1u
+	};
+
+	//! Directory entry states
+	enum entry_state : std::uint32_t
+	{
+		entry_free		= 0u,
+		entry_ready		= 1u,
+		//! tombstone: the construction failed, the name stays reserved
+		entry_failed	= 2u,
+		//! flag of a claimed entry, the rest is the pid of the constructing process
+		entry_busy		= 0x80000000u
+	};
+
+	//! Sleep between checks of the constructing process
+	enum : std::uint32_t { owner_check_ms = 10u };
+
+public:
+	//! Creates the named segment of at least size bytes of objects or opens the existing one
+	futex_segment(const char* name, std::size_t size, const futex_segment_options& options = futex_segment_options())
+	: m_name(name ? name : "")
+	{
+		if (!name || name[0] != '/' || std::strchr(name + 1, '/'))
+			THROW_EXCEPTION(futex_base_exception, "Segment name must be like /name");
+
+		const std::size_t total = segment_size(size, options.directory_capacity);
+		const bool hugetlbfs = options.huge_pages && !options.hugetlbfs_dir.empty();
+		for (;;)
+		{
+			int fd = -1;
+			bool huge_file = false;
+			if (hugetlbfs)
+			{
+				fd = ::open(hugetlbfs_path(options).c_str(), O_RDWR);
+				huge_file = fd >= 0;
+			}
+			if (fd < 0)
+				fd = ::shm_open(name, O_RDWR, 0);
+			if (fd >= 0)
+			{
+				if (attach(fd, huge_file, options))
+					return;
+				// removed before the initialization
+				continue;
+			}
+			if (errno != ENOENT)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			if (hugetlbfs ? create_hugetlbfs(total, options) : create_shm(total, options))
+				return;
+			// another process has created it first
+		}
+	}
+
+	//! Anonymous segment shared with the children forked after the construction
+	explicit futex_segment(std::size_t size, const futex_segment_options& options = futex_segment_options())
+	{
+		std::size_t total = segment_size(size, options.directory_capacity);
+		const int populate = options.populate ? MAP_POPULATE : 0;
+		if (options.huge_pages)
+		{
+			m_size = round_up(total, huge_page_size());
+			m_addr = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+			if (m_addr != MAP_FAILED)
+				m_huge_pages = true;
+			else if (!options.huge_pages_fallback)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		}
+		if (!m_huge_pages)
+		{
+			m_size = round_up(total, static_cast< std::size_t >(::sysconf(_SC_PAGESIZE)));
+			m_addr = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | populate, -1, 0);
+			if (m_addr == MAP_FAILED)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			if (options.huge_pages)
+				::madvise(m_addr, m_size, MADV_HUGEPAGE);
+		}
+		m_created = true;
+		lock_pages(options);
+		init_header(options.directory_capacity);
+	}
+
+	~futex_segment()
+	{
+		::munmap(m_addr, m_size);
+	}
+
+	//! Removes a named segment, the mappings stay valid. Returns false if there was no segment.
+	static bool remove(const char* name, const futex_segment_options& options = futex_segment_options())
+	{
+		bool removed = ::shm_unlink(name) == 0;
+		if (!options.hugetlbfs_dir.empty())
+			removed = ::unlink((options.hugetlbfs_dir + name).c_str()) == 0 || removed;
+		return removed;
+	}
+
+	//! Returns the named object, constructs it with args if it doesn't exist yet.
+	//! Concurrent callers in all the processes get the same object constructed once.
+	template< typename T, typename... Args >
+	T& find_or_construct(const char* name, Args&&... args)
+	{
+		check_name(name);
+		const std::uint64_t tag = futex_detail::segment_type_tag< T >();
+		for (std::uint32_t index = 0; index < header().directory_capacity; ++index)
+		{
+			futex_detail::segment_entry& item = entry(index);
+			for (;;)
+			{
+				std::uint32_t state = wait_while_busy(item);
+				if (state != entry_free)
+				{
+					if (std::strcmp(item.name, name) != 0)
+						break;
+					if (state == entry_ready)
+						return object< T >(item, tag);
+				}
+				// a free entry or the tombstone of the name: the first entry where the name may go
+				if (item.state.compare_exchange_strong(state, busy_state(), std::memory_order_acquire, std::memory_order_relaxed))
+					return construct< T >(item, name, tag, std::forward< Args >(args)...);
+				// lost the entry, look at the winner's object
+			}
+		}
+		THROW_EXCEPTION(futex_base_exception, "Segment directory is full");
+	}
+
+	//! The named object or nullptr, waits if the object is being constructed
+	template< typename T >
+	T* find(const char* name)
+	{
+		check_name(name);
+		for (std::uint32_t index = 0; index < header().directory_capacity; ++index)
+		{
+			futex_detail::segment_entry& item = entry(index);
+			const std::uint32_t state = wait_while_busy(item);
+			// the entries after the first free one are free too
+			if (state == entry_free)
+				break;
+			if (std::strcmp(item.name, name) == 0)
+				return state == entry_ready ? &object< T >(item, futex_detail::segment_type_tag< T >()) : nullptr;
+		}
+		return nullptr;
+	}
+
+	//! Whether this process created the segment
+	bool created() const noexcept
+	{
+		return m_created;
+	}
+
+	//! Whether the segment is backed by huge pages
+	bool huge_pages() const noexcept
+	{
+		return m_huge_pages;
+	}
+
+	void* address() const noexcept
+	{
+		return m_addr;
+	}
+
+	//! Mapped size including the header and the directory
+	std::size_t size() const noexcept
+	{
+		return m_size;
+	}
+
+	//! Default huge page size from /proc/meminfo, 2MB if unknown
+	static std::size_t huge_page_size()
+	{
+		std::ifstream meminfo("/proc/meminfo");
+		std::string key;
+		std::size_t value{0u};
+		while (meminfo >> key >> value)
+		{
+			if (key == "Hugepagesize:")
+				return value * 1024u;
+			meminfo.ignore(256, '\n');
+		}
+		return 2u * 1024u * 1024u;
+	}
+
+	//! Bytes left for new objects
+	std::size_t free_size() const noexcept
+	{
+		const std::uint64_t used = header().next_offset.load(std::memory_order_relaxed);
+		return used < header().size ? static_cast< std::size_t >(header().size - used) : 0u;
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static std::size_t round_up(std::size_t size, std::size_t unit) noexcept
+	{
+		return (size + unit - 1u) / unit * unit;
+	}
+
+	static std::size_t objects_offset(std::uint32_t directory_capacity) noexcept
+	{
+		return round_up(sizeof(futex_detail::segment_header) + directory_capacity * sizeof(futex_detail::segment_entry), futex_cache_line_size);
+	}
+
+	static std::size_t segment_size(std::size_t size, std::uint32_t directory_capacity)
+	{
+		if (!directory_capacity)
+			THROW_EXCEPTION(futex_base_exception, "Segment directory capacity must be positive");
+		return objects_offset(directory_capacity) + size;
+	}
+
+	//! The name starts with a slash
+	std::string hugetlbfs_path(const futex_segment_options& options) const
+	{
+		return options.hugetlbfs_dir + m_name;
+	}
+
+	//! Opens the existing hugetlbfs file or /dev/shm object of the segment
+	int open_existing(bool huge_file, const futex_segment_options& options) const noexcept
+	{
+		return huge_file ? ::open(hugetlbfs_path(options).c_str(), O_RDWR) : ::shm_open(m_name.c_str(), O_RDWR, 0);
+	}
+
+	void unlink_existing(bool huge_file, const futex_segment_options& options) const noexcept
+	{
+		if (huge_file)
+			::unlink(hugetlbfs_path(options).c_str());
+		else
+			::shm_unlink(m_name.c_str());
+	}
+
+	static bool owner_alive(pid_t pid) noexcept
+	{
+		return ::kill(pid, 0) == 0 || errno != ESRCH;
+	}
+
+	//! Claimed state of the calling process
+	static std::uint32_t busy_state() noexcept
+	{
+		return entry_busy | static_cast< std::uint32_t >(::getpid());
+	}
+
+	[[noreturn]] static void close_and_throw(int fd)
+	{
+		const int error = errno;
+		::close(fd);
+		THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+	}
+
+	//! Creates the segment in a hugetlbfs file, falls back to /dev/shm if allowed.
+	//! Returns false if another process has created the segment first.
+	bool create_hugetlbfs(std::size_t total, const futex_segment_options& options)
+	{
+		const std::string path = hugetlbfs_path(options);
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+		if (fd < 0)
+		{
+			if (errno == EEXIST)
+				return false;
+			if (!options.huge_pages_fallback)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			return create_shm(total, options);
+		}
+		if (!lock_new(fd))
+			return false;
+
+		// the /dev/shm segment of a fallback won the name
+		const int shm_fd = ::shm_open(m_name.c_str(), O_RDONLY, 0);
+		if (shm_fd >= 0)
+		{
+			::close(shm_fd);
+			::unlink(path.c_str());
+			::close(fd);
+			return false;
+		}
+
+		if (create(fd, total, options, true))
+			return true;
+		if (!options.huge_pages_fallback)
+		{
+			const int error = errno;
+			::unlink(path.c_str());
+			::close(fd);
+			THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+		}
+
+		// no huge pages: the /dev/shm segment must exist before the file is removed
+		bool created;
+		try
+		{
+			created = create_shm(total, options);
+		}
+		catch (...)
+		{
+			::unlink(path.c_str());
+			::close(fd);
+			throw;
+		}
+		::unlink(path.c_str());
+		::close(fd);
+		return created;
+	}
+
+	//! Creates the segment in /dev/shm. Returns false if another process has created it first.
+	bool create_shm(std::size_t total, const futex_segment_options& options)
+	{
+		int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+		if (fd < 0)
+		{
+			if (errno == EEXIST)
+				return false;
+			THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		}
+		if (!lock_new(fd))
+			return false;
+		if (create(fd, total, options, false))
+			return true;
+		const int error = errno;
+		::shm_unlink(m_name.c_str());
+		::close(fd);
+		THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+	}
+
+	//! Takes the flock of a new segment file. Returns false and closes fd if an opener has taken
+	//! the creator for a dead one and removed the file before the flock.
+	static bool lock_new(int fd) noexcept
+	{
+		struct stat st;
+		::flock(fd, LOCK_EX);
+		if (::fstat(fd, &st) == 0 && st.st_nlink > 0)
+			return true;
+		::close(fd);
+		return false;
+	}
+
+	//! Sizes, maps and initializes the new segment, closes fd and so releases its flock.
+	//! Returns false with errno set and fd open if the pages can't be allocated or locked.
+	bool create(int fd, std::size_t total, const futex_segment_options& options, bool hugetlbfs) noexcept
+	{
+		std::size_t unit = static_cast< std::size_t >(::sysconf(_SC_PAGESIZE));
+		if (hugetlbfs)
+		{
+			struct statfs fs;
+			if (::fstatfs(fd, &fs) != 0)
+				return false;
+			unit = static_cast< std::size_t >(fs.f_bsize);
+		}
+		m_size = round_up(total, unit);
+		if (::ftruncate(fd, static_cast< off_t >(m_size)) != 0 || !map(fd, options))
+			return false;
+		if (options.huge_pages && !hugetlbfs)
+			::madvise(m_addr, m_size, MADV_HUGEPAGE);
+		if (options.lock && ::mlock(m_addr, m_size) != 0)
+		{
+			const int error = errno;
+			::munmap(m_addr, m_size);
+			errno = error;
+			return false;
+		}
+
+		m_created = true;
+		m_huge_pages = hugetlbfs;
+		init_header(options.directory_capacity);
+		::close(fd);
+		return true;
+	}
+
+	//! Maps the segment if its creator has set the magic
+	bool map_initialized(int fd, const futex_segment_options& options)
+	{
+		struct stat st;
+		if (::fstat(fd, &st) != 0)
+			close_and_throw(fd);
+		if (static_cast< std::size_t >(st.st_size) < sizeof(futex_detail::segment_header))
+			return false;
+		m_size = static_cast< std::size_t >(st.st_size);
+		if (!map(fd, options))
+			close_and_throw(fd);
+		if (header().magic.load(std::memory_order_acquire) == segment_magic)
+			return true;
+		::munmap(m_addr, m_size);
+		return false;
+	}
+
+	//! Maps the segment of another process once its creator has initialized it.
+	//! Returns false if the segment was removed before the initialization and must be looked up again.
+	bool attach(int fd, bool huge_file, const futex_segment_options& options)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + options.init_timeout;
+		while (!map_initialized(fd, options))
+		{
+			struct stat st;
+			if (::fstat(fd, &st) != 0)
+				close_and_throw(fd);
+			// the creator has removed it: fallback from hugetlbfs or failure
+			if (st.st_nlink == 0)
+			{
+				::close(fd);
+				return false;
+			}
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				// a live creator holds the flock until the magic is set
+				if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+				{
+					::close(fd);
+					THROW_EXCEPTION(futex_base_exception, "Segment is not initialized");
+				}
+				if (map_initialized(fd, options))
+					break;
+				// the creator died, remove its file unless it is already replaced
+				const int current = open_existing(huge_file, options);
+				struct stat current_st;
+				if (current >= 0 && ::fstat(current, &current_st) == 0 && current_st.st_ino == st.st_ino && current_st.st_dev == st.st_dev)
+					unlink_existing(huge_file, options);
+				if (current >= 0)
+					::close(current);
+				::close(fd);
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		::close(fd);
+
+		const futex_detail::segment_header& head = header();
+		if (head.version != segment_version || objects_offset(head.directory_capacity) + head.size > m_size)
+		{
+			::munmap(m_addr, m_size);
+			THROW_EXCEPTION(futex_base_exception, "Segment has incompatible layout");
+		}
+		m_huge_pages = head.huge_pages != 0u;
+		lock_pages(options);
+		return true;
+	}
+
+	bool map(int fd, const futex_segment_options& options) noexcept
+	{
+		m_addr = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | (options.populate ? MAP_POPULATE : 0), fd, 0);
+		return m_addr != MAP_FAILED;
+	}
+
+	void lock_pages(const futex_segment_options& options)
+	{
+		if (options.lock && ::mlock(m_addr, m_size) != 0)
+		{
+			const int error = errno;
+			::munmap(m_addr, m_size);
+			THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+		}
+	}
+
+	//! The new segment is zero-filled: all the entries are free
+	void init_header(std::uint32_t directory_capacity) noexcept
+	{
+		futex_detail::segment_header& head = header();
+		head.version = segment_version;
+		head.directory_capacity = directory_capacity;
+		head.size = m_size - objects_offset(directory_capacity);
+		head.huge_pages = m_huge_pages ? 1u : 0u;
+		head.next_offset.store(0u, std::memory_order_relaxed);
+		head.magic.store(segment_magic, std::memory_order_release);
+	}
+
+	futex_detail::segment_header& header() const noexcept
+	{
+		return *static_cast< futex_detail::segment_header* >(m_addr);
+	}
+
+	futex_detail::segment_entry& entry(std::uint32_t index) const noexcept
+	{
+		return reinterpret_cast< futex_detail::segment_entry* >(static_cast< char* >(m_addr) + sizeof(futex_detail::segment_header))[index];
+	}
+
+	static void check_name(const char* name)
+	{
+		if (!name || !*name || std::strlen(name) >= sizeof(futex_detail::segment_entry::name))
+			THROW_EXCEPTION(futex_base_exception, "Object name must have 1 to 39 characters");
+	}
+
+	//! Sleeps while the entry is busy. The entry of a dead constructing process becomes a tombstone.
+	static std::uint32_t wait_while_busy(futex_detail::segment_entry& item)
+	{
+		const struct timespec timeout = { 0, owner_check_ms * 1000000l };
+		std::uint32_t current = item.state.load(std::memory_order_acquire);
+		while (current & entry_busy)
+		{
+			int res = futex(&item.state, FUTEX_WAIT, static_cast< int >(current), &timeout, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT && !owner_alive(static_cast< pid_t >(current & ~entry_busy)))
+			{
+				if (item.state.compare_exchange_strong(current, entry_failed, std::memory_order_acquire, std::memory_order_acquire))
+				{
+					futex(&item.state, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+					return entry_failed;
+				}
+				continue;
+			}
+			else if (res != 0 && errno != ETIMEDOUT && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			current = item.state.load(std::memory_order_acquire);
+		}
+		return current;
+	}
+
+	static void publish(futex_detail::segment_entry& item, std::uint32_t state) noexcept
+	{
+		item.state.store(state, std::memory_order_release);
+		futex(&item.state, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	//! Allocates and constructs the object of a claimed entry
+	template< typename T, typename... Args >
+	T& construct(futex_detail::segment_entry& item, const char* name, std::uint64_t tag, Args&&... args)
+	{
+		// the name first: waiters compare it as soon as the entry is not busy
+		std::strcpy(item.name, name);
+		futex_detail::segment_header& head = header();
+		const std::size_t align = alignof(T) > futex_cache_line_size ? alignof(T) : futex_cache_line_size;
+		std::uint64_t offset = head.next_offset.load(std::memory_order_relaxed);
+		std::uint64_t start, next;
+		do
+		{
+			start = round_up(offset, align);
+			next = start + sizeof(T);
+			if (next > head.size)
+			{
+				publish(item, entry_failed);
+				THROW_EXCEPTION(futex_base_exception, "No room in the segment");
+			}
+		}
+		while (!head.next_offset.compare_exchange_weak(offset, next, std::memory_order_relaxed, std::memory_order_relaxed));
+
+		item.type_tag = tag;
+		item.offset = start;
+		item.size = sizeof(T);
+
+		void* addr = static_cast< char* >(m_addr) + objects_offset(head.directory_capacity) + start;
+		try
+		{
+			new (addr) T(std::forward< Args >(args)...);
+		}
+		catch (...)
+		{
+			// the name stays reserved for a retry, the memory is lost
+			publish(item, entry_failed);
+			throw;
+		}
+		publish(item, entry_ready);
+		return *static_cast< T* >(addr);
+	}
+
+	//! The object of a ready entry
+	template< typename T >
+	T& object(futex_detail::segment_entry& item, std::uint64_t tag)
+	{
+		if (item.type_tag != tag || item.size != sizeof(T))
+			THROW_EXCEPTION(futex_base_exception, "Segment object has a different type");
+		return *reinterpret_cast< T* >(static_cast< char* >(m_addr) + objects_offset(header().directory_capacity) + item.offset);
+	}
+
+	std::string m_name;
+	void* m_addr = nullptr;
+	std::size_t m_size = 0u;
+	bool m_created = false;
+	bool m_huge_pages = false;
+};
+
+#endif
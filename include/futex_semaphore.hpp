@@ -3,6 +3,7 @@
 
 #include "futex_mutex.hpp"
 #include "futex_condition_variable.hpp"
+#include "futex_probes.hpp"
 
 //! Simple and naive semaphore realization with own mutex and condition variable
 //! Semantics are similar to <semaphore.h>
@@ -13,46 +14,86 @@ class futex_semaphore : boost::noncopyable
 	using mutex_t = futex_mutex< policy >;
 	using condition_t = futex_condition_variable< policy >;
 public:
-	explicit futex_semaphore(std::int32_t maximum_simultaneous_workers) : m_limit(maximum_simultaneous_workers), m_waiters(0u)
+	explicit futex_semaphore(std::int32_t maximum_simultaneous_workers) : m_limit(maximum_simultaneous_workers), m_count(maximum_simultaneous_workers)
 	{
-		if (m_limit <= 0u)
+		if (m_limit <= 0)
 			THROW_EXCEPTION(std::runtime_error, "Maximum waiters must be greater than zero");
 	}
 
+	//! Takes a slot if there is a free one, never blocks
+	bool try_wait()
+	{
+		futex_mutex_lock_guard< mutex_t > lk(m_mutex);
+		if (m_count <= 0)
+			return false;
+		--m_count;
+		return true;
+	}
+
 	void wait()
 	{
 		futex_mutex_unique_lock< mutex_t > lk(m_mutex);
-		++m_waiters;
-		m_cond.wait(lk, [&](){ return m_waiters.load() <= m_limit; });
+		if (m_count <= 0)
+		{
+			FUTEX_PROBE1(sem_block, this);
+			m_cond.wait(lk, [&](){ return m_count > 0; });
+			FUTEX_PROBE2(sem_unblock, this, 1);
+		}
+		--m_count;
 	}
 
 	template< typename Rep, typename Period >
 	bool wait_for(const std::chrono::duration< Rep, Period >& waited_time)
 	{
 		futex_mutex_unique_lock< mutex_t > lk(m_mutex);
-		++m_waiters;
-		if (!m_cond.wait_for(lk, waited_time, [&](){ return m_waiters.load() <= m_limit; }))
+		if (m_count <= 0)
 		{
-			--m_waiters;
-			return false;
+			FUTEX_PROBE1(sem_block, this);
+			const bool acquired = m_cond.wait_for(lk, waited_time, [&](){ return m_count > 0; });
+			FUTEX_PROBE2(sem_unblock, this, acquired ? 1 : 0);
+			if (!acquired)
+				return false;
 		}
 
+		--m_count;
 		return true;
 	}
 
-	void post()
+	template< typename Clock, typename Duration >
+	bool wait_until(const std::chrono::time_point< Clock, Duration >& timeout_time)
 	{
-		futex_mutex_lock_guard< decltype(m_mutex) > lk(m_mutex);
-		if (m_waiters.load() == 0u)
-			return;
+		futex_mutex_unique_lock< mutex_t > lk(m_mutex);
+		if (m_count <= 0)
+		{
+			FUTEX_PROBE1(sem_block, this);
+			const bool acquired = m_cond.wait_until(lk, timeout_time, [&](){ return m_count > 0; });
+			FUTEX_PROBE2(sem_unblock, this, acquired ? 1 : 0);
+			if (!acquired)
+				return false;
+		}
+
+		--m_count;
+		return true;
+	}
 
-		--m_waiters;
+	void post()
+	{
+		{
+			futex_mutex_lock_guard< decltype(m_mutex) > lk(m_mutex);
+			// post without wait is ignored
+			if (m_count >= m_limit)
+				return;
+			++m_count;
+		}
 		m_cond.notify_one();
 	}
 
 private:
-	const std::uint32_t m_limit;
-	std::atomic< std::int32_t > m_waiters;
+	template< typename > friend class futex_waitable;
+
+	const std::int32_t m_limit;
+	//! Free slots, guarded by m_mutex
+	std::int32_t m_count;
 	//! Synchronized mutex
 	mutex_t m_mutex;
 	//! Condition variable
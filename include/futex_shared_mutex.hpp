@@ -0,0 +1,433 @@
+#ifndef FUTEX_SHARED_MUTEX_HPP_
+#define FUTEX_SHARED_MUTEX_HPP_
+
+#include <errno.h>
+#include <climits>
+#include <cstddef>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "common.hpp"
+#include "futex_spin_policy.hpp"
+#include "futex_mutex.hpp"
+
+//! Reader-writer lock on one futex word, writer-preferring. Based on:
+//! https://github.com/rust-lang/rust/blob/master/library/std/src/sys/sync/rwlock/futex.rs
+//!
+//! The word holds the number of readers (or the write-locked mark) and two waiting bits.
+//! New readers don't get the lock while a writer waits, so readers can't starve writers.
+//! Readers sleep on the state word and are woken all at once, writers sleep on a separate
+//! notification counter and are woken one by one.
+//! Meets the SharedLockable requirements: lock/try_lock/unlock, lock_shared/try_lock_shared/unlock_shared.
+//!
+//! shared policy: whether a mutex can synchronize different processes or not
+//! backoff: pause strategy of a short spin before sleeping, see futex_spin_policy.hpp
+template< shared_policy policy, typename backoff = default_backoff >
+class futex_shared_mutex : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Data layout: [ writers_waiting:1 | readers_waiting:1 | readers or write_locked:30 ]
+	enum : std::uint32_t
+	{
+		read_locked		= 1u,
+		mask			= (1u << 30) - 1u,
+		write_locked	= mask,
+		max_readers		= mask - 1u,
+		readers_waiting	= 1u << 30,
+		writers_waiting	= 1u << 31
+	};
+
+	//! Upper bound of spin iterations before sleeping
+	enum : std::uint32_t { spin_count = 100u };
+
+public:
+	futex_shared_mutex() : m_state(0u), m_writer_notify(0u)
+	{
+		if (!m_state.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_state must be lock-free");
+	}
+
+	void lock()
+	{
+		std::uint32_t state{0u};
+		if (!m_state.compare_exchange_weak(state, write_locked, std::memory_order_acquire, std::memory_order_relaxed))
+			lock_contended();
+	}
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		while (is_unlocked(state))
+		{
+			if (m_state.compare_exchange_weak(state, state + write_locked, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		const std::uint32_t state = m_state.fetch_sub(write_locked, std::memory_order_release) - write_locked;
+		if (state & (readers_waiting | writers_waiting))
+			wake_writer_or_readers(state);
+	}
+
+	void lock_shared()
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		if (!is_read_lockable(state)
+			|| !m_state.compare_exchange_weak(state, state + read_locked, std::memory_order_acquire, std::memory_order_relaxed))
+			lock_shared_contended();
+	}
+
+	bool try_lock_shared()
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		while (is_read_lockable(state))
+		{
+			if (m_state.compare_exchange_weak(state, state + read_locked, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		if ((state & mask) == max_readers)
+			THROW_EXCEPTION(futex_base_exception, "Too many readers");
+		return false;
+	}
+
+	void unlock_shared() noexcept
+	{
+		const std::uint32_t state = m_state.fetch_sub(read_locked, std::memory_order_release) - read_locked;
+		// readers wait on a read-locked mutex only together with a writer, the last reader wakes it
+		if (is_unlocked(state) && (state & writers_waiting))
+			wake_writer_or_readers(state);
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static bool is_unlocked(std::uint32_t state) noexcept { return (state & mask) == 0u; }
+	static bool is_write_locked(std::uint32_t state) noexcept { return (state & mask) == write_locked; }
+	static bool is_read_lockable(std::uint32_t state) noexcept
+	{
+		// writer preference: waiting writers block new readers
+		return (state & mask) < max_readers && !(state & (readers_waiting | writers_waiting));
+	}
+
+	//! Spins while the predicate on the state is false, returns the last state
+	template< typename Predicate >
+	std::uint32_t spin_until(Predicate&& pred) noexcept
+	{
+		std::uint32_t state = m_state.load(std::memory_order_relaxed);
+		if (!backoff::enabled())
+			return state;
+		backoff pause;
+		for (std::uint32_t cc = 0; cc < spin_count && !pred(state); ++cc)
+		{
+			pause.pause();
+			state = m_state.load(std::memory_order_relaxed);
+		}
+		return state;
+	}
+
+	std::uint32_t spin_read() noexcept
+	{
+		return spin_until([](std::uint32_t state) {
+			return !is_write_locked(state) || (state & (readers_waiting | writers_waiting));
+		});
+	}
+
+	std::uint32_t spin_write() noexcept
+	{
+		return spin_until([](std::uint32_t state) { return is_unlocked(state) || (state & writers_waiting); });
+	}
+
+	void lock_shared_contended()
+	{
+		std::uint32_t state = spin_read();
+		for (;;)
+		{
+			if (is_read_lockable(state))
+			{
+				if (m_state.compare_exchange_weak(state, state + read_locked, std::memory_order_acquire, std::memory_order_relaxed))
+					return;
+				continue;
+			}
+			if ((state & mask) == max_readers)
+				THROW_EXCEPTION(futex_base_exception, "Too many readers");
+
+			// the bit must be set before sleeping, otherwise unlock doesn't wake us
+			if (!(state & readers_waiting))
+			{
+				if (!m_state.compare_exchange_weak(state, state | readers_waiting, std::memory_order_relaxed))
+					continue;
+			}
+			wait(&m_state, state | readers_waiting);
+			state = spin_read();
+		}
+	}
+
+	void lock_contended()
+	{
+		std::uint32_t state = spin_write();
+		// after a sleep other writers may sleep too, keep writers_waiting when locking
+		std::uint32_t other_writers_waiting{0u};
+		for (;;)
+		{
+			if (is_unlocked(state))
+			{
+				if (m_state.compare_exchange_weak(state, state | write_locked | other_writers_waiting,
+					std::memory_order_acquire, std::memory_order_relaxed))
+					return;
+				continue;
+			}
+
+			if (!(state & writers_waiting))
+			{
+				if (!m_state.compare_exchange_weak(state, state | writers_waiting, std::memory_order_relaxed))
+					continue;
+			}
+			other_writers_waiting = writers_waiting;
+
+			// the notification counter is read before the last check of the state: a wake between them changes it
+			const std::uint32_t seq = m_writer_notify.load(std::memory_order_acquire);
+			state = m_state.load(std::memory_order_relaxed);
+			if (is_unlocked(state) || !(state & writers_waiting))
+				continue;
+			wait(&m_writer_notify, seq);
+			state = spin_write();
+		}
+	}
+
+	//! Unlocked state with waiting bits: a writer goes first, readers only if no writer is asleep
+	void wake_writer_or_readers(std::uint32_t state) noexcept
+	{
+		if (state == writers_waiting)
+		{
+			if (m_state.compare_exchange_strong(state, 0u, std::memory_order_relaxed))
+			{
+				wake_writer();
+				return;
+			}
+		}
+
+		if (state == (readers_waiting | writers_waiting))
+		{
+			// otherwise somebody locked the mutex and its unlock wakes
+			if (!m_state.compare_exchange_strong(state, readers_waiting, std::memory_order_relaxed))
+				return;
+			if (wake_writer())
+				return;
+			state = readers_waiting;
+		}
+
+		if (state == readers_waiting)
+		{
+			if (m_state.compare_exchange_strong(state, 0u, std::memory_order_relaxed))
+				futex(&m_state, ops::wake, INT_MAX, nullptr, nullptr, 0);
+		}
+	}
+
+	//! Returns whether a writer was actually asleep
+	bool wake_writer() noexcept
+	{
+		m_writer_notify.fetch_add(1u, std::memory_order_release);
+		return futex(&m_writer_notify, ops::wake, 1, nullptr, nullptr, 0) > 0;
+	}
+
+	void wait(std::atomic< std::uint32_t >* word, std::uint32_t expected)
+	{
+		if (futex(word, ops::wait, expected, nullptr, nullptr, 0) != 0 && errno != EAGAIN && errno != EINTR)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+	}
+
+	//! Readers count, write-locked mark and waiting bits
+	std::atomic< std::uint32_t > m_state;
+	//! Sequence counter the writers sleep on
+	std::atomic< std::uint32_t > m_writer_notify;
+};
+
+
+//! Reader-writer lock with distributed reader indicators, like percpu_rw_semaphore in the kernel:
+//! https://github.com/torvalds/linux/blob/master/kernel/locking/percpu-rwsem.c
+//!
+//! A reader increments the counter of its CPU in a separate cache line and checks the writer gate,
+//! so readers on different CPUs don't share any written cache line. A writer closes the gate,
+//! waits until the sum of all counters drops to zero and is therefore much more expensive:
+//! use it for read-mostly data. Counters are indexed by the current CPU, unlock on another CPU
+//! decrements another counter: only the sum is meaningful.
+//! Writers are serialized by futex_mutex, the gate counts pending writers and stays closed
+//! while any of them waits (writer preference).
+//!
+//! shared policy: whether a mutex can synchronize different processes or not
+//! slots: number of reader counters, CPU number is taken modulo slots
+template< shared_policy policy, std::size_t slots = 64u >
+class futex_percpu_shared_mutex : boost::noncopyable
+{
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	static_assert(slots > 0u, "At least one reader slot is required");
+
+	//! Gate layout: [ pending writers:31 | readers_waiting:1 ]
+	//! Drain layout: [ sequence:31 | writer_sleeps:1 ]
+	enum : std::uint32_t
+	{
+		readers_waiting	= 1u,
+		one_writer		= 2u,
+		writer_sleeps	= 1u
+	};
+
+	struct alignas(futex_cache_line_size) reader_slot
+	{
+		std::atomic< std::int32_t > readers;
+	};
+
+public:
+	futex_percpu_shared_mutex() : m_gate(0u), m_drain(0u)
+	{
+		if (!m_gate.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "m_gate must be lock-free");
+		for (auto&& slot : m_slots)
+			slot.readers.store(0, std::memory_order_relaxed);
+	}
+
+	void lock()
+	{
+		m_gate.fetch_add(one_writer, std::memory_order_seq_cst);
+		m_writer.lock();
+		wait_readers_drained();
+	}
+
+	bool try_lock()
+	{
+		m_gate.fetch_add(one_writer, std::memory_order_seq_cst);
+		if (m_writer.try_lock())
+		{
+			if (readers() == 0)
+				return true;
+			m_writer.unlock();
+		}
+		open_gate();
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		m_writer.unlock();
+		open_gate();
+	}
+
+	void lock_shared()
+	{
+		while (!try_lock_shared())
+			wait_gate_open();
+	}
+
+	bool try_lock_shared() noexcept
+	{
+		reader_slot& slot = current_slot();
+		// pairs with the writer: it closes the gate and then sums the counters
+		slot.readers.fetch_add(1, std::memory_order_seq_cst);
+		if (BOOST_LIKELY(m_gate.load(std::memory_order_seq_cst) < one_writer))
+			return true;
+		release_slot(slot);
+		return false;
+	}
+
+	void unlock_shared() noexcept
+	{
+		release_slot(current_slot());
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	reader_slot& current_slot() noexcept
+	{
+		const int cpu = ::sched_getcpu();
+		return m_slots[cpu > 0 ? static_cast< std::size_t >(cpu) % slots : 0u];
+	}
+
+	std::int64_t readers() const noexcept
+	{
+		std::int64_t sum{0};
+		for (auto&& slot : m_slots)
+			sum += slot.readers.load(std::memory_order_seq_cst);
+		return sum;
+	}
+
+	//! Decrements a counter, wakes the draining writer if there is one
+	void release_slot(reader_slot& slot) noexcept
+	{
+		slot.readers.fetch_sub(1, std::memory_order_seq_cst);
+		if (BOOST_LIKELY(m_gate.load(std::memory_order_seq_cst) < one_writer))
+			return;
+		// bumping the sequence clears writer_sleeps
+		if (m_drain.load(std::memory_order_seq_cst) & writer_sleeps)
+		{
+			m_drain.fetch_add(1u, std::memory_order_seq_cst);
+			futex(&m_drain, ops::wake, 1, nullptr, nullptr, 0);
+		}
+	}
+
+	//! The gate is closed and the writer owns m_writer
+	void wait_readers_drained()
+	{
+		for (;;)
+		{
+			const std::uint32_t seq = m_drain.fetch_or(writer_sleeps, std::memory_order_seq_cst) | writer_sleeps;
+			if (readers() == 0)
+				return;
+			if (futex(&m_drain, ops::wait, seq, nullptr, nullptr, 0) != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		}
+	}
+
+	//! The last pending writer opens the gate and wakes readers
+	void open_gate() noexcept
+	{
+		std::uint32_t gate = m_gate.fetch_sub(one_writer, std::memory_order_release) - one_writer;
+		// otherwise a new writer came, its unlock wakes
+		if (gate == readers_waiting && m_gate.compare_exchange_strong(gate, 0u, std::memory_order_relaxed))
+			futex(&m_gate, ops::wake, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	void wait_gate_open()
+	{
+		std::uint32_t gate = m_gate.load(std::memory_order_relaxed);
+		while (gate >= one_writer)
+		{
+			if (!(gate & readers_waiting))
+			{
+				if (!m_gate.compare_exchange_weak(gate, gate | readers_waiting, std::memory_order_relaxed))
+					continue;
+				gate |= readers_waiting;
+			}
+			if (futex(&m_gate, ops::wait, gate, nullptr, nullptr, 0) != 0 && errno != EAGAIN && errno != EINTR)
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			gate = m_gate.load(std::memory_order_relaxed);
+		}
+	}
+
+	//! Reader counters, one cache line each
+	reader_slot m_slots[slots];
+	//! Pending writers and readers_waiting bit, readers sleep on it
+	alignas(futex_cache_line_size) std::atomic< std::uint32_t > m_gate;
+	//! Sequence the draining writer sleeps on
+	std::atomic< std::uint32_t > m_drain;
+	//! Serializes writers
+	futex_mutex< policy > m_writer;
+};
+
+#endif
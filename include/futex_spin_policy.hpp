@@ -0,0 +1,291 @@
+#ifndef FUTEX_SPIN_POLICY_HPP_
+#define FUTEX_SPIN_POLICY_HPP_
+
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "common.hpp"
+
+//! CPU relax instruction for spin loops.
+//! PAUSE on x86 costs ~10 cycles before Skylake and ~140 cycles after it,
+//! so spin loops should be measured in time, not in PAUSE count.
+inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__)) cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#else
+	asm volatile("" ::: "memory");
+#endif
+}
+
+
+//! Machine properties which matter for spinning. Detected once per process:
+//! - online CPUs, CPUs in affinity mask and cgroup CPU quota
+//! - SMT siblings per core
+//! - cost of one cpu_relax() calibrated against the TSC
+class spin_environment
+{
+public:
+	static const spin_environment& instance()
+	{
+		static const spin_environment env;
+		return env;
+	}
+
+	//! sysconf(_SC_NPROCESSORS_ONLN)
+	std::uint32_t online_cpus() const noexcept { return m_online_cpus; }
+	//! CPUs in the affinity mask of the process
+	std::uint32_t affinity_cpus() const noexcept { return m_affinity_cpus; }
+	//! cgroup CPU quota in CPUs (quota / period), 0 if not limited
+	double cgroup_cpu_quota() const noexcept { return m_cgroup_quota; }
+	//! Hardware threads per core
+	std::uint32_t smt_siblings() const noexcept { return m_smt_siblings; }
+	//! CPUs the process can really run on simultaneously
+	std::uint32_t effective_cpus() const noexcept { return m_effective_cpus; }
+	//! Cost of one cpu_relax() in TSC cycles (0 if TSC is unavailable) and in nanoseconds
+	double pause_cycles() const noexcept { return m_pause_cycles; }
+	double pause_ns() const noexcept { return m_pause_ns; }
+
+	//! Spinning is useless if the lock owner cannot run while we spin
+	bool spinning_useful() const noexcept { return m_effective_cpus > 1u; }
+
+	//! Number of cpu_relax() calls which take about `ns` nanoseconds
+	std::uint32_t pauses_for(std::uint32_t ns) const noexcept
+	{
+		return std::max(1u, static_cast< std::uint32_t >(ns / m_pause_ns));
+	}
+
+private:
+	spin_environment()
+	: m_online_cpus(1u), m_affinity_cpus(1u), m_cgroup_quota(0.), m_smt_siblings(1u)
+	, m_effective_cpus(1u), m_pause_cycles(0.), m_pause_ns(1.)
+	{
+		long online = ::sysconf(_SC_NPROCESSORS_ONLN);
+		m_online_cpus = online > 0 ? static_cast< std::uint32_t >(online) : 1u;
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		m_affinity_cpus = ::sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : m_online_cpus;
+
+		m_cgroup_quota = read_cgroup_quota();
+		m_smt_siblings = std::max(1u, count_cpu_list(read_line("/sys/devices/system/cpu/cpu0/topology/thread_siblings_list")));
+
+		m_effective_cpus = std::max(1u, std::min(m_online_cpus, m_affinity_cpus));
+		if (m_cgroup_quota > 0.)
+			m_effective_cpus = std::max(1u, std::min(m_effective_cpus, static_cast< std::uint32_t >(std::ceil(m_cgroup_quota))));
+
+		calibrate_pause();
+	}
+
+	static std::string read_line(const char* path)
+	{
+		std::ifstream file(path);
+		std::string line;
+		std::getline(file, line);
+		return line;
+	}
+
+	//! Counts CPUs in list like "0-3,8,10-11"
+	static std::uint32_t count_cpu_list(const std::string& list) noexcept
+	{
+		std::uint32_t count{0u};
+		std::size_t pos{0u};
+		try
+		{
+			while (pos < list.size())
+			{
+				std::size_t end = list.find(',', pos);
+				if (end == std::string::npos)
+					end = list.size();
+				const std::string range = list.substr(pos, end - pos);
+				const std::size_t dash = range.find('-');
+				if (dash == std::string::npos)
+					count += range.empty() ? 0u : 1u;
+				else
+					count += std::stoul(range.substr(dash + 1)) - std::stoul(range.substr(0, dash)) + 1u;
+				pos = end + 1;
+			}
+		}
+		catch (const std::exception&)
+		{
+			return 0u;
+		}
+		return count;
+	}
+
+	//! cgroup v2 cpu.max ("quota period" or "max period") or cgroup v1 cfs quota
+	static double read_cgroup_quota()
+	{
+		try
+		{
+			const std::string v2 = read_line("/sys/fs/cgroup/cpu.max");
+			if (!v2.empty())
+			{
+				if (v2.compare(0, 3, "max") == 0)
+					return 0.;
+				const std::size_t space = v2.find(' ');
+				const double quota = std::stod(v2.substr(0, space));
+				const double period = space == std::string::npos ? 100000. : std::stod(v2.substr(space + 1));
+				return period > 0. ? quota / period : 0.;
+			}
+
+			const std::string quota = read_line("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+			const std::string period = read_line("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+			if (!quota.empty() && !period.empty() && std::stod(quota) > 0. && std::stod(period) > 0.)
+				return std::stod(quota) / std::stod(period);
+		}
+		catch (const std::exception&)
+		{
+			// unknown format, treat as unlimited
+		}
+		return 0.;
+	}
+
+	//! Best of several short runs, the first ones are usually disturbed by frequency scaling
+	void calibrate_pause()
+	{
+		constexpr int pauses = 2000;
+		double best_ns = 1e9, best_cycles = 0.;
+		for (int round = 0; round < 5; ++round)
+		{
+			auto start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+			std::uint64_t tsc_start = __rdtsc();
+#endif
+			for (int i = 0; i < pauses; ++i)
+				cpu_relax();
+#if defined(__x86_64__) || defined(__i386__)
+			std::uint64_t tsc_finish = __rdtsc();
+#endif
+			auto finish = std::chrono::steady_clock::now();
+
+			const double ns = std::chrono::duration< double, std::nano >(finish - start).count() / pauses;
+			if (ns < best_ns)
+			{
+				best_ns = ns;
+#if defined(__x86_64__) || defined(__i386__)
+				best_cycles = static_cast< double >(tsc_finish - tsc_start) / pauses;
+#endif
+			}
+		}
+		m_pause_ns = std::max(best_ns, 0.1);
+		m_pause_cycles = best_cycles;
+	}
+
+	std::uint32_t m_online_cpus;
+	std::uint32_t m_affinity_cpus;
+	double m_cgroup_quota;
+	std::uint32_t m_smt_siblings;
+	std::uint32_t m_effective_cpus;
+	double m_pause_cycles;
+	double m_pause_ns;
+};
+
+
+//! Backoff strategies for spin loops, used as a template parameter of the primitives.
+//! Strategy requirements:
+//!   static bool enabled() noexcept;  // whether to spin at all
+//!   void pause() noexcept;           // one backoff step between attempts
+//!
+//! No spinning at all
+struct no_spin_backoff
+{
+	static bool enabled() noexcept { return false; }
+	void pause() noexcept {}
+};
+
+
+//! One cpu_relax() per attempt
+struct fixed_backoff
+{
+	static bool enabled() noexcept { return spin_environment::instance().spinning_useful(); }
+	void pause() noexcept { cpu_relax(); }
+};
+
+
+//! Pause duration doubles after every attempt up to max_step_ns.
+//! Reduces cache line traffic on the lock word when many threads spin.
+template< std::uint32_t max_step_ns = 1000u >
+class exponential_backoff
+{
+public:
+	exponential_backoff() noexcept : m_step(1u) {}
+
+	static bool enabled() noexcept { return spin_environment::instance().spinning_useful(); }
+
+	void pause() noexcept
+	{
+		for (std::uint32_t i = 0; i < m_step; ++i)
+			cpu_relax();
+		m_step = std::min(m_step * 2u, max_step());
+	}
+
+private:
+	static std::uint32_t max_step() noexcept
+	{
+		static const std::uint32_t step = spin_environment::instance().pauses_for(max_step_ns);
+		return step;
+	}
+
+	std::uint32_t m_step;
+};
+
+
+//! Constant pause of step_ns per attempt; the whole spin is bounded by total_ns,
+//! after it the strategy yields the CPU instead of pausing.
+template< std::uint32_t step_ns = 100u, std::uint32_t total_ns = 10000u >
+class bounded_backoff
+{
+public:
+	bounded_backoff() noexcept : m_spent(0u) {}
+
+	static bool enabled() noexcept { return spin_environment::instance().spinning_useful(); }
+
+	void pause() noexcept
+	{
+		if (m_spent >= total_ns)
+		{
+			::sched_yield();
+			return;
+		}
+		static const std::uint32_t step = spin_environment::instance().pauses_for(step_ns);
+		for (std::uint32_t i = 0; i < step; ++i)
+			cpu_relax();
+		m_spent += step_ns;
+	}
+
+private:
+	std::uint32_t m_spent;
+};
+
+
+//! Default strategy of the primitives
+using default_backoff = exponential_backoff<>;
+
+
+//! Kept for compatibility, use cpu_relax() and spin_environment instead
+inline void spinlock_pause()
+{
+	cpu_relax();
+}
+
+//! On one-processor machine (or container) spinlock is dummy code
+inline bool need_spinlock()
+{
+	return spin_environment::instance().spinning_useful();
+}
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FUTEX_SPSC_RING_HPP_
+#define FUTEX_SPSC_RING_HPP_
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_spin_policy.hpp"
+
+//! Contiguous part of a futex_spsc_ring: a reserved record of the producer or a record of the consumer
+struct futex_ring_span
+{
+	char* data;
+	std::size_t size;
+
+	explicit operator bool() const noexcept
+	{
+		return data != nullptr;
+	}
+};
+
+//! Single-producer single-consumer ring of variable-size records for shared memory.
+//! Based on:
+//! https://www.1024cores.net/home/lock-free-algorithms/queues/unbounded-spsc-queue (cached indices)
+//! https://lwn.net/Articles/576885/ (the sleeping side announces itself, the other side wakes only then)
+//! The producer reserves a contiguous span, writes the record in place and commits it,
+//! the consumer peeks the record in place and releases it: no copies and no locks.
+//! Each side keeps a cached copy of the index of the other side and reads the shared index
+//! only when the cache says full or empty. A side which has to sleep sets its futex flag,
+//! the other side makes a FUTEX_WAKE only if the flag is set, so a busy channel makes no syscalls.
+//! Records are 8-byte aligned and have an 8-byte header, a record which doesn't fit before
+//! the end of the buffer is preceded by a padding record and starts at the beginning.
+//!
+//! shared policy: whether the producer and the consumer may be different processes
+//! capacity: buffer size in bytes, a power of two. Records are at most capacity / 2 - 8 bytes.
+//! NOTE: one producer and one consumer, one outstanding reservation and one peeked record at a time
+template< shared_policy policy, std::size_t capacity, typename backoff = default_backoff >
+class futex_spsc_ring : boost::noncopyable
+{
+	static_assert(capacity >= 64u && !(capacity & (capacity - 1u)), "Capacity must be a power of two, at least 64 bytes");
+
+	//! Futex operations of the policy
+	using ops = futex_ops< policy >;
+
+	//! Record header
+	struct record_header
+	{
+		std::uint32_t size;
+		std::uint32_t flags;
+	};
+
+	enum : std::uint32_t
+	{
+		header_size		= sizeof(record_header),
+		record_align	= 8u,
+		//! the record fills the rest of the buffer and has no data
+		padding_flag	= 1u,
+		//! spin attempts before sleeping
+		spin_count		= 100u
+	};
+
+public:
+	futex_spsc_ring()
+	{
+		if (!m_tail.is_lock_free() || !m_consumer_sleeping.is_lock_free())
+			THROW_EXCEPTION(futex_base_exception, "Ring indices must be lock-free");
+	}
+
+	//! Largest record
+	static constexpr std::size_t max_record_size() noexcept
+	{
+		return capacity / 2u - header_size;
+	}
+
+	//! Producer: reserves a span of size bytes if there is room, never blocks.
+	//! The span is published by commit, an uncommitted reservation is dropped by the next one.
+	futex_ring_span try_reserve(std::size_t size)
+	{
+		if (size > max_record_size())
+			THROW_EXCEPTION(futex_base_exception, "Record is larger than max_record_size()");
+
+		const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		const std::size_t offset = tail & (capacity - 1u);
+		const std::size_t need = align(header_size + size);
+		const std::size_t padding = need > capacity - offset ? capacity - offset : 0u;
+		if (capacity - (tail - m_cached_head) < padding + need)
+		{
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			if (capacity - (tail - m_cached_head) < padding + need)
+				return { nullptr, 0u };
+		}
+
+		if (padding)
+			*reinterpret_cast< record_header* >(m_data + offset) = record_header{ 0u, padding_flag };
+		m_reserved = tail + padding;
+		m_reserved_size = size;
+		return { m_data + ((tail + padding) & (capacity - 1u)) + header_size, size };
+	}
+
+	//! Producer: reserves, sleeps while there is no room
+	futex_ring_span reserve(std::size_t size)
+	{
+		futex_ring_span span{ nullptr, 0u };
+		wait(m_producer_sleeping, [&]() { return static_cast< bool >(span = try_reserve(size)); }, nullptr);
+		return span;
+	}
+
+	template< typename Rep, typename Period >
+	futex_ring_span reserve_for(std::size_t size, const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		futex_ring_span span = try_reserve(size);
+		if (!span)
+		{
+			const futex_deadline deadline = make_futex_deadline(waited_time);
+			wait(m_producer_sleeping, [&]() { return static_cast< bool >(span = try_reserve(size)); }, &deadline);
+		}
+		return span;
+	}
+
+	//! Producer: publishes the reserved record with its first size bytes, wakes a sleeping consumer
+	void commit(std::size_t size)
+	{
+		if (size > m_reserved_size)
+			THROW_EXCEPTION(futex_base_exception, "Committed size is larger than the reservation");
+		*reinterpret_cast< record_header* >(m_data + (m_reserved & (capacity - 1u))) = record_header{ static_cast< std::uint32_t >(size), 0u };
+		m_tail.store(m_reserved + align(header_size + size), std::memory_order_release);
+		m_reserved_size = 0u;
+		notify(m_consumer_sleeping);
+	}
+
+	//! Producer: copies a record in, never blocks
+	bool try_write(const void* data, std::size_t size)
+	{
+		const futex_ring_span span = try_reserve(size);
+		if (!span)
+			return false;
+		std::memcpy(span.data, data, size);
+		commit(size);
+		return true;
+	}
+
+	//! Consumer: the next record if there is one, never blocks. The record stays in the ring until release.
+	futex_ring_span try_peek() noexcept
+	{
+		std::uint64_t head = m_head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if (head == m_cached_tail)
+			{
+				m_cached_tail = m_tail.load(std::memory_order_acquire);
+				if (head == m_cached_tail)
+					return { nullptr, 0u };
+			}
+
+			const std::size_t offset = head & (capacity - 1u);
+			const record_header header = *reinterpret_cast< const record_header* >(m_data + offset);
+			if (header.flags & padding_flag)
+			{
+				// the padding is freed at once
+				head += capacity - offset;
+				m_head.store(head, std::memory_order_release);
+				continue;
+			}
+			m_peeked = head + align(header_size + header.size);
+			return { m_data + offset + header_size, header.size };
+		}
+	}
+
+	//! Consumer: peeks, sleeps while the ring is empty
+	futex_ring_span peek()
+	{
+		futex_ring_span span{ nullptr, 0u };
+		wait(m_consumer_sleeping, [&]() { return static_cast< bool >(span = try_peek()); }, nullptr);
+		return span;
+	}
+
+	template< typename Rep, typename Period >
+	futex_ring_span peek_for(const std::chrono::duration< Rep, Period >& waited_time)
+	{
+		futex_ring_span span = try_peek();
+		if (!span)
+		{
+			const futex_deadline deadline = make_futex_deadline(waited_time);
+			wait(m_consumer_sleeping, [&]() { return static_cast< bool >(span = try_peek()); }, &deadline);
+		}
+		return span;
+	}
+
+	//! Consumer: frees the peeked record, wakes a sleeping producer
+	void release() noexcept
+	{
+		m_head.store(m_peeked, std::memory_order_release);
+		notify(m_producer_sleeping);
+	}
+
+	//! Consumer: copies the next record out, never blocks. Returns the record size, or 0 if the ring is empty
+	//! or the record is larger than max_size.
+	std::size_t try_read(void* data, std::size_t max_size)
+	{
+		const futex_ring_span span = try_peek();
+		if (!span || span.size > max_size)
+			return 0u;
+		std::memcpy(data, span.data, span.size);
+		release();
+		return span.size;
+	}
+
+	//! Bytes in use including headers and padding, may be outdated at once
+	std::size_t used_approx() const noexcept
+	{
+		return static_cast< std::size_t >(m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed));
+	}
+
+private:
+	//! Base wrapper for futex syscall
+	static int futex(void* uaddr, int futex_op, int val, const struct timespec* timeout, int* uaddr2, int val3) noexcept
+	{
+		return ::syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+	}
+
+	static constexpr std::size_t align(std::size_t size) noexcept
+	{
+		return (size + record_align - 1u) & ~static_cast< std::size_t >(record_align - 1u);
+	}
+
+	//! Runs op until it succeeds: a bounded spin, then announces the sleep in the flag and sleeps on it.
+	//! The flag is set before the last check, so the other side either sees it after its own update
+	//! or the check sees the update.
+	template< typename Op >
+	bool wait(std::atomic< std::uint32_t >& sleeping, Op op, const futex_deadline* deadline)
+	{
+		if (op())
+			return true;
+		if (backoff::enabled())
+		{
+			backoff spin_backoff;
+			for (std::uint32_t spin = 0; spin < spin_count; ++spin)
+			{
+				spin_backoff.pause();
+				if (op())
+					return true;
+			}
+		}
+
+		for (;;)
+		{
+			sleeping.store(1u, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (op())
+			{
+				sleeping.store(0u, std::memory_order_relaxed);
+				return true;
+			}
+
+			int res = deadline
+				? futex(&sleeping, ops::wait_bitset | deadline->clock_flag, 1, &deadline->abs_time, nullptr, FUTEX_BITSET_MATCH_ANY)
+				: futex(&sleeping, ops::wait, 1, nullptr, nullptr, 0);
+			if (res != 0 && errno == ETIMEDOUT)
+			{
+				sleeping.store(0u, std::memory_order_relaxed);
+				return op();
+			}
+			else if (res != 0 && errno != EAGAIN && errno != EINTR)
+			{
+				sleeping.store(0u, std::memory_order_relaxed);
+				THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+			}
+			if (op())
+			{
+				sleeping.store(0u, std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+
+	//! Wakes the other side if it announced a sleep
+	void notify(std::atomic< std::uint32_t >& sleeping) noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(0u, std::memory_order_relaxed))
+			futex(&sleeping, ops::wake, 1, nullptr, nullptr, 0);
+	}
+
+	//! Producer line: published write position and the producer's own state
+	alignas(64) std::atomic< std::uint64_t > m_tail{0u};
+	std::uint64_t m_cached_head{0u};
+	std::uint64_t m_reserved{0u};
+	std::size_t m_reserved_size{0u};
+	//! Consumer line: published read position and the consumer's own state
+	alignas(64) std::atomic< std::uint64_t > m_head{0u};
+	std::uint64_t m_cached_tail{0u};
+	std::uint64_t m_peeked{0u};
+	//! Sleep flags, each written by its own side and cleared by the waker
+	alignas(64) std::atomic< std::uint32_t > m_consumer_sleeping{0u};
+	alignas(64) std::atomic< std::uint32_t > m_producer_sleeping{0u};
+	alignas(64) char m_data[capacity];
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef FUTEX_STATS_HPP_
+#define FUTEX_STATS_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "common.hpp"
+
+//! Statistics policies of the primitives: futex_mutex, futex_condition_variable and
+//! futex_counting_semaphore call the hooks on their lock and wait paths.
+//!
+//! futex_no_stats is the default: an empty class of empty inline hooks, the timestamps
+//! are constant zeros, so lock() and unlock() compile exactly as without statistics.
+//! futex_contention_stats counts with relaxed atomics, it works in shared memory too.
+//! The counters of the lock owner are updated with plain loads and stores, the mutex orders them,
+//! only the counters of waiters and wakers need atomic increments.
+//!
+//! Meaning of the counters:
+//! mutex: acquisitions - successful locks, contended - locks not taken by the first CAS,
+//! spin_successes - contended locks taken by the spin, futex_waits / futex_wakes - syscalls,
+//! spurious_wakeups - wakeups which found the mutex taken again, wait time - time from the
+//! failed CAS to the lock, hold time - time from the lock to the unlock.
+//! condition variable: acquisitions - completed waits, futex_waits / futex_wakes - syscalls,
+//! spurious_wakeups - wakeups with a false predicate, wait time - time in wait, no hold time.
+//! semaphore: acquisitions - taken units, contended - waits which had to sleep,
+//! futex_waits / futex_wakes - syscalls, wait time - time of the contended waits, no hold time.
+
+//! Count of log2 histogram buckets: bucket i counts durations in [2^i, 2^(i+1)) ns,
+//! the last one everything longer
+constexpr std::size_t futex_stats_buckets = 32u;
+
+//! Plain copy of statistics
+struct futex_stats_snapshot
+{
+	std::uint64_t acquisitions = 0u;
+	std::uint64_t contended = 0u;
+	std::uint64_t spin_successes = 0u;
+	std::uint64_t futex_waits = 0u;
+	std::uint64_t futex_wakes = 0u;
+	std::uint64_t spurious_wakeups = 0u;
+	std::array< std::uint64_t, futex_stats_buckets > wait_ns{};
+	std::array< std::uint64_t, futex_stats_buckets > hold_ns{};
+};
+
+
+//! Disabled statistics
+class futex_no_stats
+{
+public:
+	static constexpr bool enabled = false;
+
+	static constexpr std::uint64_t now() noexcept { return 0u; }
+
+	void acquired(bool, std::uint64_t) noexcept {}
+	void released() noexcept {}
+	void spin_success() noexcept {}
+	void futex_wait() noexcept {}
+	void futex_wake() noexcept {}
+	void spurious_wakeup() noexcept {}
+	void waited(bool, std::uint64_t) noexcept {}
+
+	futex_stats_snapshot snapshot() const noexcept { return {}; }
+	void reset() noexcept {}
+};
+
+
+//! Contention counters and log-scale histograms of wait and hold times
+class futex_contention_stats
+{
+public:
+	static constexpr bool enabled = true;
+
+	//! Monotonic timestamp in ns
+	static std::uint64_t now() noexcept
+	{
+		return static_cast< std::uint64_t >(std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	//! Lock is taken, wait_start is the timestamp of the failed fast path if contended
+	void acquired(bool contended, std::uint64_t wait_start) noexcept
+	{
+		const std::uint64_t timestamp = now();
+		owner_increment(m_acquisitions);
+		if (contended)
+		{
+			owner_increment(m_contended);
+			owner_increment(m_wait_ns[bucket(timestamp - wait_start)]);
+		}
+		m_acquired_at = timestamp;
+	}
+
+	//! Lock is about to be released by the owner
+	void released() noexcept
+	{
+		owner_increment(m_hold_ns[bucket(now() - m_acquired_at)]);
+	}
+
+	//! Called by the new owner
+	void spin_success() noexcept { owner_increment(m_spin_successes); }
+	void futex_wait() noexcept { increment(m_futex_waits); }
+	void futex_wake() noexcept { increment(m_futex_wakes); }
+	void spurious_wakeup() noexcept { increment(m_spurious_wakeups); }
+
+	//! Wait without ownership (condition variable, semaphore) is completed
+	void waited(bool contended, std::uint64_t wait_start) noexcept
+	{
+		increment(m_acquisitions);
+		if (contended)
+		{
+			increment(m_contended);
+			increment(m_wait_ns[bucket(now() - wait_start)]);
+		}
+	}
+
+	//! Counters are read one by one, the snapshot isn't atomic as a whole
+	futex_stats_snapshot snapshot() const noexcept
+	{
+		futex_stats_snapshot res;
+		res.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+		res.contended = m_contended.load(std::memory_order_relaxed);
+		res.spin_successes = m_spin_successes.load(std::memory_order_relaxed);
+		res.futex_waits = m_futex_waits.load(std::memory_order_relaxed);
+		res.futex_wakes = m_futex_wakes.load(std::memory_order_relaxed);
+		res.spurious_wakeups = m_spurious_wakeups.load(std::memory_order_relaxed);
+		for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+		{
+			res.wait_ns[index] = m_wait_ns[index].load(std::memory_order_relaxed);
+			res.hold_ns[index] = m_hold_ns[index].load(std::memory_order_relaxed);
+		}
+		return res;
+	}
+
+	void reset() noexcept
+	{
+		for (auto* counter : { &m_acquisitions, &m_contended, &m_spin_successes, &m_futex_waits, &m_futex_wakes, &m_spurious_wakeups })
+			counter->store(0u, std::memory_order_relaxed);
+		for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+		{
+			m_wait_ns[index].store(0u, std::memory_order_relaxed);
+			m_hold_ns[index].store(0u, std::memory_order_relaxed);
+		}
+	}
+
+	//! Histogram bucket of a duration
+	static constexpr std::size_t bucket(std::uint64_t ns) noexcept
+	{
+		if (ns < 2u)
+			return 0u;
+		const std::size_t log2 = 63u - static_cast< std::size_t >(__builtin_clzll(ns));
+		return log2 < futex_stats_buckets ? log2 : futex_stats_buckets - 1u;
+	}
+
+private:
+	static void increment(std::atomic< std::uint64_t >& counter) noexcept
+	{
+		counter.fetch_add(1u, std::memory_order_relaxed);
+	}
+
+	//! Single writer at a time: no locked instruction, readers see a consistent value
+	static void owner_increment(std::atomic< std::uint64_t >& counter) noexcept
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+	}
+
+	std::atomic< std::uint64_t > m_acquisitions{0u};
+	std::atomic< std::uint64_t > m_contended{0u};
+	std::atomic< std::uint64_t > m_spin_successes{0u};
+	std::atomic< std::uint64_t > m_futex_waits{0u};
+	std::atomic< std::uint64_t > m_futex_wakes{0u};
+	std::atomic< std::uint64_t > m_spurious_wakeups{0u};
+	std::array< std::atomic< std::uint64_t >, futex_stats_buckets > m_wait_ns{};
+	std::array< std::atomic< std::uint64_t >, futex_stats_buckets > m_hold_ns{};
+	//! Timestamp of the last acquisition
+	std::uint64_t m_acquired_at = 0u;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FUTEX_THREAD_HPP_
+#define FUTEX_THREAD_HPP_
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+
+#include "common.hpp"
+
+namespace futex_detail
+{
+
+inline pid_t& cached_tid() noexcept
+{
+	static thread_local pid_t tid = 0;
+	return tid;
+}
+
+inline void reset_cached_tid() noexcept
+{
+	cached_tid() = 0;
+}
+
+//! Kernel thread id of the caller. Cached per thread, the cache is dropped in a forked child.
+inline pid_t current_tid() noexcept
+{
+	pid_t& tid = cached_tid();
+	if (BOOST_UNLIKELY(!tid))
+	{
+		static const int registered = ::pthread_atfork(nullptr, nullptr, &reset_cached_tid);
+		(void)registered;
+		tid = static_cast< pid_t >(::syscall(SYS_gettid));
+	}
+	return tid;
+}
+
+} // namespace futex_detail
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef FUTEX_THREAD_POOL_HPP_
+#define FUTEX_THREAD_POOL_HPP_
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+#include "futex_eventcount.hpp"
+#include "futex_mpmc_queue.hpp"
+#include "futex_spin_policy.hpp"
+
+//! Options of a futex_thread_pool
+struct futex_thread_pool_options
+{
+	//! Number of workers, 0 - the CPUs the process can really run on
+	std::uint32_t threads = 0u;
+	//! How long an idle worker keeps looking for tasks before it parks, 0 - park at once.
+	//! Ignored when spinning is useless (one effective CPU).
+	std::chrono::nanoseconds spin_time{std::chrono::microseconds(20)};
+	//! Pin worker i to the i-th CPU of the process affinity mask
+	bool pin_threads = false;
+	//! Pin worker i to cpus[i % cpus.size()] instead, implies pin_threads
+	std::vector< int > cpus;
+};
+
+namespace futex_detail
+{
+
+//! Type-erased task of the pool
+struct pool_task
+{
+	virtual ~pool_task() = default;
+	virtual void run() = 0;
+};
+
+template< typename F >
+struct pool_task_impl final : pool_task
+{
+	explicit pool_task_impl(F&& f) : m_f(std::move(f)) {}
+	explicit pool_task_impl(const F& f) : m_f(f) {}
+
+	void run() override
+	{
+		m_f();
+	}
+
+	F m_f;
+};
+
+//! Bounded Chase-Lev work-stealing deque of pointers, C11 version of:
+//! https://fzn.fr/readings/ppopp13.pdf (Correct and Efficient Work-Stealing for Weak Memory Models)
+//! The owner pushes and pops at the bottom without a CAS except for the last item,
+//! thieves take from the top with one CAS.
+//! NOTE: push fails if the deque is full, a growing array would need reclamation of the old ones
+template< typename T, std::size_t capacity >
+class chase_lev_deque : boost::noncopyable
+{
+	static_assert(capacity >= 2u && !(capacity & (capacity - 1u)), "Capacity must be a power of two");
+
+public:
+	chase_lev_deque() noexcept
+	{
+		for (std::atomic< T* >& item : m_items)
+			item.store(nullptr, std::memory_order_relaxed);
+	}
+
+	//! Owner only
+	bool push(T* item) noexcept
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= static_cast< std::int64_t >(capacity))
+			return false;
+		m_items[bottom & (capacity - 1u)].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	//! Owner only, the newest item or nullptr
+	T* pop() noexcept
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = m_top.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T* item = m_items[bottom & (capacity - 1u)].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			// the last item: race the thieves for it
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				item = nullptr;
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	//! Any thread, the oldest item or nullptr if the deque is empty or another thread won the race
+	T* steal() noexcept
+	{
+		std::int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return nullptr;
+		T* item = m_items[top & (capacity - 1u)].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return item;
+	}
+
+	//! Number of items, may be outdated at once
+	std::size_t size_approx() const noexcept
+	{
+		const std::int64_t size = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+		return size > 0 ? static_cast< std::size_t >(size) : 0u;
+	}
+
+private:
+	alignas(64) std::atomic< std::int64_t > m_top{0};
+	alignas(64) std::atomic< std::int64_t > m_bottom{0};
+	alignas(64) std::atomic< T* > m_items[capacity];
+};
+
+} // namespace futex_detail
+
+//! Work-stealing thread pool, the idle workers park in futex_eventcount.
+//! Every worker owns a Chase-Lev deque: tasks submitted from a worker go to its own deque
+//! and run LIFO there, idle workers steal the oldest tasks of the others. Tasks submitted
+//! from other threads go to a shared futex_mpmc_queue, which blocks the submitter when full.
+//! An idle worker spins for spin_time looking for tasks, then registers in the eventcount,
+//! checks once more and parks: submit makes a FUTEX_WAKE only while a worker is registered there.
+//! The destructor runs all the submitted tasks before it joins the workers.
+//!
+//! NOTE: a task which throws terminates the process, like an exception in std::thread
+class futex_thread_pool : boost::noncopyable
+{
+	//! Capacity of the per-worker deques and of the shared queue
+	enum : std::size_t
+	{
+		deque_capacity	= 4096u,
+		queue_capacity	= 4096u
+	};
+
+	//! Time between the attempts of a spinning worker
+	enum : std::uint32_t { spin_step_ns = 500u };
+
+	using task_deque = futex_detail::chase_lev_deque< futex_detail::pool_task, deque_capacity >;
+
+	struct alignas(64) worker
+	{
+		task_deque deque;
+		std::thread thread;
+		//! xorshift state of the victim choice
+		std::uint32_t random{0u};
+	};
+
+	//! Worker of the calling thread
+	struct current_worker
+	{
+		futex_thread_pool* pool;
+		std::uint32_t index;
+	};
+
+public:
+	explicit futex_thread_pool(const futex_thread_pool_options& options = futex_thread_pool_options())
+	: m_spin_rounds(spin_rounds(options.spin_time))
+	{
+		const std::uint32_t threads = options.threads ? options.threads : spin_environment::instance().effective_cpus();
+		const std::vector< int > cpus = !options.cpus.empty() ? options.cpus
+			: options.pin_threads ? affinity_cpus() : std::vector< int >();
+
+		m_workers.reserve(threads);
+		for (std::uint32_t index = 0; index < threads; ++index)
+		{
+			m_workers.emplace_back(new worker);
+			m_workers.back()->random = index * 2654435761u + 1u;
+		}
+		try
+		{
+			for (std::uint32_t index = 0; index < threads; ++index)
+			{
+				m_workers[index]->thread = std::thread([this, index]() { run_worker(index); });
+				if (!cpus.empty())
+					pin(m_workers[index]->thread, cpus[index % cpus.size()]);
+			}
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+	}
+
+	//! Runs the tasks left and joins the workers
+	~futex_thread_pool()
+	{
+		stop();
+	}
+
+	//! Number of workers
+	std::size_t size() const noexcept
+	{
+		return m_workers.size();
+	}
+
+	//! Schedules f() on a worker. From a worker of this pool the task goes to the worker's deque
+	//! (run inline if the deque is full), from other threads to the shared queue.
+	template< typename F >
+	void submit(F&& f)
+	{
+		std::unique_ptr< futex_detail::pool_task > task(new futex_detail::pool_task_impl< typename std::decay< F >::type >(std::forward< F >(f)));
+		const current_worker& current = current_thread();
+		if (current.pool == this)
+		{
+			if (!m_workers[current.index]->deque.push(task.get()))
+			{
+				task->run();
+				return;
+			}
+		}
+		else
+			m_queue.push(task.get());
+		task.release();
+		m_idle.notify_one();
+	}
+
+	//! Index of the calling worker of this pool, -1 for other threads
+	int current_worker_index() const noexcept
+	{
+		const current_worker& current = current_thread();
+		return current.pool == this ? static_cast< int >(current.index) : -1;
+	}
+
+	//! Workers parked in futex, may be outdated at once
+	std::uint32_t parked_approx() const noexcept
+	{
+		return m_idle.waiters_approx();
+	}
+
+private:
+	static current_worker& current_thread() noexcept
+	{
+		static thread_local current_worker current{ nullptr, 0u };
+		return current;
+	}
+
+	static std::uint32_t spin_rounds(std::chrono::nanoseconds spin_time) noexcept
+	{
+		if (!spin_environment::instance().spinning_useful() || spin_time.count() <= 0)
+			return 0u;
+		return static_cast< std::uint32_t >(spin_time.count() / spin_step_ns) + 1u;
+	}
+
+	//! CPUs of the process affinity mask
+	static std::vector< int > affinity_cpus()
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (::sched_getaffinity(0, sizeof(set), &set) != 0)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(errno));
+		std::vector< int > cpus;
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+		}
+		return cpus;
+	}
+
+	static void pin(std::thread& thread, int cpu)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		const int res = ::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+		if (res != 0)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(res));
+	}
+
+	void stop() noexcept
+	{
+		m_stopping.store(true, std::memory_order_seq_cst);
+		m_idle.notify_all();
+		for (std::unique_ptr< worker >& item : m_workers)
+		{
+			if (item->thread.joinable())
+				item->thread.join();
+		}
+	}
+
+	//! Own deque, the shared queue, then the deques of the others from a random victim
+	futex_detail::pool_task* find_task(std::uint32_t index) noexcept
+	{
+		worker& self = *m_workers[index];
+		if (futex_detail::pool_task* task = self.deque.pop())
+			return task;
+		futex_detail::pool_task* task = nullptr;
+		if (m_queue.try_pop(task))
+			return task;
+
+		const std::uint32_t count = static_cast< std::uint32_t >(m_workers.size());
+		self.random ^= self.random << 13u;
+		self.random ^= self.random >> 17u;
+		self.random ^= self.random << 5u;
+		const std::uint32_t start = self.random % count;
+		for (std::uint32_t offset = 0; offset < count; ++offset)
+		{
+			const std::uint32_t victim = (start + offset) % count;
+			if (victim == index)
+				continue;
+			if ((task = m_workers[victim]->deque.steal()))
+				return task;
+		}
+		return nullptr;
+	}
+
+	//! A task found by a bounded spin, or nullptr
+	futex_detail::pool_task* spin_for_task(std::uint32_t index) noexcept
+	{
+		static const std::uint32_t step = spin_environment::instance().pauses_for(spin_step_ns);
+		for (std::uint32_t round = 0; round < m_spin_rounds && !m_stopping.load(std::memory_order_relaxed); ++round)
+		{
+			for (std::uint32_t pause = 0; pause < step; ++pause)
+				cpu_relax();
+			if (futex_detail::pool_task* task = find_task(index))
+				return task;
+		}
+		return nullptr;
+	}
+
+	void run_worker(std::uint32_t index)
+	{
+		current_thread() = current_worker{ this, index };
+		const std::string name = "futex-pool-" + std::to_string(index);
+		::pthread_setname_np(::pthread_self(), name.c_str());
+
+		for (;;)
+		{
+			futex_detail::pool_task* task = find_task(index);
+			if (!task)
+				task = spin_for_task(index);
+			if (!task)
+			{
+				// registered before the last look: a submit after it sees the waiter
+				const auto key = m_idle.prepare_wait();
+				task = find_task(index);
+				if (task)
+					m_idle.cancel_wait(key);
+				else if (m_stopping.load(std::memory_order_seq_cst))
+				{
+					m_idle.cancel_wait(key);
+					break;
+				}
+				else
+				{
+					m_idle.commit_wait(key);
+					continue;
+				}
+			}
+			std::unique_ptr< futex_detail::pool_task > owner(task);
+			task->run();
+		}
+		current_thread() = current_worker{ nullptr, 0u };
+	}
+
+	std::vector< std::unique_ptr< worker > > m_workers;
+	const std::uint32_t m_spin_rounds;
+	//! Tasks of the threads which are not workers
+	futex_mpmc_queue< shared_policy::inprocess, futex_detail::pool_task*, queue_capacity > m_queue;
+	//! Parked workers
+	alignas(64) futex_eventcount< shared_policy::inprocess > m_idle;
+	alignas(64) std::atomic< bool > m_stopping{false};
+};
+
+#endif
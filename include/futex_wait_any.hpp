@@ -0,0 +1,352 @@
+#ifndef FUTEX_WAIT_ANY_HPP_
+#define FUTEX_WAIT_ANY_HPP_
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+#include "common.hpp"
+#include "futex_deadline.hpp"
+#include "futex_mutex.hpp"
+#include "futex_condition_variable.hpp"
+#include "futex_semaphore.hpp"
+#include "futex_counting_semaphore.hpp"
+
+#if !defined(SYS_futex_waitv)
+//! Same number on all architectures, glibc headers older than Linux 5.16 miss it
+#	define SYS_futex_waitv 449
+#endif
+
+#if !defined(FUTEX_32)
+//! futex_waitv uapi of Linux 5.16, missing in older linux/futex.h
+#	define FUTEX_32 0x02u
+#	define FUTEX_WAITV_MAX 128u
+
+struct futex_waitv
+{
+	__u64 val;
+	__u64 uaddr;
+	__u32 flags;
+	__u32 __reserved;
+};
+#endif
+
+//! Result of wait_any_until when the deadline expires
+constexpr std::size_t futex_wait_any_timeout = static_cast< std::size_t >(-1);
+
+
+//! Adapter of a primitive for wait_any. Requirements:
+//!   explicit futex_waitable(Primitive&);
+//!   bool try_acquire();                               // takes the readiness without blocking
+//!   bool arm(struct futex_waitv& entry);              // registers a waiter and fills uaddr and val of the entry,
+//!                                                   // returns whether the primitive is ready already
+//!   bool disarm(const struct futex_waitv& entry, bool acquire);
+//!                                                   // unregisters; with acquire takes the readiness if any and
+//!                                                   // returns success, otherwise passes a consumed wakeup on
+//!   void before_sleep(); void after_sleep();          // around the futex_waitv
+//!   static constexpr bool spurious;                   // whether a wakeup may be returned without readiness
+template< typename Primitive >
+class futex_waitable;
+
+
+//! futex_counting_semaphore is ready when its value is positive, wait_any takes a unit
+template< shared_policy policy, typename stats >
+class futex_waitable< futex_counting_semaphore< policy, stats > >
+{
+	using semaphore_t = futex_counting_semaphore< policy, stats >;
+
+public:
+	static constexpr bool spurious = false;
+
+	explicit futex_waitable(semaphore_t& sem) noexcept : m_sem(sem) {}
+
+	bool try_acquire() noexcept { return m_sem.try_wait(); }
+
+	bool arm(struct futex_waitv& entry) noexcept
+	{
+		// post wakes only registered waiters
+		const std::uint64_t data = m_sem.m_data.fetch_add(semaphore_t::one_waiter, std::memory_order_relaxed) + semaphore_t::one_waiter;
+		entry.uaddr = reinterpret_cast< std::uintptr_t >(m_sem.value_word());
+		entry.val = 0u;
+		return (data & semaphore_t::value_mask) != 0u;
+	}
+
+	bool disarm(const struct futex_waitv&, bool acquire) noexcept
+	{
+		std::uint64_t data = m_sem.m_data.load(std::memory_order_relaxed);
+		while (acquire && (data & semaphore_t::value_mask))
+		{
+			// take a unit and unregister in one step
+			if (m_sem.m_data.compare_exchange_weak(data, data - 1u - semaphore_t::one_waiter, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				// the sleep is shared by all the entries, it isn't charged to the semaphore
+				m_sem.statistics().waited(false, 0u);
+				return true;
+			}
+		}
+		data = m_sem.m_data.fetch_sub(semaphore_t::one_waiter, std::memory_order_relaxed) - semaphore_t::one_waiter;
+		// the post may have woken us instead of a waiter which would take the unit
+		if ((data & semaphore_t::value_mask) && (data >> semaphore_t::waiters_shift))
+			semaphore_t::futex(m_sem.value_word(), futex_ops< policy >::wake, 1, nullptr, nullptr, 0);
+		return false;
+	}
+
+	void before_sleep() noexcept {}
+	void after_sleep() noexcept {}
+
+private:
+	semaphore_t& m_sem;
+};
+
+
+//! futex_semaphore is ready when it has a free slot, wait_any takes the slot
+template< shared_policy policy >
+class futex_waitable< futex_semaphore< policy > >
+{
+	using semaphore_t = futex_semaphore< policy >;
+
+public:
+	static constexpr bool spurious = false;
+
+	explicit futex_waitable(semaphore_t& sem) noexcept : m_sem(sem) {}
+
+	bool try_acquire() { return m_sem.try_wait(); }
+
+	bool arm(struct futex_waitv& entry)
+	{
+		// under the semaphore mutex: a post either sees the registered waiter or happened before the check
+		futex_mutex_lock_guard< decltype(m_sem.m_mutex) > lk(m_sem.m_mutex);
+		entry.uaddr = reinterpret_cast< std::uintptr_t >(m_sem.m_cond.any_arm(m_val));
+		entry.val = m_val;
+		return m_sem.m_count > 0;
+	}
+
+	bool disarm(const struct futex_waitv&, bool acquire)
+	{
+		{
+			futex_mutex_lock_guard< decltype(m_sem.m_mutex) > lk(m_sem.m_mutex);
+			m_sem.m_cond.any_disarm(m_val, true);
+			if (m_sem.m_count <= 0)
+				return false;
+			if (acquire)
+			{
+				--m_sem.m_count;
+				return true;
+			}
+		}
+		// the post may have woken us instead of a waiter which would take the slot
+		m_sem.m_cond.notify_one();
+		return false;
+	}
+
+	void before_sleep() noexcept {}
+	void after_sleep() noexcept {}
+
+private:
+	semaphore_t& m_sem;
+	std::uint32_t m_val = 0u;
+};
+
+
+//! Condition variable with the locked mutex of the caller, see notified()
+template< shared_policy policy, typename stats = futex_no_stats >
+struct futex_notified
+{
+	futex_condition_variable< policy, stats >& cond;
+	futex_mutex_unique_lock< futex_mutex< policy > >& lock;
+};
+
+//! wait_any argument: ready when the condition variable is notified.
+//! Like condition_variable::wait, the lock is released while sleeping, relocked on return,
+//! and the wakeup may be spurious: check the predicate after wait_any.
+template< shared_policy policy, typename stats >
+futex_notified< policy, stats > notified(futex_condition_variable< policy, stats >& cond, futex_mutex_unique_lock< futex_mutex< policy > >& lock) noexcept
+{
+	return futex_notified< policy, stats >{ cond, lock };
+}
+
+template< shared_policy policy, typename stats >
+class futex_waitable< futex_notified< policy, stats > >
+{
+public:
+	static constexpr bool spurious = true;
+
+	explicit futex_waitable(const futex_notified< policy, stats >& notified) noexcept : m_notified(notified) {}
+
+	//! A condition variable has no state, only notifications after arm count
+	bool try_acquire() noexcept { return false; }
+
+	bool arm(struct futex_waitv& entry)
+	{
+		entry.uaddr = reinterpret_cast< std::uintptr_t >(m_notified.cond.any_arm(m_val));
+		entry.val = m_val;
+		return false;
+	}
+
+	bool disarm(const struct futex_waitv&, bool acquire)
+	{
+		return m_notified.cond.any_disarm(m_val, acquire);
+	}
+
+	void before_sleep() { m_notified.lock.unlock(); }
+	void after_sleep() { m_notified.lock.lock(); }
+
+private:
+	futex_notified< policy, stats > m_notified;
+	std::uint32_t m_val = 0u;
+};
+
+
+namespace futex_detail
+{
+
+template< typename Primitive >
+struct waitable_policy;
+
+template< shared_policy policy, typename stats >
+struct waitable_policy< futex_counting_semaphore< policy, stats > > { static constexpr shared_policy value = policy; };
+
+template< shared_policy policy >
+struct waitable_policy< futex_semaphore< policy > > { static constexpr shared_policy value = policy; };
+
+template< shared_policy policy, typename stats >
+struct waitable_policy< futex_notified< policy, stats > > { static constexpr shared_policy value = policy; };
+
+//! Wait on all entries, absolute timeout. Returns 0 on a wakeup, errno otherwise
+inline int waitv(struct futex_waitv* entries, std::size_t count, const futex_deadline* deadline) noexcept
+{
+	const clockid_t clock = (deadline && deadline->clock_flag) ? CLOCK_REALTIME : CLOCK_MONOTONIC;
+	if (::syscall(SYS_futex_waitv, entries, static_cast< unsigned >(count), 0u, deadline ? &deadline->abs_time : nullptr, clock) >= 0)
+		return 0;
+	return errno;
+}
+
+template< typename Tuple, std::size_t... I >
+std::size_t try_acquire_any(Tuple& waitables, std::index_sequence< I... >)
+{
+	std::size_t res = futex_wait_any_timeout;
+	// stops at the first success
+	(void)((std::get< I >(waitables).try_acquire() ? (res = I, true) : false) || ...);
+	return res;
+}
+
+template< typename Tuple, std::size_t N, std::size_t... I >
+bool arm_all(Tuple& waitables, std::array< struct futex_waitv, N >& entries, std::index_sequence< I... >)
+{
+	bool ready = false;
+	((ready = std::get< I >(waitables).arm(entries[I]) || ready), ...);
+	return ready;
+}
+
+//! Disarms everything, the first primitive with readiness is acquired
+template< typename Tuple, std::size_t N, std::size_t... I >
+std::size_t disarm_all(Tuple& waitables, const std::array< struct futex_waitv, N >& entries, std::index_sequence< I... >)
+{
+	std::size_t res = futex_wait_any_timeout;
+	((std::get< I >(waitables).disarm(entries[I], res == futex_wait_any_timeout) ? (res = I) : res), ...);
+	return res;
+}
+
+template< typename Tuple, std::size_t... I >
+void before_sleep_all(Tuple& waitables, std::index_sequence< I... >)
+{
+	(std::get< I >(waitables).before_sleep(), ...);
+}
+
+template< typename Tuple, std::size_t... I >
+void after_sleep_all(Tuple& waitables, std::index_sequence< I... >)
+{
+	(std::get< I >(waitables).after_sleep(), ...);
+}
+
+//! Index of the first primitive which may wake up spuriously
+template< typename Tuple, std::size_t... I >
+constexpr std::size_t first_spurious(std::index_sequence< I... >)
+{
+	std::size_t res = futex_wait_any_timeout;
+	(void)((std::tuple_element_t< I, Tuple >::spurious ? (res = I, true) : false) || ...);
+	return res;
+}
+
+template< typename... Primitives >
+std::size_t wait_any_impl(const futex_deadline* deadline, Primitives&... primitives)
+{
+	constexpr std::size_t count = sizeof...(Primitives);
+	static_assert(count > 0u && count <= FUTEX_WAITV_MAX, "wait_any takes 1..FUTEX_WAITV_MAX primitives");
+	using tuple_t = std::tuple< futex_waitable< std::remove_const_t< Primitives > >... >;
+	using indices_t = std::index_sequence_for< Primitives... >;
+	constexpr std::size_t spurious_index = first_spurious< tuple_t >(indices_t{});
+
+	tuple_t waitables(primitives...);
+	std::size_t res = try_acquire_any(waitables, indices_t{});
+	if (res != futex_wait_any_timeout)
+		return res;
+
+	std::array< struct futex_waitv, count > entries{};
+	constexpr std::uint32_t flags[] = {
+		FUTEX_32 | (waitable_policy< std::remove_const_t< Primitives > >::value == shared_policy::inprocess ? FUTEX_PRIVATE_FLAG : 0u)...
+	};
+	for (std::size_t i = 0; i < count; ++i)
+		entries[i].flags = flags[i];
+
+	for (;;)
+	{
+		int error = 0;
+		if (!arm_all(waitables, entries, indices_t{}))
+		{
+			before_sleep_all(waitables, indices_t{});
+			error = waitv(entries.data(), count, deadline);
+			after_sleep_all(waitables, indices_t{});
+		}
+
+		res = disarm_all(waitables, entries, indices_t{});
+		if (res != futex_wait_any_timeout || error == ETIMEDOUT)
+			return res;
+		if (error != 0 && error != EAGAIN && error != EINTR)
+			THROW_EXCEPTION(futex_base_exception, std::strerror(error));
+		// the caller rechecks the predicate of its condition variable
+		if (spurious_index != futex_wait_any_timeout && error == 0)
+			return spurious_index;
+	}
+}
+
+} // namespace futex_detail
+
+
+//! Blocks until one of the primitives becomes ready and acquires it, returns its index in the argument list.
+//! Semaphores are acquired like wait() does, a condition variable is passed as notified(cond, lock).
+//! All the primitives are checked and registered at once, the thread sleeps in one futex_waitv syscall
+//! (Linux 5.16+) on private or shared futex words:
+//! https://docs.kernel.org/userspace-api/futex2.html
+//! If several primitives are ready, the first in the argument list is taken and wakeups consumed
+//! from the others are passed on to their other waiters.
+template< typename... Primitives >
+std::size_t wait_any(Primitives&&... primitives)
+{
+	return futex_detail::wait_any_impl(nullptr, primitives...);
+}
+
+//! Like wait_any, returns futex_wait_any_timeout if nothing became ready until the deadline (see futex_deadline.hpp)
+template< typename Clock, typename Duration, typename... Primitives >
+std::size_t wait_any_until(const std::chrono::time_point< Clock, Duration >& timeout_time, Primitives&&... primitives)
+{
+	const futex_deadline deadline = make_futex_deadline(timeout_time);
+	return futex_detail::wait_any_impl(&deadline, primitives...);
+}
+
+template< typename Rep, typename Period, typename... Primitives >
+std::size_t wait_any_for(const std::chrono::duration< Rep, Period >& timeout_duration, Primitives&&... primitives)
+{
+	const futex_deadline deadline = make_futex_deadline(timeout_duration);
+	return futex_detail::wait_any_impl(&deadline, primitives...);
+}
+
+#endif
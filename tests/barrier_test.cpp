@@ -0,0 +1,154 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_barrier.hpp"
+
+TEST(barrier_inprocess, phases) {
+	std::cout << "==========futex barrier phases test=======\n";
+	const std::uint32_t participants = 8u, phases = 2000u;
+	futex_barrier< shared_policy::inprocess > barrier(participants);
+	std::vector< std::uint32_t > progress(participants, 0u);
+	std::atomic< std::uint32_t > errors{0u};
+
+	auto worker = [&](std::uint32_t id) {
+		for (std::uint32_t phase = 0; phase < phases; ++phase)
+		{
+			progress[id] = phase + 1u;
+			barrier.arrive_and_wait();
+			// everybody finished the phase before anybody starts the next one
+			for (std::uint32_t other = 0; other < participants; ++other)
+			{
+				if (progress[other] < phase + 1u)
+					++errors;
+			}
+			barrier.arrive_and_wait();
+		}
+	};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < participants; ++id)
+		threads.emplace_back(worker, id);
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(errors, 0u);
+}
+
+TEST(barrier_inprocess, sleeping_waiters) {
+	std::cout << "==========futex barrier sleep test=======\n";
+	futex_barrier< shared_policy::inprocess > barrier(3u);
+	std::atomic< std::uint32_t > passed{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 2u; ++id)
+	{
+		threads.emplace_back([&]() {
+			barrier.arrive_and_wait();
+			++passed;
+		});
+	}
+	// the waiters are asleep long after their spin
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_EQ(passed, 0u);
+	barrier.arrive_and_wait();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(passed, 2u);
+}
+
+TEST(barrier_inprocess, arrive_and_drop) {
+	std::cout << "==========futex barrier drop test=======\n";
+	futex_barrier< shared_policy::inprocess > barrier(4u);
+	std::atomic< std::uint32_t > rounds{0u};
+	std::vector< std::thread > threads;
+	// worker id leaves after id + 1 phases
+	for (std::uint32_t id = 0; id < 3u; ++id)
+	{
+		threads.emplace_back([&barrier, &rounds, id]() {
+			for (std::uint32_t phase = 0; phase < id; ++phase)
+				barrier.arrive_and_wait();
+			barrier.arrive_and_drop();
+			++rounds;
+		});
+	}
+	for (std::uint32_t phase = 0; phase < 5u; ++phase)
+		barrier.arrive_and_wait();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(rounds, 3u);
+	EXPECT_EQ(barrier.expected(), 1u);
+
+	// the drop completes the phase if it was the last missing arrival
+	futex_barrier< shared_policy::inprocess > pair(2u);
+	std::thread waiter([&pair]() { pair.arrive_and_wait(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	pair.arrive_and_drop();
+	waiter.join();
+	EXPECT_EQ(pair.expected(), 1u);
+	EXPECT_THROW(futex_barrier< shared_policy::inprocess >(0u), futex_base_exception);
+}
+
+TEST(barrier_inprocess, split_phase) {
+	std::cout << "==========futex barrier split phase test=======\n";
+	futex_barrier< shared_policy::inprocess > barrier(2u);
+	std::atomic< bool > done{false};
+	std::thread other([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		done = true;
+		barrier.arrive_and_wait();
+	});
+	const futex_barrier_token token = barrier.arrive();
+	// independent work between arrive and wait
+	barrier.wait(token);
+	EXPECT_TRUE(done);
+	other.join();
+}
+
+TEST(barrier_interprocess, forked_workers) {
+	std::cout << "==========futex barrier interprocess test=======\n";
+	using barrier_t = futex_barrier< shared_policy::interprocess >;
+	struct shared_data
+	{
+		barrier_t barrier{4u};
+		std::atomic< std::uint32_t > counter{0u};
+		std::atomic< std::uint32_t > errors{0u};
+	};
+	const std::uint32_t workers = 3u, phases = 500u;
+	void* addr = ::mmap(nullptr, sizeof(shared_data), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	shared_data* data = new (addr) shared_data;
+
+	// every phase adds one per participant, the counter is checked after the barrier
+	auto body = [data, phases]() {
+		for (std::uint32_t phase = 0; phase < phases; ++phase)
+		{
+			data->counter.fetch_add(1u);
+			data->barrier.arrive_and_wait();
+			if (data->counter.load() < 4u * (phase + 1u))
+				data->errors.fetch_add(1u);
+			data->barrier.arrive_and_wait();
+		}
+	};
+	std::vector< int > children;
+	for (std::uint32_t worker = 0; worker < workers; ++worker)
+	{
+		int forkstatus = ::fork();
+		ASSERT_GE(forkstatus, 0);
+		if (forkstatus == 0)
+		{
+			body();
+			::_exit(0);
+		}
+		children.push_back(forkstatus);
+	}
+	body();
+	for (int child : children)
+		::waitpid(child, nullptr, 0);
+
+	EXPECT_EQ(data->counter.load(), 4u * phases);
+	EXPECT_EQ(data->errors.load(), 0u);
+	::munmap(addr, sizeof(shared_data));
+}
@@ -124,3 +124,79 @@ TEST(condition_variable_inprocess, notifyall_test) {
 	producer.join();
 	EXPECT_EQ(increment_variable, 10);
 }
+
+// notify_all requeues waiters to the mutex: all of them must pass the mutex one by one
+TEST(condition_variable_inprocess, notifyall_requeue_test) {
+	std::cout << "==========futex condition variable test notify_all with requeue=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_condition_variable< shared_policy::inprocess > cond;
+
+	bool flag {false};
+	int increment_variable = 0;
+	const int waiters = 64;
+	auto cons = [&]()
+	{
+		futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+		cond.wait(lock, [&flag](){ return flag; });
+		increment_variable++;
+		std::this_thread::sleep_for(std::chrono::microseconds(100u));
+	};
+	std::array< std::thread, waiters > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(cons);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200u));
+	{
+		futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+		flag = true;
+		cond.notify_all();
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(increment_variable, waiters);
+}
+
+TEST(condition_variable_inprocess, wait_until_test) {
+	std::cout << "==========futex condition variable test wait_until=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_condition_variable< shared_policy::inprocess > cond;
+
+	futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(cond.wait_until(lock, start + std::chrono::milliseconds(200)), futex_cv_status::timeout);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+
+	start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(cond.wait_until(lock, std::chrono::system_clock::now() + std::chrono::milliseconds(200), [](){ return false; }));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(190));
+
+	// deadline in the past
+	EXPECT_EQ(cond.wait_until(lock, std::chrono::steady_clock::now() - std::chrono::seconds(1)), futex_cv_status::timeout);
+}
+
+// predicate wait_for must not restart the whole timeout after every wakeup
+TEST(condition_variable_inprocess, wait_for_total_timeout) {
+	std::cout << "==========futex condition variable test wait_for total timeout=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_condition_variable< shared_policy::inprocess > cond;
+
+	std::atomic_bool stop {false};
+	std::thread notifier([&]() {
+		while (!stop)
+		{
+			cond.notify_all();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10u));
+		}
+	});
+
+	futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(cond.wait_for(lock, std::chrono::milliseconds(300), [](){ return false; }));
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	lock.unlock();
+	stop = true;
+	notifier.join();
+
+	EXPECT_GE(elapsed, std::chrono::milliseconds(300));
+	EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+}
@@ -0,0 +1,118 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "../include/futex_condition_variable.hpp"
+
+namespace
+{
+
+struct cv_page
+{
+	futex_condition_variable< shared_policy::interprocess > cond;
+	std::uint32_t ready = 0u;
+	bool signalling_flag = false;
+};
+
+struct mutex_page
+{
+	futex_mutex< shared_policy::interprocess > mutex;
+};
+
+} // namespace
+
+//the condition variable and the mutex live in different mappings,
+//mapped at a different distance from each other in every process
+TEST(condition_variable_notify_all_interprocess, separate_mappings) {
+	std::cout << "=======interprocess condition variable notify_all test========\n";
+	const std::string name = "/futex-cv-notify-all-" + std::to_string(::getpid());
+	const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	ASSERT_GE(fd, 0);
+	::shm_unlink(name.c_str());
+	const std::size_t page = static_cast< std::size_t >(::sysconf(_SC_PAGESIZE));
+	ASSERT_EQ(::ftruncate(fd, static_cast< off_t >(2 * page)), 0);
+
+	const std::size_t processes = 4u;
+	const std::size_t span = (processes + 2u) * page;
+	// mutex page at base + gap pages, the rest of the span stays mapped and readable
+	auto map = [fd, page, span](std::size_t gap) {
+		char* base = static_cast< char* >(::mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+		if (base == MAP_FAILED)
+			return std::make_pair< cv_page*, mutex_page* >(nullptr, nullptr);
+		void* cv_addr = ::mmap(base, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+		void* mutex_addr = ::mmap(base + gap * page, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, static_cast< off_t >(page));
+		if (cv_addr == MAP_FAILED || mutex_addr == MAP_FAILED)
+			return std::make_pair< cv_page*, mutex_page* >(nullptr, nullptr);
+		return std::make_pair(static_cast< cv_page* >(cv_addr), static_cast< mutex_page* >(mutex_addr));
+	};
+
+	auto parent = map(1u);
+	ASSERT_NE(parent.first, nullptr);
+	cv_page* data = new (parent.first) cv_page;
+	mutex_page* lock_data = new (parent.second) mutex_page;
+
+	std::array< int, processes > children;
+	for (std::size_t index = 0; index < processes; ++index)
+	{
+		children[index] = ::fork();
+		ASSERT_GE(children[index], 0);
+		if (children[index] == 0)
+		{
+			auto mine = map(index + 2u);
+			if (mine.first == nullptr)
+				::_exit(2);
+			futex_mutex_unique_lock< futex_mutex< shared_policy::interprocess > > lock(mine.second->mutex);
+			++mine.first->ready;
+			while (!mine.first->signalling_flag)
+			{
+				// waiters must be woken by notify_all, not by their timeout
+				if (mine.first->cond.wait_for(lock, std::chrono::seconds(3)) == futex_cv_status::timeout)
+					::_exit(1);
+			}
+			lock.unlock();
+			::_exit(0);
+		}
+	}
+
+	// every child is a registered waiter once it has counted itself and released the mutex
+	for (;;)
+	{
+		futex_mutex_unique_lock< futex_mutex< shared_policy::interprocess > > lock(lock_data->mutex);
+		if (data->ready == processes)
+		{
+			data->signalling_flag = true;
+			data->cond.notify_all();
+			break;
+		}
+		lock.unlock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// waiters lost by a wrong requeue never wake, kill them instead of hanging the test
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	for (int child : children)
+	{
+		int status = 0;
+		int res;
+		while ((res = ::waitpid(child, &status, WNOHANG)) == 0 && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (res == 0)
+		{
+			::kill(child, SIGKILL);
+			::waitpid(child, &status, 0);
+		}
+		EXPECT_TRUE(WIFEXITED(status));
+		EXPECT_EQ(WEXITSTATUS(status), 0);
+	}
+	::munmap(data, span);
+	::close(fd);
+}
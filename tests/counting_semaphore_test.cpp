@@ -0,0 +1,115 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+
+#include <gtest/gtest.h>
+#include "../include/futex_counting_semaphore.hpp"
+
+TEST(counting_semaphore_inprocess, try_wait) {
+	std::cout << "==========counting semaphore try_wait test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > sem{2u};
+	EXPECT_TRUE(sem.try_wait());
+	EXPECT_TRUE(sem.try_wait());
+	EXPECT_FALSE(sem.try_wait());
+	sem.post(3u);
+	EXPECT_EQ(sem.value(), 3u);
+	EXPECT_TRUE(sem.wait_for(std::chrono::milliseconds(0)));
+	EXPECT_EQ(sem.value(), 2u);
+}
+
+TEST(counting_semaphore_inprocess, wait_for_timeout) {
+	std::cout << "==========counting semaphore timeout test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > sem;
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(sem.wait_for(std::chrono::milliseconds(200)));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+	// no waiters are left registered
+	sem.post();
+	EXPECT_TRUE(sem.try_wait());
+}
+
+// post(n) lets exactly n of the blocked waiters through
+TEST(counting_semaphore_inprocess, post_n) {
+	std::cout << "==========counting semaphore post(n) test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > sem;
+	std::atomic< int > passed{0}, timeouts{0};
+	auto waiter = [&]()
+	{
+		if (sem.wait_for(std::chrono::seconds(2)))
+			++passed;
+		else
+			++timeouts;
+	};
+	std::array< std::thread, 10 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(waiter);
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	sem.post(7u);
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(passed, 7);
+	EXPECT_EQ(timeouts, 3);
+	EXPECT_EQ(sem.value(), 0u);
+}
+
+TEST(counting_semaphore_inprocess, contention) {
+	std::cout << "==========counting semaphore contention test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > sem{3u};
+	std::atomic< int > inside{0}, max_inside{0};
+	auto worker = [&]()
+	{
+		for (int i = 0; i < 2000; ++i)
+		{
+			sem.wait();
+			int now = ++inside;
+			int prev = max_inside.load();
+			while (now > prev && !max_inside.compare_exchange_weak(prev, now)) {}
+			--inside;
+			sem.post();
+		}
+	};
+	std::array< std::thread, 16 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(worker);
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_LE(max_inside, 3);
+	EXPECT_EQ(sem.value(), 3u);
+}
+
+TEST(counting_semaphore_interprocess, post_from_child) {
+	std::cout << "==========counting semaphore interprocess test=======\n";
+	void* addr = ::mmap(nullptr, sizeof(futex_counting_semaphore< shared_policy::interprocess >),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	auto* sem = new (addr) futex_counting_semaphore< shared_policy::interprocess >;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		sem->post(2u);
+		::_exit(0);
+	}
+
+	EXPECT_TRUE(sem->wait_for(std::chrono::seconds(5)));
+	EXPECT_TRUE(sem->wait_for(std::chrono::seconds(5)));
+	EXPECT_FALSE(sem->try_wait());
+	::waitpid(forkstatus, nullptr, 0);
+	::munmap(addr, sizeof(futex_counting_semaphore< shared_policy::interprocess >));
+}
+
+TEST(counting_semaphore_inprocess, wait_until) {
+	std::cout << "==========counting semaphore wait_until test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > sem;
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(sem.wait_until(start + std::chrono::milliseconds(100)));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+	EXPECT_FALSE(sem.wait_until(std::chrono::system_clock::now() + std::chrono::milliseconds(50)));
+	sem.post();
+	EXPECT_TRUE(sem.wait_until(std::chrono::system_clock::now() - std::chrono::seconds(1)));
+}
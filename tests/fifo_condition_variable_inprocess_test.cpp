@@ -0,0 +1,89 @@
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_fifo_condition_variable.hpp"
+
+// waiters are woken by notify_one strictly in order of arrival
+TEST(fifo_condition_variable_inprocess, notify_one_fifo_order) {
+	std::cout << "==========futex fifo condition variable test notify order=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_fifo_condition_variable< shared_policy::inprocess > cond;
+
+	int tickets = 0;
+	std::vector< int > order;
+	auto cons = [&](int id)
+	{
+		futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+		cond.wait(lock, [&tickets](){ return tickets > 0; });
+		--tickets;
+		order.push_back(id);
+	};
+
+	std::array< std::thread, 8 > threads;
+	for (auto i = 0u; i < threads.size(); ++i)
+	{
+		threads[i] = std::thread(cons, i);
+		// let the thread enqueue itself
+		std::this_thread::sleep_for(std::chrono::milliseconds(50u));
+	}
+	for (auto i = 0u; i < threads.size(); ++i)
+	{
+		{
+			futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+			++tickets;
+		}
+		cond.notify_one();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20u));
+	}
+	for (auto&& thread : threads)
+		thread.join();
+
+	ASSERT_EQ(order.size(), threads.size());
+	for (auto i = 0u; i < order.size(); ++i)
+		EXPECT_EQ(order[i], static_cast< int >(i));
+}
+
+TEST(fifo_condition_variable_inprocess, wait_for_timeout) {
+	std::cout << "==========futex fifo condition variable test timeout=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_fifo_condition_variable< shared_policy::inprocess > cond;
+
+	futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(cond.wait_for(lock, std::chrono::milliseconds(200)), futex_cv_status::timeout);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+	EXPECT_FALSE(cond.wait_for(lock, std::chrono::milliseconds(50), [](){ return false; }));
+	// the queue is empty after timeouts
+	cond.notify_one();
+	cond.notify_all();
+}
+
+TEST(fifo_condition_variable_inprocess, notifyall_test) {
+	std::cout << "==========futex fifo condition variable test notify_all=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	futex_fifo_condition_variable< shared_policy::inprocess > cond;
+
+	bool flag {false};
+	int increment_variable = 0;
+	auto cons = [&]()
+	{
+		futex_mutex_unique_lock< decltype(mutex) > lock(mutex);
+		if (cond.wait_for(lock, std::chrono::seconds(5), [&flag](){ return flag; }))
+			increment_variable++;
+	};
+	std::array< std::thread, 32 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(cons);
+	std::this_thread::sleep_for(std::chrono::milliseconds(200u));
+	{
+		futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+		flag = true;
+	}
+	cond.notify_all();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(increment_variable, 32);
+}
@@ -0,0 +1,217 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_latch.hpp"
+#include "../include/futex_event.hpp"
+#include "../include/futex_once.hpp"
+
+TEST(latch_inprocess, start_gate) {
+	std::cout << "==========futex latch start gate test=======\n";
+	const std::uint32_t workers = 8u;
+	futex_latch< shared_policy::inprocess > ready(workers), start(1u);
+	std::atomic< std::uint32_t > started{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < workers; ++id)
+	{
+		threads.emplace_back([&]() {
+			ready.count_down();
+			start.wait();
+			++started;
+		});
+	}
+	ready.wait();
+	EXPECT_TRUE(ready.try_wait());
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(started, 0u);
+	EXPECT_FALSE(start.try_wait());
+	start.count_down();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(started, workers);
+
+	futex_latch< shared_policy::inprocess > latch(2u);
+	EXPECT_FALSE(latch.wait_for(std::chrono::milliseconds(20)));
+	EXPECT_THROW(latch.count_down(3u), futex_base_exception);
+	latch.count_down(2u);
+	EXPECT_TRUE(latch.wait_until(std::chrono::steady_clock::now()));
+	EXPECT_EQ(latch.count(), 0u);
+}
+
+TEST(latch_inprocess, arrive_and_wait) {
+	std::cout << "==========futex latch arrive and wait test=======\n";
+	futex_latch< shared_policy::inprocess > latch(4u);
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 3u; ++id)
+		threads.emplace_back([&]() { latch.arrive_and_wait(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(latch.count(), 1u);
+	latch.arrive_and_wait();
+	for (auto&& thread : threads)
+		thread.join();
+}
+
+TEST(event_inprocess, manual_reset) {
+	std::cout << "==========futex manual reset event test=======\n";
+	futex_event< shared_policy::inprocess > event;
+	std::atomic< std::uint32_t > released{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 4u; ++id)
+	{
+		threads.emplace_back([&]() {
+			event.wait();
+			++released;
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(released, 0u);
+	event.set();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(released, 4u);
+	// stays signaled
+	EXPECT_TRUE(event.is_set());
+	EXPECT_TRUE(event.try_wait());
+	event.reset();
+	EXPECT_FALSE(event.try_wait());
+	EXPECT_FALSE(event.wait_for(std::chrono::milliseconds(20)));
+}
+
+TEST(event_inprocess, auto_reset) {
+	std::cout << "==========futex auto reset event test=======\n";
+	futex_event< shared_policy::inprocess, futex_event_reset::automatic > event;
+	const std::uint32_t waiters = 4u;
+	std::atomic< std::uint32_t > released{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < waiters; ++id)
+	{
+		threads.emplace_back([&]() {
+			event.wait();
+			++released;
+		});
+	}
+	// every set releases exactly one waiter
+	for (std::uint32_t round = 1; round <= waiters; ++round)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		event.set();
+		while (released < round)
+			std::this_thread::yield();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(released, round);
+		EXPECT_FALSE(event.is_set());
+	}
+	for (auto&& thread : threads)
+		thread.join();
+
+	futex_event< shared_policy::inprocess, futex_event_reset::automatic > signaled(true);
+	EXPECT_TRUE(signaled.try_wait());
+	EXPECT_FALSE(signaled.try_wait());
+	EXPECT_FALSE(signaled.wait_for(std::chrono::milliseconds(20)));
+}
+
+TEST(event_inprocess, auto_reset_pingpong) {
+	std::cout << "==========futex auto reset event ping-pong test=======\n";
+	futex_event< shared_policy::inprocess, futex_event_reset::automatic > ping, pong;
+	const std::uint32_t rounds = 10000u;
+	std::uint32_t value{0u};
+	std::thread other([&]() {
+		for (std::uint32_t round = 0; round < rounds; ++round)
+		{
+			ping.wait();
+			++value;
+			pong.set();
+		}
+	});
+	for (std::uint32_t round = 0; round < rounds; ++round)
+	{
+		ping.set();
+		pong.wait();
+		EXPECT_EQ(value, round + 1u);
+	}
+	other.join();
+}
+
+TEST(once_inprocess, call_once) {
+	std::cout << "==========futex once test=======\n";
+	futex_once< shared_policy::inprocess > once;
+	std::atomic< std::uint32_t > calls{0u}, finished{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 8u; ++id)
+	{
+		threads.emplace_back([&]() {
+			futex_call_once(once, [&](std::uint32_t add) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				calls += add;
+			}, 1u);
+			// the call completed before anybody returns
+			EXPECT_EQ(calls, 1u);
+			++finished;
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(finished, 8u);
+	EXPECT_TRUE(once.is_done());
+}
+
+TEST(once_inprocess, exception_retries) {
+	std::cout << "==========futex once exception test=======\n";
+	futex_once< shared_policy::inprocess > once;
+	std::uint32_t attempts{0u};
+	EXPECT_THROW(once.call([&]() { ++attempts; throw std::runtime_error("failed"); }), std::runtime_error);
+	EXPECT_FALSE(once.is_done());
+	once.call([&]() { ++attempts; });
+	once.call([&]() { ++attempts; });
+	EXPECT_EQ(attempts, 2u);
+	EXPECT_TRUE(once.is_done());
+}
+
+TEST(latch_event_once_interprocess, forked_workers) {
+	std::cout << "==========futex latch, event and once interprocess test=======\n";
+	struct shared_data
+	{
+		futex_latch< shared_policy::interprocess > ready{3u};
+		futex_event< shared_policy::interprocess > go;
+		futex_once< shared_policy::interprocess > once;
+		std::atomic< std::uint32_t > initialized{0u};
+		std::atomic< std::uint32_t > passed{0u};
+	};
+	void* addr = ::mmap(nullptr, sizeof(shared_data), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	shared_data* data = new (addr) shared_data;
+
+	std::vector< int > children;
+	for (std::uint32_t worker = 0; worker < 3u; ++worker)
+	{
+		int forkstatus = ::fork();
+		ASSERT_GE(forkstatus, 0);
+		if (forkstatus == 0)
+		{
+			data->once.call([data]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				data->initialized.fetch_add(1u);
+			});
+			data->ready.count_down();
+			data->go.wait();
+			data->passed.fetch_add(1u);
+			::_exit(0);
+		}
+		children.push_back(forkstatus);
+	}
+	data->ready.wait();
+	EXPECT_EQ(data->initialized.load(), 1u);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(data->passed.load(), 0u);
+	data->go.set();
+	for (int child : children)
+		::waitpid(child, nullptr, 0);
+	EXPECT_EQ(data->passed.load(), 3u);
+	::munmap(addr, sizeof(shared_data));
+}
@@ -0,0 +1,134 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <type_traits>
+
+#include <gtest/gtest.h>
+#include "../include/futex_lock_array.hpp"
+
+TEST(lock_array_inprocess, layout_and_index) {
+	std::cout << "==========futex lock array layout test=======\n";
+	using aligned_t = futex_lock_array< shared_policy::inprocess, 16u >;
+	using packed_t = futex_lock_array< shared_policy::inprocess, 16u, futex_layout::packed >;
+	static_assert(sizeof(aligned_t) == 16u * futex_cache_line_size, "one cache line per stripe");
+	static_assert(sizeof(packed_t) == 16u * sizeof(std::uint32_t), "one futex word per stripe");
+	static_assert(std::is_same< futex_lock_array< shared_policy::inprocess, 4u, futex_layout::packed, no_spin_backoff >::mutex_t,
+		futex_mutex< shared_policy::inprocess, true, no_spin_backoff, futex_layout::packed > >::value, "stripes spin by the backoff");
+
+	// sequential integer keys spread over the stripes
+	std::array< std::uint32_t, 16u > hits{};
+	for (std::uint32_t key = 0; key < 1600u; ++key)
+	{
+		const std::size_t index = aligned_t::index_of(key);
+		ASSERT_LT(index, aligned_t::size());
+		++hits[index];
+	}
+	for (std::uint32_t count : hits)
+		EXPECT_GT(count, 50u);
+
+	// odd stripe count
+	for (std::uint32_t key = 0; key < 100u; ++key)
+		EXPECT_LT((futex_lock_array< shared_policy::inprocess, 7u >::index_of(key)), 7u);
+	EXPECT_EQ(aligned_t::index_of(std::string("row")), aligned_t::index_of(std::string("row")));
+}
+
+TEST(lock_array_inprocess, ordered_transfers) {
+	std::cout << "==========futex lock array transfers test=======\n";
+	futex_lock_array< shared_policy::inprocess, 8u > locks;
+	std::array< std::int64_t, 64u > accounts{};
+	const std::uint32_t max = 20000u;
+
+	// opposite lock orders deadlock without the stripe ordering
+	auto transfer = [&locks, &accounts, max](std::uint32_t seed) {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			const std::size_t from = (seed + cc) % accounts.size();
+			const std::size_t to = (seed * 7u + cc * 3u) % accounts.size();
+			futex_lock_array_guard guard(locks, from, to);
+			--accounts[from];
+			++accounts[to];
+		}
+	};
+	std::array< std::thread, 8 > threads;
+	std::uint32_t seed{0u};
+	for (auto&& thread : threads)
+		thread = std::thread(transfer, ++seed);
+	for (auto&& thread : threads)
+		thread.join();
+
+	std::int64_t total{0};
+	for (std::int64_t balance : accounts)
+		total += balance;
+	EXPECT_EQ(total, 0);
+
+	// keys in one stripe lock it once
+	const std::size_t key{5u};
+	futex_lock_array_guard guard(locks, key, key);
+	EXPECT_EQ(guard.locked(), 1u);
+	EXPECT_FALSE(locks[key].try_lock());
+}
+
+TEST(lock_array_inprocess, try_lock_ordered) {
+	std::cout << "==========futex lock array try lock test=======\n";
+	using locks_t = futex_lock_array< shared_policy::inprocess, 4u, futex_layout::packed >;
+	locks_t locks;
+	std::array< std::size_t, 3u > indices{{ 3u, 1u, 2u }};
+	locks.stripe(2u).lock();
+
+	std::size_t distinct{0u};
+	EXPECT_FALSE(locks.try_lock_ordered(indices, distinct));
+	// nothing stays locked on failure
+	EXPECT_TRUE(locks.stripe(1u).try_lock());
+	locks.stripe(1u).unlock();
+	locks.stripe(2u).unlock();
+
+	EXPECT_TRUE(locks.try_lock_ordered(indices, distinct));
+	EXPECT_EQ(distinct, 3u);
+	EXPECT_EQ(indices[0], 1u);
+	locks.unlock_ordered(indices, distinct);
+	EXPECT_TRUE(locks.stripe(3u).try_lock());
+	locks.stripe(3u).unlock();
+}
+
+TEST(lock_array_interprocess, shared_memory) {
+	std::cout << "==========futex lock array interprocess test=======\n";
+	using locks_t = futex_lock_array< shared_policy::interprocess, 32u >;
+	struct table
+	{
+		locks_t locks;
+		std::array< std::uint32_t, 256u > rows{};
+	};
+	const std::uint32_t max = 10000u;
+	void* addr = ::mmap(nullptr, sizeof(table), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	table* data = new (addr) table;
+
+	auto writer = [data, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			const std::uint32_t row = cc % data->rows.size();
+			futex_mutex_lock_guard< locks_t::mutex_t > lock(data->locks[row]);
+			++data->rows[row];
+		}
+	};
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		writer();
+		::_exit(0);
+	}
+	writer();
+	::waitpid(forkstatus, nullptr, 0);
+
+	std::uint32_t total{0u};
+	for (std::uint32_t value : data->rows)
+		total += value;
+	EXPECT_EQ(total, 2u * max);
+	::munmap(addr, sizeof(table));
+}
@@ -0,0 +1,172 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mpmc_queue.hpp"
+
+TEST(mpmc_queue_inprocess, try_push_pop) {
+	std::cout << "==========futex mpmc queue try push/pop test=======\n";
+	futex_mpmc_queue< shared_policy::inprocess, std::uint32_t, 4u > queue;
+	std::uint32_t item{0u};
+	EXPECT_FALSE(queue.try_pop(item));
+	for (std::uint32_t cc = 0; cc < 4u; ++cc)
+		EXPECT_TRUE(queue.try_push(cc));
+	EXPECT_FALSE(queue.try_push(4u));
+	EXPECT_EQ(queue.size_approx(), 4u);
+	// FIFO over several laps
+	for (std::uint32_t cc = 0; cc < 10u; ++cc)
+	{
+		ASSERT_TRUE(queue.try_pop(item));
+		EXPECT_EQ(item, cc);
+		EXPECT_TRUE(queue.try_push(cc + 4u));
+	}
+	EXPECT_FALSE(queue.push_for(100u, std::chrono::milliseconds(20)));
+}
+
+TEST(mpmc_queue_inprocess, timeouts) {
+	std::cout << "==========futex mpmc queue timeout test=======\n";
+	futex_mpmc_queue< shared_policy::inprocess, std::uint32_t, 2u > queue;
+	std::uint32_t item{0u};
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(queue.pop_for(item, std::chrono::milliseconds(50)));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+	queue.push(1u);
+	queue.push(2u);
+	EXPECT_FALSE(queue.push_for(3u, std::chrono::milliseconds(50)));
+	EXPECT_TRUE(queue.pop_for(item, std::chrono::milliseconds(50)));
+	EXPECT_EQ(item, 1u);
+}
+
+TEST(mpmc_queue_inprocess, move_only_items) {
+	std::cout << "==========futex mpmc queue move-only test=======\n";
+	futex_mpmc_queue< shared_policy::inprocess, std::unique_ptr< std::uint32_t >, 8u > queue;
+	queue.push(std::make_unique< std::uint32_t >(7u));
+	queue.push(std::make_unique< std::uint32_t >(8u));
+	std::unique_ptr< std::uint32_t > item;
+	queue.pop(item);
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 7u);
+	// the destructor frees the item left in the queue
+}
+
+TEST(mpmc_queue_inprocess, producers_consumers) {
+	std::cout << "==========futex mpmc queue producers/consumers test=======\n";
+	futex_mpmc_queue< shared_policy::inprocess, std::uint64_t, 64u > queue;
+	const std::uint32_t producers = 4u, consumers = 4u;
+	const std::uint64_t items = 50000u;
+	std::atomic< std::uint64_t > sum{0u}, count{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < consumers; ++id)
+	{
+		threads.emplace_back([&]() {
+			for (;;)
+			{
+				std::uint64_t item{0u};
+				queue.pop(item);
+				// zero stops the consumer
+				if (!item)
+					return;
+				sum += item;
+				++count;
+			}
+		});
+	}
+	std::vector< std::thread > pushers;
+	for (std::uint32_t id = 0; id < producers; ++id)
+	{
+		pushers.emplace_back([&, id]() {
+			for (std::uint64_t item = 1u + id; item <= items * producers; item += producers)
+				queue.push(item);
+		});
+	}
+	for (auto&& thread : pushers)
+		thread.join();
+	for (std::uint32_t id = 0; id < consumers; ++id)
+		queue.push(std::uint64_t{0u});
+	for (auto&& thread : threads)
+		thread.join();
+	const std::uint64_t total = items * producers;
+	EXPECT_EQ(count, total);
+	EXPECT_EQ(sum, total * (total + 1u) / 2u);
+}
+
+TEST(mpmc_queue_inprocess, batches) {
+	std::cout << "==========futex mpmc queue batch test=======\n";
+	futex_mpmc_queue< shared_policy::inprocess, std::uint32_t, 16u > queue;
+	std::uint32_t input[40], output[40];
+	for (std::uint32_t cc = 0; cc < 40u; ++cc)
+		input[cc] = cc;
+	EXPECT_EQ(queue.try_push_batch(input, 40u), 16u);
+	EXPECT_EQ(queue.try_pop_batch(output, 10u), 10u);
+	for (std::uint32_t cc = 0; cc < 10u; ++cc)
+		EXPECT_EQ(output[cc], cc);
+	EXPECT_EQ(queue.try_pop_batch(output, 40u), 6u);
+	EXPECT_EQ(queue.try_pop_batch(output, 40u), 0u);
+
+	// a blocking batch larger than the queue goes through in parts
+	std::uint64_t sum{0u};
+	std::thread consumer([&]() {
+		std::uint32_t received{0u}, buffer[8];
+		while (received < 40u)
+		{
+			const std::size_t popped = queue.pop_batch(buffer, 8u);
+			for (std::size_t index = 0; index < popped; ++index)
+			{
+				EXPECT_EQ(buffer[index], received + index);
+				sum += buffer[index];
+			}
+			received += popped;
+		}
+	});
+	queue.push_batch(input, 40u);
+	consumer.join();
+	EXPECT_EQ(sum, 40u * 39u / 2u);
+}
+
+TEST(mpmc_queue_interprocess, forked_producers) {
+	std::cout << "==========futex mpmc queue interprocess test=======\n";
+	using queue_t = futex_mpmc_queue< shared_policy::interprocess, std::uint64_t, 32u >;
+	void* addr = ::mmap(nullptr, sizeof(queue_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	queue_t* queue = new (addr) queue_t;
+
+	const std::uint32_t producers = 3u;
+	const std::uint64_t items = 10000u;
+	std::vector< int > children;
+	for (std::uint32_t id = 0; id < producers; ++id)
+	{
+		int forkstatus = ::fork();
+		ASSERT_GE(forkstatus, 0);
+		if (forkstatus == 0)
+		{
+			std::uint64_t batch[4];
+			for (std::uint64_t item = 0; item < items; item += 4u)
+			{
+				for (std::uint64_t index = 0; index < 4u; ++index)
+					batch[index] = item + index + 1u;
+				queue->push_batch(batch, 4u);
+			}
+			::_exit(0);
+		}
+		children.push_back(forkstatus);
+	}
+	std::uint64_t sum{0u}, count{0u};
+	while (count < producers * items)
+	{
+		std::uint64_t item{0u};
+		queue->pop(item);
+		sum += item;
+		++count;
+	}
+	for (int child : children)
+		::waitpid(child, nullptr, 0);
+	EXPECT_EQ(sum, producers * items * (items + 1u) / 2u);
+	queue->~queue_t();
+	::munmap(addr, sizeof(queue_t));
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <chrono>
 #include <cmath>
+#include <mutex>
 
 #include <gtest/gtest.h>
 #include "../include/futex_mutex.hpp"
@@ -57,3 +58,42 @@ TEST(mutex_inprocess, without_spinlock) {
 	//result: 2560000
 	GTEST_CHECK_(std::fabs(a - 256 * max) < std::numeric_limits< double >::epsilon());
 }
+
+TEST(mutex_inprocess, try_lock) {
+	std::cout << "==========futex mutex try_lock test=======\n";
+	futex_mutex< shared_policy::inprocess > mutex;
+	EXPECT_TRUE(mutex.try_lock());
+	EXPECT_FALSE(mutex.try_lock());
+	std::thread([&mutex]() { EXPECT_FALSE(mutex.try_lock()); }).join();
+	mutex.unlock();
+	std::thread([&mutex]() { EXPECT_TRUE(mutex.try_lock()); mutex.unlock(); }).join();
+
+	// works with standard lock utilities
+	futex_mutex< shared_policy::inprocess > other;
+	std::lock(mutex, other);
+	mutex.unlock();
+	other.unlock();
+	std::unique_lock< decltype(mutex) > lock(mutex, std::try_to_lock);
+	EXPECT_TRUE(lock.owns_lock());
+}
+
+TEST(mutex_inprocess, try_lock_for) {
+	std::cout << "==========futex mutex timed lock test=======\n";
+	futex_mutex< shared_policy::inprocess, true > mutex;
+	mutex.lock();
+	std::thread waiter([&mutex]() {
+		auto start = std::chrono::steady_clock::now();
+		EXPECT_FALSE(mutex.try_lock_for(std::chrono::milliseconds(200)));
+		EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+		EXPECT_FALSE(mutex.try_lock_until(std::chrono::system_clock::now() + std::chrono::milliseconds(50)));
+		// owner unlocks in time
+		EXPECT_TRUE(mutex.try_lock_until(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	mutex.unlock();
+	waiter.join();
+
+	std::unique_lock< decltype(mutex) > lock(mutex, std::chrono::milliseconds(10));
+	EXPECT_TRUE(lock.owns_lock());
+}
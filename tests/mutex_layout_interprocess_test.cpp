@@ -0,0 +1,49 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <new>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mutex.hpp"
+
+TEST(mutex_layout_interprocess, packed_array) {
+	std::cout << "=======interprocess packed mutex array test========\n";
+	using mutex_t = futex_mutex< shared_policy::interprocess, false, default_backoff, futex_layout::packed >;
+	struct record
+	{
+		mutex_t mutex;
+		std::uint32_t value = 0u;
+	};
+	static_assert(sizeof(record) == 2 * sizeof(std::uint32_t), "record lock must take the futex word only");
+
+	const std::size_t records = 64u;
+	const std::uint32_t max = 64u * 32u;
+	void* addr = ::mmap(nullptr, records * sizeof(record), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	record* data = new (addr) record[records];
+
+	auto writer = [data, records, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			record& rec = data[cc % records];
+			futex_mutex_lock_guard< mutex_t > lock(rec.mutex);
+			++rec.value;
+		}
+	};
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		writer();
+		::_exit(0);
+	}
+	writer();
+	::waitpid(forkstatus, nullptr, 0);
+
+	for (std::size_t index = 0; index < records; ++index)
+		EXPECT_EQ(data[index].value, 2u * max / records);
+	::munmap(addr, records * sizeof(record));
+}
@@ -0,0 +1,217 @@
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_byte_mutex.hpp"
+#include "../include/futex_byte_condition_variable.hpp"
+
+TEST(parking_lot, park_and_unpark) {
+	std::cout << "==========futex parking lot test=======\n";
+	int address = 0;
+	// validate false: no sleep
+	EXPECT_EQ(futex_parking_lot::park(&address, []() { return false; }, []() {}, [](bool) {}).status, futex_park_status::invalid);
+
+	const futex_deadline deadline = make_futex_deadline(std::chrono::milliseconds(20));
+	bool timed_out = false;
+	EXPECT_EQ(futex_parking_lot::park(&address, []() { return true; }, []() {},
+		[&](bool more_parked) { timed_out = true; EXPECT_FALSE(more_parked); }, &deadline).status, futex_park_status::timed_out);
+	EXPECT_TRUE(timed_out);
+	EXPECT_EQ(futex_parking_lot::unpark_all(&address), 0u);
+
+	std::atomic< std::uint32_t > parked{0u};
+	std::vector< std::thread > threads;
+	for (std::intptr_t id = 0; id < 3; ++id)
+	{
+		threads.emplace_back([&]() {
+			const futex_park_result res = futex_parking_lot::park(&address, []() { return true; }, [&]() { ++parked; }, [](bool) {});
+			EXPECT_EQ(res.status, futex_park_status::unparked);
+		});
+	}
+	while (parked < 3u)
+		std::this_thread::yield();
+
+	bool called = false;
+	futex_parking_lot::unpark_one(&address, [&](const futex_unpark_result& res) -> std::intptr_t {
+		called = true;
+		EXPECT_TRUE(res.unparked);
+		EXPECT_TRUE(res.more_parked);
+		return 7;
+	});
+	EXPECT_TRUE(called);
+	while (futex_parking_lot::unpark_all(&address) < 2u)
+		std::this_thread::yield();
+	for (auto&& thread : threads)
+		thread.join();
+}
+
+TEST(byte_mutex, counter) {
+	std::cout << "==========futex byte mutex counter test=======\n";
+	futex_byte_mutex<> mutex;
+	std::uint64_t counter{0u};
+	const std::uint32_t threads_count = 8u, iterations = 100000u;
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < threads_count; ++id)
+	{
+		threads.emplace_back([&]() {
+			for (std::uint32_t cc = 0; cc < iterations; ++cc)
+			{
+				futex_mutex_lock_guard< futex_byte_mutex<> > lock(mutex);
+				++counter;
+			}
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(counter, threads_count * iterations);
+	EXPECT_FALSE(mutex.is_locked());
+}
+
+TEST(byte_mutex, packed_array) {
+	std::cout << "==========futex byte mutex array test=======\n";
+	// neighbouring bytes are independent locks sharing the parking lot buckets
+	const std::uint32_t locks = 64u;
+	futex_byte_mutex<> mutexes[locks];
+	std::uint32_t counters[locks] = {};
+	static_assert(sizeof(mutexes) == locks, "one byte per mutex");
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 4u; ++id)
+	{
+		threads.emplace_back([&, id]() {
+			for (std::uint32_t cc = 0; cc < 50000u; ++cc)
+			{
+				const std::uint32_t index = (cc * 7u + id) % locks;
+				mutexes[index].lock();
+				++counters[index];
+				mutexes[index].unlock();
+			}
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	std::uint32_t total{0u};
+	for (std::uint32_t counter : counters)
+		total += counter;
+	EXPECT_EQ(total, 4u * 50000u);
+}
+
+TEST(byte_mutex, timed_lock) {
+	std::cout << "==========futex byte mutex timed lock test=======\n";
+	futex_byte_mutex<> mutex;
+	mutex.lock();
+	std::thread other([&]() {
+		EXPECT_FALSE(mutex.try_lock());
+		EXPECT_FALSE(mutex.try_lock_for(std::chrono::milliseconds(20)));
+		// the only parked thread timed out: the parked bit is gone with it
+		EXPECT_TRUE(mutex.is_locked());
+		EXPECT_FALSE(mutex.has_parked());
+		EXPECT_TRUE(mutex.try_lock_until(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	mutex.unlock();
+	other.join();
+	EXPECT_FALSE(mutex.is_locked());
+}
+
+TEST(byte_mutex, eventual_fairness) {
+	std::cout << "==========futex byte mutex fairness test=======\n";
+	futex_byte_mutex<> mutex;
+	std::atomic< bool > stop{false};
+	std::atomic< std::uint32_t > acquired{0u};
+	// the barging thread relocks at once, the parked one gets the lock by a handoff
+	std::thread greedy([&]() {
+		while (!stop)
+		{
+			mutex.lock();
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			mutex.unlock();
+		}
+	});
+	std::thread parked([&]() {
+		for (std::uint32_t cc = 0; cc < 5u; ++cc)
+		{
+			mutex.lock();
+			++acquired;
+			mutex.unlock();
+		}
+	});
+	parked.join();
+	stop = true;
+	greedy.join();
+	EXPECT_EQ(acquired, 5u);
+}
+
+TEST(byte_condition_variable, producer_consumer) {
+	std::cout << "==========futex byte condition variable test=======\n";
+	using lock_t = futex_mutex_unique_lock< futex_byte_mutex<> >;
+	futex_byte_mutex<> mutex;
+	futex_byte_condition_variable not_empty, not_full;
+	std::deque< std::uint32_t > queue;
+	const std::uint32_t items = 20000u, capacity = 4u, consumers = 3u;
+	std::atomic< std::uint64_t > sum{0u};
+
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < consumers; ++id)
+	{
+		threads.emplace_back([&]() {
+			for (;;)
+			{
+				lock_t lock(mutex);
+				not_empty.wait(lock, [&]() { return !queue.empty(); });
+				const std::uint32_t item = queue.front();
+				queue.pop_front();
+				lock.unlock();
+				not_full.notify_one();
+				if (!item)
+					return;
+				sum += item;
+			}
+		});
+	}
+	for (std::uint32_t item = 1; item <= items + consumers; ++item)
+	{
+		lock_t lock(mutex);
+		not_full.wait(lock, [&]() { return queue.size() < capacity; });
+		// zeros stop the consumers
+		queue.push_back(item <= items ? item : 0u);
+		lock.unlock();
+		not_empty.notify_one();
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(sum, static_cast< std::uint64_t >(items) * (items + 1u) / 2u);
+}
+
+TEST(byte_condition_variable, notify_all_and_timeout) {
+	std::cout << "==========futex byte condition variable notify_all test=======\n";
+	futex_byte_mutex<> mutex;
+	futex_byte_condition_variable cond;
+	bool ready = false;
+	std::atomic< std::uint32_t > woken{0u};
+	std::vector< std::thread > threads;
+	for (std::uint32_t id = 0; id < 4u; ++id)
+	{
+		threads.emplace_back([&]() {
+			std::unique_lock< futex_byte_mutex<> > lock(mutex);
+			cond.wait(lock, [&]() { return ready; });
+			++woken;
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	{
+		std::unique_lock< futex_byte_mutex<> > lock(mutex);
+		ready = true;
+	}
+	cond.notify_all();
+	for (auto&& thread : threads)
+		thread.join();
+	EXPECT_EQ(woken, 4u);
+
+	std::unique_lock< futex_byte_mutex<> > lock(mutex);
+	EXPECT_EQ(cond.wait_for(lock, std::chrono::milliseconds(20)), futex_cv_status::timeout);
+	EXPECT_FALSE(cond.wait_for(lock, std::chrono::milliseconds(20), []() { return false; }));
+	EXPECT_TRUE(lock.owns_lock());
+}
@@ -0,0 +1,89 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mutex.hpp"
+#include "../include/futex_pi_mutex.hpp"
+
+TEST(pi_mutex_inprocess, increment) {
+	std::cout << "==========futex pi mutex test with increment=======\n";
+	futex_pi_mutex< shared_policy::inprocess > mutex;
+	double a = 0;
+	const std::uint32_t max = 10000u;
+	auto writer = [&mutex, &a, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+			++a;
+		}
+	};
+	std::array< std::thread, 16 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(writer);
+	for (auto&& thread : threads)
+		thread.join();
+	GTEST_CHECK_(std::fabs(a - 16 * max) < std::numeric_limits< double >::epsilon());
+	EXPECT_EQ(mutex.owner(), 0);
+}
+
+TEST(pi_mutex_inprocess, owner_and_try_lock) {
+	std::cout << "==========futex pi mutex owner test=======\n";
+	futex_pi_mutex< shared_policy::inprocess > mutex;
+	mutex.lock();
+	EXPECT_EQ(mutex.owner(), static_cast< pid_t >(::syscall(SYS_gettid)));
+	EXPECT_THROW(mutex.try_lock_for(std::chrono::milliseconds(10)), futex_scoped_error);
+
+	std::thread([&mutex]() {
+		EXPECT_FALSE(mutex.try_lock());
+		auto start = std::chrono::steady_clock::now();
+		EXPECT_FALSE(mutex.try_lock_for(std::chrono::milliseconds(100)));
+		EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+	}).join();
+
+	// contended unlock hands the mutex over through the kernel
+	std::thread waiter([&mutex]() {
+		EXPECT_TRUE(mutex.try_lock_until(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+		EXPECT_EQ(mutex.owner(), static_cast< pid_t >(::syscall(SYS_gettid)));
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	mutex.unlock();
+	waiter.join();
+	EXPECT_EQ(mutex.owner(), 0);
+}
+
+TEST(pi_mutex_interprocess, lock_from_child) {
+	std::cout << "==========futex pi mutex interprocess test=======\n";
+	struct shared_buffer
+	{
+		futex_pi_mutex< shared_policy::interprocess > mutex;
+		bool flag = false;
+	};
+	void* addr = ::mmap(nullptr, sizeof(shared_buffer), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	auto* data = new (addr) shared_buffer;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		data->mutex.lock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		data->flag = true;
+		data->mutex.unlock();
+		::_exit(0);
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_NE(data->mutex.owner(), 0);
+	EXPECT_TRUE(data->mutex.try_lock_for(std::chrono::seconds(5)));
+	EXPECT_TRUE(data->flag);
+	data->mutex.unlock();
+	::waitpid(forkstatus, nullptr, 0);
+	::munmap(addr, sizeof(shared_buffer));
+}
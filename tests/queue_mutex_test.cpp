@@ -0,0 +1,90 @@
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mutex.hpp"
+#include "../include/futex_queue_mutex.hpp"
+
+TEST(queue_mutex_inprocess, increment) {
+	std::cout << "==========futex queue mutex test with increment=======\n";
+	futex_queue_mutex< shared_policy::inprocess > mutex;
+	double a = 0;
+	const std::uint32_t max = 10000u;
+	auto writer = [&mutex, &a, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+			++a;
+		}
+	};
+	std::array< std::thread, 16 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(writer);
+	for (auto&& thread : threads)
+		thread.join();
+	GTEST_CHECK_(std::fabs(a - 16 * max) < std::numeric_limits< double >::epsilon());
+}
+
+TEST(queue_mutex_inprocess, fifo_handoff) {
+	std::cout << "==========futex queue mutex fifo test=======\n";
+	futex_queue_mutex< shared_policy::inprocess > mutex;
+	std::vector< std::uint32_t > order;
+	std::vector< std::thread > threads;
+
+	mutex.lock();
+	for (std::uint32_t id = 0; id < 8u; ++id)
+	{
+		threads.emplace_back([&mutex, &order, id]() {
+			futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+			order.push_back(id);
+		});
+		// the thread is queued before the next one starts
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	mutex.unlock();
+	for (auto&& thread : threads)
+		thread.join();
+
+	ASSERT_EQ(order.size(), 8u);
+	for (std::uint32_t id = 0; id < 8u; ++id)
+		EXPECT_EQ(order[id], id);
+}
+
+TEST(queue_mutex_inprocess, try_lock_and_timeout) {
+	std::cout << "==========futex queue mutex timeout test=======\n";
+	futex_queue_mutex< shared_policy::inprocess > mutex;
+	EXPECT_TRUE(mutex.try_lock());
+
+	std::thread([&mutex]() {
+		EXPECT_FALSE(mutex.try_lock());
+		// abandoned node at the tail of the queue
+		auto start = std::chrono::steady_clock::now();
+		EXPECT_FALSE(mutex.try_lock_for(std::chrono::milliseconds(50)));
+		EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(45));
+	}).join();
+	mutex.unlock();
+
+	// abandoned node in the middle of the queue
+	mutex.lock();
+	std::thread timed([&mutex]() {
+		EXPECT_FALSE(mutex.try_lock_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+		// the node stays abandoned until the unlock skips it, a new one is used
+		EXPECT_TRUE(mutex.try_lock_for(std::chrono::seconds(5)));
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::thread waiter([&mutex]() {
+		mutex.lock();
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	mutex.unlock();
+	timed.join();
+	waiter.join();
+
+	EXPECT_TRUE(mutex.try_lock());
+	mutex.unlock();
+}
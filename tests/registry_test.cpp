@@ -0,0 +1,187 @@
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "../include/futex_registry.hpp"
+
+namespace
+{
+
+//! Unique segment per test run, removed at the end of the test
+struct registry_segment
+{
+	registry_segment() : name("/futex_registry_test_" + std::to_string(::getpid())) { futex_registry::remove(name.c_str()); }
+	~registry_segment() { futex_registry::remove(name.c_str()); }
+	std::string name;
+};
+
+const futex_registry_record* find(const std::vector< futex_registry_record >& records, const std::string& name)
+{
+	for (const futex_registry_record& record : records)
+	{
+		if (record.name == name)
+			return &record;
+	}
+	return nullptr;
+}
+
+} // namespace
+
+TEST(registry, publish_and_view) {
+	std::cout << "==========futex registry publish test=======\n";
+	registry_segment segment;
+	using mutex_t = futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats >;
+	mutex_t mutex;
+	futex_condition_variable< shared_policy::inprocess, futex_contention_stats > cond;
+	futex_counting_semaphore< shared_policy::inprocess, futex_contention_stats > sem;
+
+	futex_registry registry(segment.name.c_str(), 8u);
+	futex_registry_view view(segment.name.c_str());
+	{
+		auto mutex_registration = registry.add("orders", mutex);
+		auto cond_registration = registry.add("orders_ready", cond);
+		auto sem_registration = registry.add("free_slots", sem);
+		EXPECT_TRUE(mutex_registration);
+
+		for (std::uint32_t cc = 0; cc < 10u; ++cc)
+			futex_mutex_lock_guard< mutex_t > lock(mutex);
+		sem.post(3u);
+		EXPECT_TRUE(sem.try_wait());
+
+		// nothing is published before publish()
+		std::vector< futex_registry_record > records = view.read();
+		ASSERT_EQ(records.size(), 3u);
+		ASSERT_NE(find(records, "orders"), nullptr);
+		EXPECT_EQ(find(records, "orders")->stats.acquisitions, 0u);
+
+		const std::uint64_t generation = view.generation();
+		registry.publish();
+		EXPECT_GT(view.generation(), generation);
+		records = view.read();
+		const futex_registry_record* record = find(records, "orders");
+		ASSERT_NE(record, nullptr);
+		EXPECT_EQ(record->pid, ::getpid());
+		EXPECT_EQ(record->kind, futex_registry_kind::mutex);
+		EXPECT_EQ(record->stats.acquisitions, 10u);
+		ASSERT_NE(find(records, "orders_ready"), nullptr);
+		EXPECT_EQ(find(records, "orders_ready")->kind, futex_registry_kind::condition_variable);
+		ASSERT_NE(find(records, "free_slots"), nullptr);
+		EXPECT_EQ(find(records, "free_slots")->kind, futex_registry_kind::semaphore);
+		EXPECT_EQ(find(records, "free_slots")->stats.acquisitions, 1u);
+
+		// the background publisher
+		registry.start_publisher(std::chrono::milliseconds(10));
+		for (std::uint32_t cc = 0; cc < 5u; ++cc)
+			futex_mutex_lock_guard< mutex_t > lock(mutex);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		registry.stop_publisher();
+		EXPECT_EQ(find(view.read(), "orders")->stats.acquisitions, 15u);
+	}
+	// the registrations are gone, their slots are free
+	EXPECT_TRUE(view.read().empty());
+}
+
+TEST(registry, processes_share_segment) {
+	std::cout << "==========futex registry interprocess test=======\n";
+	registry_segment segment;
+	using mutex_t = futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats >;
+	futex_registry registry(segment.name.c_str(), 4u);
+	mutex_t mutex;
+	auto registration = registry.add("parent", mutex);
+
+	int pipefd[2];
+	ASSERT_EQ(::pipe(pipefd), 0);
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		// the child opens the existing segment and registers its own lock
+		::close(pipefd[0]);
+		{
+			futex_registry child_registry(segment.name.c_str());
+			mutex_t child_mutex;
+			auto child_registration = child_registry.add("child", child_mutex);
+			child_mutex.lock();
+			child_mutex.unlock();
+			child_registry.publish();
+			char ready = 1;
+			(void)!::write(pipefd[1], &ready, 1);
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		::_exit(0);
+	}
+	::close(pipefd[1]);
+	char ready = 0;
+	ASSERT_EQ(::read(pipefd[0], &ready, 1), 1);
+	::close(pipefd[0]);
+
+	futex_registry_view view(segment.name.c_str());
+	std::vector< futex_registry_record > records = view.read();
+	ASSERT_EQ(records.size(), 2u);
+	const futex_registry_record* child = find(records, "child");
+	ASSERT_NE(child, nullptr);
+	EXPECT_EQ(child->pid, forkstatus);
+	EXPECT_EQ(child->stats.acquisitions, 1u);
+	::waitpid(forkstatus, nullptr, 0);
+	EXPECT_EQ(view.read().size(), 1u);
+}
+
+TEST(registry, dead_process_slot_reused) {
+	std::cout << "==========futex registry dead process test=======\n";
+	registry_segment segment;
+	using mutex_t = futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats >;
+	{
+		futex_registry registry(segment.name.c_str(), 1u);
+		mutex_t mutex;
+
+		int forkstatus = ::fork();
+		ASSERT_GE(forkstatus, 0);
+		if (forkstatus == 0)
+		{
+			// killed with the registration alive: the slot stays active
+			futex_registry child_registry(segment.name.c_str());
+			mutex_t child_mutex;
+			auto child_registration = child_registry.add("leaked", child_mutex);
+			::raise(SIGKILL);
+		}
+		::waitpid(forkstatus, nullptr, 0);
+
+		futex_registry_view view(segment.name.c_str());
+		EXPECT_TRUE(view.read().empty());
+		// the only slot belongs to the dead process and is reused
+		auto registration = registry.add("alive", mutex);
+		ASSERT_EQ(view.read().size(), 1u);
+		EXPECT_EQ(view.read()[0].name, "alive");
+		EXPECT_THROW(registry.add("no_room", mutex), futex_base_exception);
+	}
+}
+
+TEST(registry, dead_claimer_slot_reused) {
+	std::cout << "==========futex registry dead claimer test=======\n";
+	registry_segment segment;
+	using mutex_t = futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats >;
+	futex_registry registry(segment.name.c_str(), 1u);
+	mutex_t mutex;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		// dies between the claim and the activation of the only slot
+		futex_detail::registry_mapping mapping(segment.name.c_str(), 1u, false);
+		std::uint32_t state = futex_detail::registry_slot::free;
+		mapping.slot(0u).state.compare_exchange_strong(state,
+			futex_detail::registry_slot::claimed | static_cast< std::uint32_t >(::getpid()));
+		::_exit(0);
+	}
+	::waitpid(forkstatus, nullptr, 0);
+
+	auto registration = registry.add("alive", mutex);
+	futex_registry_view view(segment.name.c_str());
+	ASSERT_EQ(view.read().size(), 1u);
+	EXPECT_EQ(view.read()[0].name, "alive");
+}
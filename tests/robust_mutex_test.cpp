@@ -0,0 +1,137 @@
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mutex.hpp"
+#include "../include/futex_robust_mutex.hpp"
+
+TEST(robust_mutex_inprocess, increment) {
+	std::cout << "==========futex robust mutex test with increment=======\n";
+	futex_robust_mutex< shared_policy::inprocess > mutex;
+	double a = 0;
+	const std::uint32_t max = 10000u;
+	auto writer = [&mutex, &a, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			futex_mutex_lock_guard< decltype(mutex) > lock(mutex);
+			++a;
+		}
+	};
+	std::array< std::thread, 16 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(writer);
+	for (auto&& thread : threads)
+		thread.join();
+	GTEST_CHECK_(std::fabs(a - 16 * max) < std::numeric_limits< double >::epsilon());
+	EXPECT_EQ(mutex.owner(), 0);
+}
+
+TEST(robust_mutex_inprocess, owner_thread_exit) {
+	std::cout << "==========futex robust mutex owner exit test=======\n";
+	futex_robust_mutex< shared_policy::inprocess > mutex;
+	EXPECT_THROW(mutex.unlock(), futex_scoped_error);
+
+	// the thread exits holding the mutex
+	std::thread([&mutex]() { mutex.lock(); }).join();
+	EXPECT_EQ(mutex.owner(), 0);
+	EXPECT_EQ(mutex.lock_robust(), futex_robust_status::owner_dead);
+	EXPECT_THROW(mutex.lock(), futex_scoped_error);
+	mutex.consistent();
+	EXPECT_THROW(mutex.consistent(), futex_scoped_error);
+	mutex.unlock();
+
+	EXPECT_TRUE(mutex.try_lock());
+	mutex.unlock();
+
+	// other robust mutexes held by the same thread, including glibc ones, stay on the list
+	pthread_mutexattr_t attr;
+	::pthread_mutexattr_init(&attr);
+	::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_t pmutex;
+	::pthread_mutex_init(&pmutex, &attr);
+	futex_robust_mutex< shared_policy::inprocess > second;
+	std::thread([&]() {
+		mutex.lock();
+		::pthread_mutex_lock(&pmutex);
+		second.lock();
+		mutex.unlock();
+	}).join();
+	EXPECT_EQ(mutex.try_lock_robust(), futex_robust_status::acquired);
+	mutex.unlock();
+	EXPECT_EQ(::pthread_mutex_lock(&pmutex), EOWNERDEAD);
+	::pthread_mutex_consistent(&pmutex);
+	::pthread_mutex_unlock(&pmutex);
+	::pthread_mutex_destroy(&pmutex);
+	::pthread_mutexattr_destroy(&attr);
+	EXPECT_THROW(second.lock(), futex_owner_dead);
+	second.consistent();
+	second.unlock();
+}
+
+TEST(robust_mutex_inprocess, not_recoverable) {
+	std::cout << "==========futex robust mutex not recoverable test=======\n";
+	futex_robust_mutex< shared_policy::inprocess > mutex;
+	std::thread([&mutex]() { mutex.lock(); }).join();
+
+	// waiter gets the failure too
+	EXPECT_THROW(mutex.lock(), futex_owner_dead);
+	std::thread waiter([&mutex]() {
+		EXPECT_EQ(mutex.try_lock_robust_for(std::chrono::seconds(5)), futex_robust_status::not_recoverable);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	mutex.unlock();
+	waiter.join();
+
+	EXPECT_EQ(mutex.lock_robust(), futex_robust_status::not_recoverable);
+	EXPECT_THROW(mutex.try_lock(), futex_not_recoverable);
+}
+
+TEST(robust_mutex_interprocess, owner_process_killed) {
+	std::cout << "==========futex robust mutex interprocess test=======\n";
+	struct shared_buffer
+	{
+		futex_robust_mutex< shared_policy::interprocess > mutex;
+		std::atomic< bool > locked{false};
+	};
+	void* addr = ::mmap(nullptr, sizeof(shared_buffer), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	auto* data = new (addr) shared_buffer;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		data->mutex.lock();
+		data->locked = true;
+		for (;;)
+			::pause();
+	}
+
+	while (!data->locked)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	EXPECT_EQ(data->mutex.owner(), forkstatus);
+	EXPECT_FALSE(data->mutex.try_lock());
+
+	// the waiter sleeps in the kernel and is woken by the owner death
+	std::thread killer([forkstatus]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		::kill(forkstatus, SIGKILL);
+	});
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(data->mutex.try_lock_robust_for(std::chrono::seconds(5)), futex_robust_status::owner_dead);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+	killer.join();
+	data->mutex.consistent();
+	data->mutex.unlock();
+	EXPECT_TRUE(data->mutex.try_lock());
+	data->mutex.unlock();
+
+	::waitpid(forkstatus, nullptr, 0);
+	::munmap(addr, sizeof(shared_buffer));
+}
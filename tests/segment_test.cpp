@@ -0,0 +1,326 @@
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../include/futex_segment.hpp"
+#include "../include/futex_mutex.hpp"
+
+namespace
+{
+
+//! Counts its constructions in the segment
+struct counted_object
+{
+	explicit counted_object(std::atomic< std::uint32_t >& constructions, std::uint32_t value)
+	: m_value(value)
+	{
+		constructions.fetch_add(1u, std::memory_order_relaxed);
+		// gives the other callers time to find the entry under construction
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	std::uint32_t m_value;
+};
+
+struct throwing_object
+{
+	throwing_object()
+	{
+		throw std::runtime_error("constructor failed");
+	}
+};
+
+//! Constructor which waits for a go signal and then throws
+struct slow_throwing_object
+{
+	explicit slow_throwing_object(std::atomic< bool >& go)
+	{
+		while (!go.load())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		throw std::runtime_error("constructor failed");
+	}
+};
+
+//! Constructor which kills its process
+struct dying_object
+{
+	dying_object()
+	{
+		::_exit(0);
+	}
+};
+
+} // namespace
+
+TEST(segment, anonymous_find_or_construct) {
+	std::cout << "==========futex segment anonymous test=======\n";
+	futex_segment segment(1u << 16u);
+	EXPECT_TRUE(segment.created());
+	EXPECT_FALSE(segment.huge_pages());
+	EXPECT_GE(segment.size(), 1u << 16u);
+	EXPECT_EQ(segment.find< std::uint64_t >("value"), nullptr);
+
+	std::uint64_t& value = segment.find_or_construct< std::uint64_t >("value", 42u);
+	EXPECT_EQ(value, 42u);
+	EXPECT_EQ(reinterpret_cast< std::uintptr_t >(&value) % futex_cache_line_size, 0u);
+	// the second call finds the object and ignores the arguments
+	EXPECT_EQ(&segment.find_or_construct< std::uint64_t >("value", 7u), &value);
+	EXPECT_EQ(segment.find< std::uint64_t >("value"), &value);
+	EXPECT_THROW(segment.find< std::uint32_t >("value"), futex_base_exception);
+	EXPECT_THROW(segment.find_or_construct< std::uint64_t >(""), futex_base_exception);
+	EXPECT_THROW(segment.find_or_construct< std::uint64_t >("a name which is much too long for the directory"), futex_base_exception);
+
+	// a failed constructor frees the name
+	EXPECT_THROW(segment.find_or_construct< throwing_object >("object"), std::runtime_error);
+	EXPECT_EQ(segment.find< std::uint64_t >("object"), nullptr);
+	EXPECT_EQ(segment.find_or_construct< std::uint64_t >("object", 1u), 1u);
+
+	// no room
+	EXPECT_THROW((segment.find_or_construct< std::array< char, 1u << 17u > >("large")), futex_base_exception);
+	EXPECT_GT(segment.free_size(), 0u);
+}
+
+TEST(segment, failed_constructor_keeps_later_names) {
+	std::cout << "==========futex segment tombstone test=======\n";
+	futex_segment segment(4096u);
+	std::atomic< bool > go{false};
+	const std::size_t initial = segment.free_size();
+	// "a" fails in entry 0 while "b" is constructed in entry 1
+	std::thread first([&]() {
+		EXPECT_THROW(segment.find_or_construct< slow_throwing_object >("a", go), std::runtime_error);
+	});
+	// "a" has claimed entry 0 and allocated its object
+	while (segment.free_size() == initial)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::uint64_t* b = nullptr;
+	std::thread second([&]() { b = &segment.find_or_construct< std::uint64_t >("b", 2u); });
+	// "b" waits for entry 0, then skips the name "a"
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	go = true;
+	first.join();
+	second.join();
+	ASSERT_NE(b, nullptr);
+
+	// entry 0 is a tombstone of "a", not a free entry for "b"
+	EXPECT_EQ(&segment.find_or_construct< std::uint64_t >("b", 3u), b);
+	EXPECT_EQ(*b, 2u);
+	EXPECT_EQ(segment.find< std::uint64_t >("a"), nullptr);
+	EXPECT_EQ(segment.find_or_construct< std::uint64_t >("a", 1u), 1u);
+	EXPECT_EQ(segment.find_or_construct< std::uint64_t >("c", 4u), 4u);
+	EXPECT_EQ(segment.find< std::uint64_t >("b"), b);
+}
+
+TEST(segment, dead_constructing_process) {
+	std::cout << "==========futex segment dead owner test=======\n";
+	futex_segment segment(4096u);
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+		segment.find_or_construct< dying_object >("object");
+	::waitpid(forkstatus, nullptr, 0);
+
+	// the claim of the dead child turns into a tombstone, the name can be constructed again
+	EXPECT_EQ(segment.find_or_construct< std::uint64_t >("object", 5u), 5u);
+	EXPECT_EQ(*segment.find< std::uint64_t >("object"), 5u);
+}
+
+TEST(segment, directory_full) {
+	std::cout << "==========futex segment directory test=======\n";
+	futex_segment_options options;
+	options.directory_capacity = 4u;
+	futex_segment segment(4096u, options);
+	for (std::uint32_t cc = 0; cc < 4u; ++cc)
+		EXPECT_EQ(segment.find_or_construct< std::uint32_t >(std::to_string(cc).c_str(), cc), cc);
+	EXPECT_THROW(segment.find_or_construct< std::uint32_t >("4"), futex_base_exception);
+	EXPECT_EQ(*segment.find< std::uint32_t >("3"), 3u);
+}
+
+TEST(segment, constructed_once_by_threads) {
+	std::cout << "==========futex segment construct once test=======\n";
+	futex_segment segment(4096u);
+	std::atomic< std::uint32_t > constructions{0u};
+	std::vector< counted_object* > objects(8u);
+	std::vector< std::thread > threads;
+	for (std::uint32_t cc = 0; cc < objects.size(); ++cc)
+		threads.emplace_back([&, cc]() { objects[cc] = &segment.find_or_construct< counted_object >("object", constructions, cc); });
+	for (std::thread& thread : threads)
+		thread.join();
+	EXPECT_EQ(constructions.load(), 1u);
+	for (counted_object* object : objects)
+		EXPECT_EQ(object, objects.front());
+}
+
+TEST(segment, constructed_once_by_processes) {
+	std::cout << "==========futex segment interprocess test=======\n";
+	using mutex_t = futex_mutex< shared_policy::interprocess >;
+	futex_segment segment(4096u);
+	std::uint32_t& counter = segment.find_or_construct< std::uint32_t >("counter", 0u);
+	const std::uint32_t processes = 4u, iterations = 10000u;
+
+	std::vector< int > children;
+	for (std::uint32_t process = 0; process < processes; ++process)
+	{
+		int forkstatus = ::fork();
+		ASSERT_GE(forkstatus, 0);
+		if (forkstatus == 0)
+		{
+			// every child constructs or finds the same mutex
+			mutex_t& mutex = segment.find_or_construct< mutex_t >("mutex");
+			for (std::uint32_t cc = 0; cc < iterations; ++cc)
+			{
+				futex_mutex_lock_guard< mutex_t > guard(mutex);
+				++counter;
+			}
+			::_exit(0);
+		}
+		children.push_back(forkstatus);
+	}
+	for (int child : children)
+	{
+		int status = 0;
+		::waitpid(child, &status, 0);
+		EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	EXPECT_EQ(counter, processes * iterations);
+	mutex_t* mutex = segment.find< mutex_t >("mutex");
+	ASSERT_NE(mutex, nullptr);
+	EXPECT_TRUE(mutex->try_lock());
+	mutex->unlock();
+}
+
+TEST(segment, named_create_and_open) {
+	std::cout << "==========futex segment named test=======\n";
+	const std::string name = "/futex-segment-test-" + std::to_string(::getpid());
+	futex_segment::remove(name.c_str());
+	{
+		futex_segment_options options;
+		options.populate = true;
+		futex_segment creator(name.c_str(), 8192u, options);
+		EXPECT_TRUE(creator.created());
+		std::uint64_t& value = creator.find_or_construct< std::uint64_t >("value", 5u);
+
+		futex_segment opener(name.c_str(), 8192u, options);
+		EXPECT_FALSE(opener.created());
+		EXPECT_EQ(opener.size(), creator.size());
+		std::uint64_t* opened = opener.find< std::uint64_t >("value");
+		ASSERT_NE(opened, nullptr);
+		EXPECT_EQ(*opened, 5u);
+		value = 6u;
+		EXPECT_EQ(*opened, 6u);
+	}
+	EXPECT_TRUE(futex_segment::remove(name.c_str()));
+	EXPECT_FALSE(futex_segment::remove(name.c_str()));
+	EXPECT_THROW(futex_segment("no-slash", 4096u), futex_base_exception);
+}
+
+TEST(segment, opener_follows_hugetlbfs_fallback) {
+	std::cout << "==========futex segment hugetlbfs fallback test=======\n";
+	char dir[] = "/tmp/futex-hugetlbfs-XXXXXX";
+	ASSERT_NE(::mkdtemp(dir), nullptr);
+	const std::string name = "/futex-segment-fallback-test-" + std::to_string(::getpid());
+	futex_segment_options options;
+	options.huge_pages = true;
+	options.hugetlbfs_dir = dir;
+	options.init_timeout = std::chrono::seconds(5);
+	futex_segment::remove(name.c_str(), options);
+
+	// a creator which got the hugetlbfs file but no huge pages: it creates the /dev/shm segment, then removes the file
+	const std::string path = std::string(dir) + name;
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(::flock(fd, LOCK_EX), 0);
+	std::thread creator([&name, &path, fd]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		futex_segment fallback(name.c_str(), 8192u);
+		fallback.find_or_construct< std::uint64_t >("value", 7u);
+		::unlink(path.c_str());
+		::close(fd);
+	});
+	{
+		std::unique_ptr< futex_segment > opener;
+		EXPECT_NO_THROW(opener.reset(new futex_segment(name.c_str(), 8192u, options)));
+		creator.join();
+		ASSERT_NE(opener, nullptr);
+		EXPECT_FALSE(opener->created());
+		EXPECT_FALSE(opener->huge_pages());
+		std::uint64_t* value = opener->find< std::uint64_t >("value");
+		ASSERT_NE(value, nullptr);
+		EXPECT_EQ(*value, 7u);
+
+		// a later opener with huge pages available must not create a second segment of the name
+		futex_segment later(name.c_str(), 8192u, options);
+		EXPECT_FALSE(later.created());
+		EXPECT_NE(later.find< std::uint64_t >("value"), nullptr);
+		EXPECT_NE(::access(path.c_str(), F_OK), 0);
+	}
+	EXPECT_TRUE(futex_segment::remove(name.c_str(), options));
+	::rmdir(dir);
+}
+
+TEST(segment, dead_creator_reclaimed) {
+	std::cout << "==========futex segment dead creator test=======\n";
+	const std::string name = "/futex-segment-dead-creator-test-" + std::to_string(::getpid());
+	futex_segment_options options;
+	options.init_timeout = std::chrono::milliseconds(50);
+	futex_segment::remove(name.c_str());
+
+	// the creator died before the initialization: an empty object without its flock
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+	ASSERT_GE(fd, 0);
+	::close(fd);
+	{
+		futex_segment segment(name.c_str(), 4096u, options);
+		EXPECT_TRUE(segment.created());
+		EXPECT_EQ(segment.find_or_construct< std::uint32_t >("value", 4u), 4u);
+	}
+	EXPECT_TRUE(futex_segment::remove(name.c_str()));
+
+	// a live but slow creator keeps its flock, the opener gives up
+	fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(::flock(fd, LOCK_EX), 0);
+	EXPECT_THROW(futex_segment(name.c_str(), 4096u, options), futex_base_exception);
+	::close(fd);
+	EXPECT_TRUE(futex_segment::remove(name.c_str()));
+}
+
+TEST(segment, huge_pages_and_lock) {
+	std::cout << "==========futex segment huge pages test=======\n";
+	futex_segment_options options;
+	options.huge_pages = true;
+	options.populate = true;
+	options.lock = true;
+	// falls back to normal pages if the system has no huge pages reserved
+	futex_segment segment(1u << 16u, options);
+	if (segment.huge_pages())
+	{
+		EXPECT_EQ(segment.size() % futex_segment::huge_page_size(), 0u);
+	}
+	EXPECT_EQ(segment.find_or_construct< std::uint32_t >("value", 3u), 3u);
+
+	const std::string name = "/futex-segment-huge-test-" + std::to_string(::getpid());
+	options.hugetlbfs_dir = "/nonexistent-hugetlbfs";
+	{
+		futex_segment named(name.c_str(), 1u << 16u, options);
+		EXPECT_FALSE(named.huge_pages());
+	}
+	EXPECT_TRUE(futex_segment::remove(name.c_str(), options));
+
+	options.huge_pages_fallback = false;
+	EXPECT_THROW(futex_segment(name.c_str(), 1u << 16u, options), futex_base_exception);
+	futex_segment::remove(name.c_str(), options);
+}
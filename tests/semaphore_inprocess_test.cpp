@@ -1,3 +1,5 @@
+#include <array>
+#include <atomic>
 #include <thread>
 #include <iostream>
 #include <chrono>
@@ -60,3 +62,43 @@ TEST(semaphore_inprocess, wait_for) {
 	EXPECT_EQ(locked, 8);
 	EXPECT_EQ(timeouts, 2);
 }
+
+//more contenders than limit + 1: every post must admit a waiter
+TEST(semaphore_inprocess, many_contenders) {
+	std::cout << "==========semaphore inprocess test for many contenders=======\n";
+	const std::int32_t limit = 2;
+	futex_semaphore< shared_policy::inprocess > sem{limit};
+	std::atomic< std::int32_t > holders{0}, max_holders{0};
+	std::atomic< std::uint32_t > acquired{0u}, timeouts{0u};
+	std::atomic< bool > start{false};
+	auto worker = [&]()
+	{
+		while (!start.load())
+			std::this_thread::yield();
+		for (int cc = 0; cc < 200; ++cc)
+		{
+			if (!sem.wait_for(std::chrono::seconds(2)))
+			{
+				++timeouts;
+				return;
+			}
+			const std::int32_t now = ++holders;
+			std::int32_t seen = max_holders.load();
+			while (now > seen && !max_holders.compare_exchange_weak(seen, now))
+				;
+			++acquired;
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			--holders;
+			sem.post();
+		}
+	};
+	std::array< std::thread, 8 > threads;
+	for (auto&& thrd : threads)
+		thrd = std::thread(worker);
+	start = true;
+	for (auto&& thrd : threads)
+		thrd.join();
+	EXPECT_EQ(timeouts.load(), 0u);
+	EXPECT_EQ(acquired.load(), 8u * 200u);
+	EXPECT_LE(max_holders.load(), limit);
+}
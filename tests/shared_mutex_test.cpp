@@ -0,0 +1,168 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <shared_mutex>
+
+#include <gtest/gtest.h>
+#include "../include/futex_shared_mutex.hpp"
+
+namespace
+{
+
+//! Writers keep two values equal, readers check them
+template< typename Mutex >
+void readers_writers_test()
+{
+	Mutex mutex;
+	std::uint64_t a{0u}, b{0u};
+	std::atomic< std::uint32_t > torn{0u};
+	std::atomic< std::uint64_t > reads{0u};
+	const std::uint32_t max = 10000u;
+
+	std::vector< std::thread > threads;
+	for (std::uint32_t cc = 0; cc < 4u; ++cc)
+	{
+		threads.emplace_back([&]() {
+			for (std::uint32_t i = 0; i < max; ++i)
+			{
+				std::lock_guard< Mutex > lock(mutex);
+				++a;
+				++b;
+			}
+		});
+	}
+	for (std::uint32_t cc = 0; cc < 8u; ++cc)
+	{
+		threads.emplace_back([&]() {
+			for (std::uint32_t i = 0; i < max; ++i)
+			{
+				std::shared_lock< Mutex > lock(mutex);
+				if (a != b)
+					++torn;
+				++reads;
+			}
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(a, 4u * max);
+	EXPECT_EQ(b, 4u * max);
+	EXPECT_EQ(torn, 0u);
+	EXPECT_EQ(reads, 8u * max);
+}
+
+//! Readers share the lock, a waiting writer blocks new readers
+template< typename Mutex >
+void writer_preference_test()
+{
+	Mutex mutex;
+	mutex.lock_shared();
+	EXPECT_TRUE(mutex.try_lock_shared());
+	mutex.unlock_shared();
+	EXPECT_FALSE(mutex.try_lock());
+
+	std::atomic< bool > written{false};
+	std::thread writer([&]() {
+		mutex.lock();
+		written = true;
+		mutex.unlock();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_FALSE(written);
+	EXPECT_FALSE(mutex.try_lock_shared());
+
+	// a new reader sleeps until the writer is done
+	std::thread reader([&]() {
+		mutex.lock_shared();
+		EXPECT_TRUE(written);
+		mutex.unlock_shared();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	mutex.unlock_shared();
+	writer.join();
+	reader.join();
+
+	EXPECT_TRUE(mutex.try_lock());
+	EXPECT_FALSE(mutex.try_lock_shared());
+	mutex.unlock();
+	EXPECT_TRUE(mutex.try_lock_shared());
+	mutex.unlock_shared();
+}
+
+template< typename Mutex >
+void interprocess_test()
+{
+	struct shared_buffer
+	{
+		Mutex mutex;
+		std::uint64_t a = 0;
+		std::uint64_t b = 0;
+	};
+	void* addr = ::mmap(nullptr, sizeof(shared_buffer), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	auto* data = new (addr) shared_buffer;
+	const std::uint32_t max = 10000u;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		for (std::uint32_t i = 0; i < max; ++i)
+		{
+			std::lock_guard< Mutex > lock(data->mutex);
+			++data->a;
+			++data->b;
+		}
+		::_exit(0);
+	}
+
+	std::uint32_t torn{0u};
+	for (std::uint32_t i = 0; i < max; ++i)
+	{
+		std::shared_lock< Mutex > lock(data->mutex);
+		if (data->a != data->b)
+			++torn;
+	}
+	::waitpid(forkstatus, nullptr, 0);
+	EXPECT_EQ(torn, 0u);
+	EXPECT_EQ(data->a, max);
+	data->~shared_buffer();
+	::munmap(addr, sizeof(shared_buffer));
+}
+
+} // namespace
+
+
+TEST(shared_mutex_inprocess, readers_writers) {
+	std::cout << "==========futex shared mutex readers/writers test=======\n";
+	readers_writers_test< futex_shared_mutex< shared_policy::inprocess > >();
+}
+
+TEST(shared_mutex_inprocess, writer_preference) {
+	std::cout << "==========futex shared mutex writer preference test=======\n";
+	writer_preference_test< futex_shared_mutex< shared_policy::inprocess > >();
+}
+
+TEST(shared_mutex_interprocess, readers_writers) {
+	std::cout << "==========futex shared mutex interprocess test=======\n";
+	interprocess_test< futex_shared_mutex< shared_policy::interprocess > >();
+}
+
+TEST(percpu_shared_mutex_inprocess, readers_writers) {
+	std::cout << "==========futex percpu shared mutex readers/writers test=======\n";
+	readers_writers_test< futex_percpu_shared_mutex< shared_policy::inprocess > >();
+}
+
+TEST(percpu_shared_mutex_inprocess, writer_preference) {
+	std::cout << "==========futex percpu shared mutex writer preference test=======\n";
+	writer_preference_test< futex_percpu_shared_mutex< shared_policy::inprocess, 4u > >();
+}
+
+TEST(percpu_shared_mutex_interprocess, readers_writers) {
+	std::cout << "==========futex percpu shared mutex interprocess test=======\n";
+	interprocess_test< futex_percpu_shared_mutex< shared_policy::interprocess > >();
+}
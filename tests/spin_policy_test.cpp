@@ -0,0 +1,57 @@
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+#include <gtest/gtest.h>
+#include "../include/futex_mutex.hpp"
+
+TEST(spin_policy, environment) {
+	std::cout << "==========spin environment=======\n";
+	const auto& env = spin_environment::instance();
+	std::cout << "online cpus: " << env.online_cpus() << " affinity cpus: " << env.affinity_cpus()
+		<< " cgroup quota: " << env.cgroup_cpu_quota() << " smt siblings: " << env.smt_siblings()
+		<< " effective cpus: " << env.effective_cpus() << "\n"
+		<< "pause: " << env.pause_cycles() << " cycles, " << env.pause_ns() << " ns\n";
+
+	EXPECT_GE(env.online_cpus(), 1u);
+	EXPECT_GE(env.smt_siblings(), 1u);
+	EXPECT_GE(env.effective_cpus(), 1u);
+	EXPECT_LE(env.effective_cpus(), env.affinity_cpus());
+	EXPECT_GT(env.pause_ns(), 0.);
+	EXPECT_GE(env.pauses_for(1000u), 1u);
+	EXPECT_EQ(env.spinning_useful(), env.effective_cpus() > 1u);
+	EXPECT_EQ(&env, &spin_environment::instance());
+}
+
+template< typename Mutex >
+void increment_test(Mutex& mutex)
+{
+	double a = 0;
+	const std::uint32_t max = 10000u;
+	auto writer = [&mutex, &a, max]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			futex_mutex_lock_guard< Mutex > lock(mutex);
+			++a;
+		}
+	};
+	std::array< std::thread, 16 > threads;
+	for (auto&& thread : threads)
+		thread = std::thread(writer);
+	for (auto&& thread : threads)
+		thread.join();
+	GTEST_CHECK_(std::fabs(a - 16 * max) < std::numeric_limits< double >::epsilon());
+}
+
+TEST(spin_policy, backoff_strategies) {
+	std::cout << "==========futex mutex with different backoff strategies=======\n";
+	futex_mutex< shared_policy::inprocess, true, no_spin_backoff > no_spin;
+	increment_test(no_spin);
+	futex_mutex< shared_policy::inprocess, true, fixed_backoff > fixed;
+	increment_test(fixed);
+	futex_mutex< shared_policy::inprocess, true, exponential_backoff< 500u > > exponential;
+	increment_test(exponential);
+	futex_mutex< shared_policy::inprocess, true, bounded_backoff< 50u, 2000u > > bounded;
+	increment_test(bounded);
+}
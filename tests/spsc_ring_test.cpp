@@ -0,0 +1,169 @@
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <gtest/gtest.h>
+
+#include "../include/futex_spsc_ring.hpp"
+
+using namespace boost::interprocess;
+
+TEST(spsc_ring_inprocess, reserve_commit) {
+	std::cout << "==========futex spsc ring reserve/commit test=======\n";
+	futex_spsc_ring< shared_policy::inprocess, 256u > ring;
+	EXPECT_FALSE(ring.try_peek());
+	EXPECT_EQ(ring.max_record_size(), 120u);
+	EXPECT_THROW(ring.try_reserve(121u), futex_base_exception);
+
+	// a partial commit publishes only the used bytes
+	futex_ring_span span = ring.try_reserve(100u);
+	ASSERT_TRUE(span);
+	std::memcpy(span.data, "hello", 5u);
+	ring.commit(5u);
+	EXPECT_EQ(ring.used_approx(), 16u);
+
+	span = ring.try_peek();
+	ASSERT_TRUE(span);
+	EXPECT_EQ(std::string(span.data, span.size), "hello");
+	ring.release();
+	EXPECT_FALSE(ring.try_peek());
+	EXPECT_EQ(ring.used_approx(), 0u);
+
+	// the second record doesn't fit before the end, it waits for the padding to be free
+	span = ring.try_reserve(120u);
+	ASSERT_TRUE(span);
+	ring.commit(120u);
+	EXPECT_FALSE(ring.try_reserve(120u));
+	EXPECT_FALSE(ring.reserve_for(120u, std::chrono::milliseconds(20)));
+	char buffer[128];
+	EXPECT_EQ(ring.try_read(buffer, sizeof(buffer)), 120u);
+	EXPECT_TRUE(ring.try_reserve(120u));
+	ring.commit(120u);
+	EXPECT_EQ(ring.used_approx(), 128u + 112u);
+
+	// full
+	futex_spsc_ring< shared_policy::inprocess, 256u > full;
+	for (std::uint32_t cc = 0; cc < 2u; ++cc)
+		EXPECT_TRUE(full.try_write(buffer, 120u));
+	EXPECT_FALSE(full.try_reserve(1u));
+	EXPECT_EQ(full.try_read(buffer, sizeof(buffer)), 120u);
+	EXPECT_EQ(full.try_read(buffer, sizeof(buffer)), 120u);
+	EXPECT_FALSE(full.peek_for(std::chrono::milliseconds(20)));
+}
+
+TEST(spsc_ring_inprocess, wrap_with_padding) {
+	std::cout << "==========futex spsc ring wrap test=======\n";
+	futex_spsc_ring< shared_policy::inprocess, 128u > ring;
+	char buffer[64];
+	// records of different sizes wrap at different offsets
+	for (std::uint32_t cc = 0; cc < 1000u; ++cc)
+	{
+		const std::size_t size = 1u + (cc * 13u) % ring.max_record_size();
+		std::string record(size, static_cast< char >('a' + cc % 26u));
+		ASSERT_TRUE(ring.try_write(record.data(), size));
+		ASSERT_EQ(ring.try_read(buffer, sizeof(buffer)), size);
+		ASSERT_EQ(std::string(buffer, size), record);
+	}
+}
+
+TEST(spsc_ring_inprocess, producer_consumer) {
+	std::cout << "==========futex spsc ring producer/consumer test=======\n";
+	futex_spsc_ring< shared_policy::inprocess, 4096u > ring;
+	const std::uint64_t records = 200000u;
+	std::thread producer([&]() {
+		for (std::uint64_t cc = 0; cc < records; ++cc)
+		{
+			const std::size_t size = sizeof(std::uint64_t) * (1u + cc % 8u);
+			futex_ring_span span = ring.reserve(size);
+			for (std::size_t index = 0; index < size / sizeof(std::uint64_t); ++index)
+				std::memcpy(span.data + index * sizeof(std::uint64_t), &cc, sizeof(cc));
+			ring.commit(size);
+		}
+	});
+	std::uint64_t errors{0u};
+	for (std::uint64_t cc = 0; cc < records; ++cc)
+	{
+		const futex_ring_span span = ring.peek();
+		if (span.size != sizeof(std::uint64_t) * (1u + cc % 8u))
+			++errors;
+		for (std::size_t index = 0; index < span.size / sizeof(std::uint64_t); ++index)
+		{
+			std::uint64_t value;
+			std::memcpy(&value, span.data + index * sizeof(std::uint64_t), sizeof(value));
+			if (value != cc)
+				++errors;
+		}
+		ring.release();
+	}
+	producer.join();
+	EXPECT_EQ(errors, 0u);
+}
+
+TEST(spsc_ring_interprocess, forked_consumer) {
+	std::cout << "==========futex spsc ring interprocess test=======\n";
+	using ring_t = futex_spsc_ring< shared_policy::interprocess, 1024u >;
+	const std::string name = "futex-spsc-ring-test-" + std::to_string(::getpid());
+	struct shm_remove
+	{
+		explicit shm_remove(const std::string& name) : m_name(name) { shared_memory_object::remove(m_name.c_str()); }
+		~shm_remove() { shared_memory_object::remove(m_name.c_str()); }
+		std::string m_name;
+	} remover(name);
+
+	shared_memory_object shm(create_only, name.c_str(), read_write);
+	shm.truncate(2 * sizeof(ring_t));
+	mapped_region region(shm, read_write);
+	// requests to the child and replies back
+	ring_t* requests = new (region.get_address()) ring_t;
+	ring_t* replies = new (static_cast< char* >(region.get_address()) + sizeof(ring_t)) ring_t;
+	const std::uint32_t messages = 20000u;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		// echoes every request doubled
+		for (std::uint32_t cc = 0; cc < messages; ++cc)
+		{
+			const futex_ring_span request = requests->peek();
+			std::uint32_t value;
+			std::memcpy(&value, request.data, sizeof(value));
+			requests->release();
+			value *= 2u;
+			futex_ring_span reply = replies->reserve(sizeof(value));
+			std::memcpy(reply.data, &value, sizeof(value));
+			replies->commit(sizeof(value));
+		}
+		::_exit(0);
+	}
+
+	std::uint32_t errors{0u}, received{0u};
+	std::thread reader([&]() {
+		for (std::uint32_t cc = 0; cc < messages; ++cc)
+		{
+			const futex_ring_span reply = replies->peek();
+			std::uint32_t value;
+			std::memcpy(&value, reply.data, sizeof(value));
+			replies->release();
+			if (value != cc * 2u)
+				++errors;
+			++received;
+		}
+	});
+	for (std::uint32_t cc = 0; cc < messages; ++cc)
+	{
+		futex_ring_span request = requests->reserve(sizeof(cc));
+		std::memcpy(request.data, &cc, sizeof(cc));
+		requests->commit(sizeof(cc));
+	}
+	reader.join();
+	::waitpid(forkstatus, nullptr, 0);
+	EXPECT_EQ(received, messages);
+	EXPECT_EQ(errors, 0u);
+}
@@ -0,0 +1,125 @@
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <numeric>
+#include <type_traits>
+
+#include <gtest/gtest.h>
+#include "../include/futex_condition_variable.hpp"
+
+namespace
+{
+
+std::uint64_t histogram_total(const std::array< std::uint64_t, futex_stats_buckets >& histogram)
+{
+	return std::accumulate(histogram.begin(), histogram.end(), std::uint64_t{0u});
+}
+
+} // namespace
+
+TEST(stats, disabled_is_free) {
+	std::cout << "==========futex disabled statistics test=======\n";
+	static_assert(std::is_empty< futex_no_stats >::value, "disabled statistics must take no space");
+	static_assert(sizeof(futex_mutex< shared_policy::inprocess >) == 2 * sizeof(std::uint32_t), "statistics must not change the mutex size");
+	static_assert(sizeof(futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::packed >) == sizeof(std::uint32_t),
+		"statistics must not change the packed mutex size");
+
+	futex_mutex< shared_policy::inprocess > mutex;
+	mutex.lock();
+	mutex.unlock();
+	EXPECT_EQ(mutex.statistics().snapshot().acquisitions, 0u);
+}
+
+TEST(stats, histogram_buckets) {
+	std::cout << "==========futex statistics buckets test=======\n";
+	EXPECT_EQ(futex_contention_stats::bucket(0u), 0u);
+	EXPECT_EQ(futex_contention_stats::bucket(1u), 0u);
+	EXPECT_EQ(futex_contention_stats::bucket(2u), 1u);
+	EXPECT_EQ(futex_contention_stats::bucket(1023u), 9u);
+	EXPECT_EQ(futex_contention_stats::bucket(1024u), 10u);
+	EXPECT_EQ(futex_contention_stats::bucket(~std::uint64_t{0u}), futex_stats_buckets - 1u);
+}
+
+TEST(stats, mutex_contention) {
+	std::cout << "==========futex mutex statistics test=======\n";
+	using mutex_t = futex_mutex< shared_policy::inprocess, false, default_backoff, futex_layout::standard, futex_contention_stats >;
+	mutex_t mutex;
+
+	EXPECT_TRUE(mutex.try_lock());
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	mutex.unlock();
+	futex_stats_snapshot snapshot = mutex.statistics().snapshot();
+	EXPECT_EQ(snapshot.acquisitions, 1u);
+	EXPECT_EQ(snapshot.contended, 0u);
+	EXPECT_EQ(snapshot.futex_wakes, 0u);
+	// held for 2 ms at least: 2^21 ns and more
+	EXPECT_EQ(histogram_total(snapshot.hold_ns), 1u);
+	EXPECT_EQ(std::accumulate(snapshot.hold_ns.begin(), snapshot.hold_ns.begin() + 20, std::uint64_t{0u}), 0u);
+
+	// a parked waiter: one contended acquisition, at least one futex wait and one wake
+	mutex.statistics().reset();
+	mutex.lock();
+	std::thread waiter([&mutex]() {
+		futex_mutex_lock_guard< mutex_t > lock(mutex);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	mutex.unlock();
+	waiter.join();
+
+	snapshot = mutex.statistics().snapshot();
+	EXPECT_EQ(snapshot.acquisitions, 2u);
+	EXPECT_EQ(snapshot.contended, 1u);
+	EXPECT_GE(snapshot.futex_waits, 1u);
+	// the woken waiter marks the mutex as having waiters, its unlock wakes too
+	EXPECT_GE(snapshot.futex_wakes, 1u);
+	EXPECT_EQ(histogram_total(snapshot.wait_ns), 1u);
+	EXPECT_EQ(histogram_total(snapshot.hold_ns), 2u);
+
+	const std::uint32_t max = 10000u;
+	mutex.statistics().reset();
+	std::array< std::thread, 4 > threads;
+	for (auto&& thread : threads)
+	{
+		thread = std::thread([&mutex, max]() {
+			for (std::uint32_t cc = 0; cc < max; ++cc)
+				futex_mutex_lock_guard< mutex_t > lock(mutex);
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+	snapshot = mutex.statistics().snapshot();
+	EXPECT_EQ(snapshot.acquisitions, 4u * max);
+	EXPECT_EQ(histogram_total(snapshot.wait_ns), snapshot.contended);
+	EXPECT_EQ(histogram_total(snapshot.hold_ns), 4u * max);
+}
+
+TEST(stats, condition_variable) {
+	std::cout << "==========futex condition variable statistics test=======\n";
+	using mutex_t = futex_mutex< shared_policy::inprocess >;
+	mutex_t mutex;
+	futex_condition_variable< shared_policy::inprocess, futex_contention_stats > cond;
+	std::uint32_t stage{0u};
+
+	std::thread waiter([&]() {
+		futex_mutex_unique_lock< mutex_t > lock(mutex);
+		cond.wait(lock, [&stage]() { return stage == 2u; });
+	});
+	// the first notification doesn't satisfy the predicate
+	for (std::uint32_t cc = 1u; cc <= 2u; ++cc)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		{
+			futex_mutex_lock_guard< mutex_t > lock(mutex);
+			stage = cc;
+		}
+		cond.notify_one();
+	}
+	waiter.join();
+
+	const futex_stats_snapshot snapshot = cond.statistics().snapshot();
+	EXPECT_EQ(snapshot.acquisitions, 2u);
+	EXPECT_EQ(snapshot.spurious_wakeups, 1u);
+	EXPECT_GE(snapshot.futex_waits, 2u);
+	EXPECT_EQ(snapshot.futex_wakes, 2u);
+	EXPECT_EQ(histogram_total(snapshot.wait_ns), 2u);
+}
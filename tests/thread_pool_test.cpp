@@ -0,0 +1,216 @@
+#include <sched.h>
+
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../include/futex_eventcount.hpp"
+#include "../include/futex_latch.hpp"
+#include "../include/futex_thread_pool.hpp"
+
+TEST(eventcount, prepare_cancel_commit) {
+	std::cout << "==========futex eventcount test=======\n";
+	futex_eventcount< shared_policy::inprocess > ec;
+	// notify without waiters is a no-op
+	ec.notify_one();
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+
+	auto key = ec.prepare_wait();
+	EXPECT_EQ(ec.waiters_approx(), 1u);
+	ec.cancel_wait(key);
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+
+	// a notify between prepare and commit is not lost, the waiter leaves the count on return
+	key = ec.prepare_wait();
+	ec.notify_one();
+	EXPECT_EQ(ec.waiters_approx(), 1u);
+	ec.commit_wait(key);
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+
+	key = ec.prepare_wait();
+	EXPECT_FALSE(ec.commit_wait(key, make_futex_deadline(std::chrono::milliseconds(20))));
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+
+	// one notify for two waiters: both find the new epoch, each one leaves the count
+	key = ec.prepare_wait();
+	const auto other = ec.prepare_wait();
+	ec.notify_one();
+	ec.commit_wait(key);
+	ec.cancel_wait(other);
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+}
+
+TEST(eventcount, wakes_sleepers) {
+	std::cout << "==========futex eventcount wake test=======\n";
+	futex_eventcount< shared_policy::inprocess > ec;
+	std::atomic< std::uint32_t > ready{0u}, woken{0u};
+	const std::uint32_t threads = 4u;
+	std::vector< std::thread > sleepers;
+	for (std::uint32_t cc = 0; cc < threads; ++cc)
+	{
+		sleepers.emplace_back([&]() {
+			for (;;)
+			{
+				const auto key = ec.prepare_wait();
+				if (ready.load(std::memory_order_relaxed))
+				{
+					ec.cancel_wait(key);
+					break;
+				}
+				ec.commit_wait(key);
+			}
+			woken.fetch_add(1u, std::memory_order_relaxed);
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	ready.store(1u, std::memory_order_relaxed);
+	ec.notify_all();
+	for (std::thread& thread : sleepers)
+		thread.join();
+	EXPECT_EQ(woken.load(), threads);
+}
+
+//waiters which find a newer epoch in commit_wait or cancel after an epoch bump leave no count behind
+TEST(eventcount, exact_count_after_races) {
+	std::cout << "==========futex eventcount count test=======\n";
+	futex_eventcount< shared_policy::inprocess > ec;
+	std::atomic< bool > stop{false};
+	std::atomic< std::uint32_t > rounds{0u};
+	std::vector< std::thread > waiters;
+	for (std::uint32_t cc = 0; cc < 4u; ++cc)
+	{
+		waiters.emplace_back([&, cc]() {
+			for (std::uint32_t round = 0; !stop.load(); ++round)
+			{
+				const auto key = ec.prepare_wait();
+				if (stop.load() || (round + cc) % 2u)
+					ec.cancel_wait(key);
+				else
+					ec.commit_wait(key, make_futex_deadline(std::chrono::milliseconds(1)));
+				rounds.fetch_add(1u, std::memory_order_relaxed);
+			}
+		});
+	}
+	while (rounds.load() < 20000u)
+		ec.notify_one();
+	// no notify after the last round: nothing may take stale registrations off the count
+	stop = true;
+	for (std::thread& thread : waiters)
+		thread.join();
+	EXPECT_EQ(ec.waiters_approx(), 0u);
+}
+
+TEST(thread_pool, external_submit) {
+	std::cout << "==========futex thread pool submit test=======\n";
+	futex_thread_pool_options options;
+	options.threads = 4u;
+	const std::uint32_t tasks = 100000u;
+	std::atomic< std::uint64_t > sum{0u};
+	futex_latch< shared_policy::inprocess > done(tasks);
+	{
+		futex_thread_pool pool(options);
+		EXPECT_EQ(pool.size(), 4u);
+		EXPECT_EQ(pool.current_worker_index(), -1);
+		for (std::uint32_t cc = 0; cc < tasks; ++cc)
+		{
+			pool.submit([&, cc]() {
+				sum.fetch_add(cc, std::memory_order_relaxed);
+				done.count_down();
+			});
+		}
+		done.wait();
+	}
+	EXPECT_EQ(sum.load(), static_cast< std::uint64_t >(tasks) * (tasks - 1u) / 2u);
+}
+
+TEST(thread_pool, task_tree_with_stealing) {
+	std::cout << "==========futex thread pool task tree test=======\n";
+	futex_thread_pool_options options;
+	options.threads = 4u;
+	options.spin_time = std::chrono::nanoseconds(0);
+	futex_thread_pool pool(options);
+	// every task spawns two children from its worker, 2^17 - 1 tasks in all
+	const std::uint32_t depth = 16u;
+	std::atomic< std::uint32_t > executed{0u};
+	std::atomic< std::uint32_t > outside{0u};
+	futex_latch< shared_policy::inprocess > done(1u << depth);
+	std::function< void(std::uint32_t) > spawn = [&](std::uint32_t level) {
+		executed.fetch_add(1u, std::memory_order_relaxed);
+		if (pool.current_worker_index() < 0)
+			outside.fetch_add(1u, std::memory_order_relaxed);
+		if (level == depth)
+		{
+			done.count_down();
+			return;
+		}
+		pool.submit([&, level]() { spawn(level + 1u); });
+		pool.submit([&, level]() { spawn(level + 1u); });
+	};
+	pool.submit([&]() { spawn(0u); });
+	done.wait();
+	EXPECT_EQ(executed.load(), (2u << depth) - 1u);
+	EXPECT_EQ(outside.load(), 0u);
+}
+
+TEST(thread_pool, destructor_runs_pending_tasks) {
+	std::cout << "==========futex thread pool shutdown test=======\n";
+	std::atomic< std::uint32_t > executed{0u};
+	{
+		futex_thread_pool_options options;
+		options.threads = 2u;
+		futex_thread_pool pool(options);
+		for (std::uint32_t cc = 0; cc < 1000u; ++cc)
+			pool.submit([&]() { executed.fetch_add(1u, std::memory_order_relaxed); });
+	}
+	EXPECT_EQ(executed.load(), 1000u);
+}
+
+TEST(thread_pool, idle_workers_park) {
+	std::cout << "==========futex thread pool parking test=======\n";
+	futex_thread_pool_options options;
+	options.threads = 3u;
+	futex_thread_pool pool(options);
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (pool.parked_approx() < 3u && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	EXPECT_EQ(pool.parked_approx(), 3u);
+
+	futex_latch< shared_policy::inprocess > done(1u);
+	pool.submit([&]() { done.count_down(); });
+	done.wait();
+}
+
+TEST(thread_pool, pinned_workers) {
+	std::cout << "==========futex thread pool affinity test=======\n";
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	ASSERT_EQ(::sched_getaffinity(0, sizeof(set), &set), 0);
+	std::set< int > allowed;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (CPU_ISSET(cpu, &set))
+			allowed.insert(cpu);
+	}
+
+	futex_thread_pool_options options;
+	options.threads = 2u;
+	options.pin_threads = true;
+	futex_thread_pool pool(options);
+	std::atomic< int > cpu{-1};
+	futex_latch< shared_policy::inprocess > done(1u);
+	pool.submit([&]() {
+		cpu_set_t own;
+		CPU_ZERO(&own);
+		if (::sched_getaffinity(0, sizeof(own), &own) == 0 && CPU_COUNT(&own) == 1)
+			cpu = ::sched_getcpu();
+		done.count_down();
+	});
+	done.wait();
+	EXPECT_TRUE(allowed.count(cpu.load()));
+}
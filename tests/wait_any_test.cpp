@@ -0,0 +1,149 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+
+#include <gtest/gtest.h>
+#include "../include/futex_wait_any.hpp"
+
+TEST(wait_any_inprocess, semaphores) {
+	std::cout << "==========futex wait_any semaphores test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > first, second;
+
+	// ready before the call: no sleep
+	second.post();
+	EXPECT_EQ(wait_any(first, second), 1u);
+	EXPECT_EQ(second.value(), 0u);
+
+	std::thread poster([&second]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		second.post();
+	});
+	EXPECT_EQ(wait_any(first, second), 1u);
+	poster.join();
+	EXPECT_EQ(first.value(), 0u);
+	EXPECT_EQ(second.value(), 0u);
+
+	// both ready: the first one is taken
+	first.post();
+	second.post();
+	EXPECT_EQ(wait_any(first, second), 0u);
+	EXPECT_EQ(second.value(), 1u);
+	EXPECT_TRUE(second.try_wait());
+
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(wait_any_for(std::chrono::milliseconds(100), first, second), futex_wait_any_timeout);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+}
+
+TEST(wait_any_inprocess, no_lost_wakeups) {
+	std::cout << "==========futex wait_any lost wakeups test=======\n";
+	futex_counting_semaphore< shared_policy::inprocess > first, second;
+	futex_semaphore< shared_policy::inprocess > slots(1);
+	const std::uint32_t max = 2000u;
+	std::atomic< std::uint32_t > taken{0u};
+
+	// a plain waiter competes with a wait_any waiter for the same units
+	std::thread any_waiter([&]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			const std::size_t index = wait_any(first, second);
+			EXPECT_LT(index, 2u);
+			++taken;
+		}
+	});
+	std::thread plain_waiter([&]() {
+		for (std::uint32_t cc = 0; cc < max; ++cc)
+		{
+			first.wait();
+			++taken;
+		}
+	});
+	// a lost wakeup leaves one of the waiters asleep forever
+	for (std::uint32_t cc = 0; cc < max; ++cc)
+	{
+		// one wake for two units and two separate wakes
+		if (cc % 2u)
+			first.post(2u);
+		else
+		{
+			first.post();
+			first.post();
+		}
+		if (!(cc % 16u))
+			std::this_thread::yield();
+	}
+	any_waiter.join();
+	plain_waiter.join();
+	EXPECT_EQ(taken, 2u * max);
+
+	// futex_semaphore slots
+	EXPECT_TRUE(slots.try_wait());
+	EXPECT_FALSE(slots.try_wait());
+	std::thread poster([&slots]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		slots.post();
+	});
+	EXPECT_EQ(wait_any(first, slots), 1u);
+	poster.join();
+	EXPECT_FALSE(slots.try_wait());
+}
+
+TEST(wait_any_inprocess, condition_variable_shutdown) {
+	std::cout << "==========futex wait_any condition variable test=======\n";
+	using mutex_t = futex_mutex< shared_policy::inprocess >;
+	mutex_t mutex;
+	futex_condition_variable< shared_policy::inprocess > cond;
+	futex_semaphore< shared_policy::inprocess > work(1);
+	ASSERT_TRUE(work.try_wait());
+	bool shutdown = false;
+	std::uint32_t done{0u};
+
+	std::thread consumer([&]() {
+		futex_mutex_unique_lock< mutex_t > lock(mutex);
+		while (!shutdown)
+		{
+			if (wait_any(work, notified(cond, lock)) == 0u)
+			{
+				EXPECT_TRUE(lock.owns_lock());
+				++done;
+			}
+		}
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	work.post();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	{
+		futex_mutex_lock_guard< mutex_t > lock(mutex);
+		EXPECT_EQ(done, 1u);
+		shutdown = true;
+	}
+	cond.notify_all();
+	consumer.join();
+}
+
+TEST(wait_any_interprocess, shared_and_private) {
+	std::cout << "==========futex wait_any interprocess test=======\n";
+	using shared_semaphore_t = futex_counting_semaphore< shared_policy::interprocess >;
+	void* addr = ::mmap(nullptr, sizeof(shared_semaphore_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(addr, MAP_FAILED);
+	auto* shared = new (addr) shared_semaphore_t;
+	futex_counting_semaphore< shared_policy::inprocess > local;
+
+	int forkstatus = ::fork();
+	ASSERT_GE(forkstatus, 0);
+	if (forkstatus == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		shared->post();
+		::_exit(0);
+	}
+
+	EXPECT_EQ(wait_any_for(std::chrono::seconds(5), local, *shared), 1u);
+	::waitpid(forkstatus, nullptr, 0);
+	EXPECT_EQ(shared->value(), 0u);
+	::munmap(addr, sizeof(shared_semaphore_t));
+}
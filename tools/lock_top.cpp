@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include "../include/futex_registry.hpp"
+
+//! lock_top: shows the most contended registered primitives, see futex_registry.hpp
+
+namespace
+{
+
+struct options
+{
+	std::string segment = futex_registry::default_segment;
+	std::chrono::milliseconds interval{1000};
+	//! 0 - until interrupted
+	std::uint32_t iterations = 0u;
+	std::size_t top = 20u;
+	std::string sort = "contended";
+	//! plain output without clearing the screen
+	bool batch = false;
+};
+
+//! Rates and percentiles of one primitive for the last interval
+struct row
+{
+	const futex_registry_record* record;
+	double acquisitions;
+	double contended;
+	double spin_successes;
+	double futex_waits;
+	double futex_wakes;
+	double spurious_wakeups;
+	std::uint64_t wait_p50;
+	std::uint64_t wait_p99;
+	std::uint64_t hold_p50;
+	std::uint64_t hold_p99;
+};
+
+void usage(const char* name)
+{
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --segment NAME    registry shared memory segment (default: " << futex_registry::default_segment << ")\n"
+		<< "  --interval-ms N   refresh interval (default: 1000)\n"
+		<< "  --iterations N    number of refreshes, 0 - until interrupted (default: 0)\n"
+		<< "  --top N           number of shown primitives (default: 20)\n"
+		<< "  --sort KEY        contended, acquisitions, waits, wait_p99 or hold_p99 (default: contended)\n"
+		<< "  --batch           don't clear the screen between refreshes\n";
+}
+
+const char* kind_name(futex_registry_kind kind)
+{
+	switch (kind)
+	{
+	case futex_registry_kind::mutex: return "mutex";
+	case futex_registry_kind::condition_variable: return "condvar";
+	case futex_registry_kind::semaphore: return "semaphore";
+	default: return "other";
+	}
+}
+
+//! Upper bound of the bucket which holds the quantile, 0 if the histogram is empty
+std::uint64_t percentile(const std::array< std::uint64_t, futex_stats_buckets >& histogram, double quantile)
+{
+	std::uint64_t total{0u};
+	for (std::uint64_t count : histogram)
+		total += count;
+	if (!total)
+		return 0u;
+
+	const std::uint64_t rank = static_cast< std::uint64_t >(quantile * static_cast< double >(total - 1u)) + 1u;
+	std::uint64_t seen{0u};
+	for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+	{
+		seen += histogram[index];
+		if (seen >= rank)
+			return 2ull << index;
+	}
+	return 2ull << (futex_stats_buckets - 1u);
+}
+
+std::string format_duration(std::uint64_t ns)
+{
+	char buffer[32];
+	if (!ns)
+		return "-";
+	else if (ns < 1000u)
+		std::snprintf(buffer, sizeof(buffer), "%lluns", static_cast< unsigned long long >(ns));
+	else if (ns < 1000000u)
+		std::snprintf(buffer, sizeof(buffer), "%.1fus", static_cast< double >(ns) / 1e3);
+	else if (ns < 1000000000u)
+		std::snprintf(buffer, sizeof(buffer), "%.1fms", static_cast< double >(ns) / 1e6);
+	else
+		std::snprintf(buffer, sizeof(buffer), "%.1fs", static_cast< double >(ns) / 1e9);
+	return buffer;
+}
+
+//! Difference of two snapshots, the counters may be reset by the owner
+futex_stats_snapshot delta(const futex_stats_snapshot& current, const futex_stats_snapshot& previous)
+{
+	auto sub = [](std::uint64_t now, std::uint64_t before) { return now >= before ? now - before : now; };
+	futex_stats_snapshot res;
+	res.acquisitions = sub(current.acquisitions, previous.acquisitions);
+	res.contended = sub(current.contended, previous.contended);
+	res.spin_successes = sub(current.spin_successes, previous.spin_successes);
+	res.futex_waits = sub(current.futex_waits, previous.futex_waits);
+	res.futex_wakes = sub(current.futex_wakes, previous.futex_wakes);
+	res.spurious_wakeups = sub(current.spurious_wakeups, previous.spurious_wakeups);
+	for (std::size_t index = 0; index < futex_stats_buckets; ++index)
+	{
+		res.wait_ns[index] = sub(current.wait_ns[index], previous.wait_ns[index]);
+		res.hold_ns[index] = sub(current.hold_ns[index], previous.hold_ns[index]);
+	}
+	return res;
+}
+
+double sort_key(const row& item, const std::string& sort)
+{
+	if (sort == "acquisitions")
+		return item.acquisitions;
+	else if (sort == "waits")
+		return item.futex_waits;
+	else if (sort == "wait_p99")
+		return static_cast< double >(item.wait_p99);
+	else if (sort == "hold_p99")
+		return static_cast< double >(item.hold_p99);
+	return item.contended;
+}
+
+void print(const options& opts, std::vector< row >& rows, std::size_t total, double seconds)
+{
+	std::sort(rows.begin(), rows.end(), [&opts](const row& lhs, const row& rhs) {
+		return sort_key(lhs, opts.sort) > sort_key(rhs, opts.sort);
+	});
+
+	if (!opts.batch)
+		std::printf("\033[H\033[2J");
+	std::printf("lock_top: %s, %zu primitives, %.1fs interval, sorted by %s\n\n",
+		opts.segment.c_str(), total, seconds, opts.sort.c_str());
+	std::printf("%8s %-24s %-9s %10s %10s %6s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+		"PID", "NAME", "KIND", "ACQ/s", "CONT/s", "CONT%", "SPIN/s", "WAIT/s", "WAKE/s", "SPUR/s",
+		"WAIT50", "WAIT99", "HOLD50", "HOLD99");
+	for (std::size_t index = 0; index < rows.size() && index < opts.top; ++index)
+	{
+		const row& item = rows[index];
+		const double share = item.acquisitions > 0.0 ? 100.0 * item.contended / item.acquisitions : 0.0;
+		std::printf("%8d %-24.24s %-9s %10.0f %10.0f %6.1f %9.0f %9.0f %9.0f %9.0f %9s %9s %9s %9s\n",
+			item.record->pid, item.record->name.c_str(), kind_name(item.record->kind),
+			item.acquisitions, item.contended, share, item.spin_successes, item.futex_waits, item.futex_wakes, item.spurious_wakeups,
+			format_duration(item.wait_p50).c_str(), format_duration(item.wait_p99).c_str(),
+			format_duration(item.hold_p50).c_str(), format_duration(item.hold_p99).c_str());
+	}
+	std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	options opts;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--segment") && has_value)
+			opts.segment = argv[++i];
+		else if (!std::strcmp(argv[i], "--interval-ms") && has_value)
+			opts.interval = std::chrono::milliseconds(std::max(10, std::atoi(argv[++i])));
+		else if (!std::strcmp(argv[i], "--iterations") && has_value)
+			opts.iterations = static_cast< std::uint32_t >(std::max(0, std::atoi(argv[++i])));
+		else if (!std::strcmp(argv[i], "--top") && has_value)
+			opts.top = static_cast< std::size_t >(std::max(1, std::atoi(argv[++i])));
+		else if (!std::strcmp(argv[i], "--sort") && has_value)
+			opts.sort = argv[++i];
+		else if (!std::strcmp(argv[i], "--batch"))
+			opts.batch = true;
+		else
+		{
+			usage(argv[0]);
+			return std::strcmp(argv[i], "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+	}
+
+	try
+	{
+		futex_registry_view view(opts.segment.c_str());
+		// previous counters by slot, pid and name: a reused slot starts from zero
+		std::map< std::tuple< std::uint32_t, std::int32_t, std::string >, futex_stats_snapshot > previous;
+		for (const futex_registry_record& record : view.read())
+			previous.emplace(std::make_tuple(record.slot, record.pid, record.name), record.stats);
+		auto last = std::chrono::steady_clock::now();
+		for (std::uint32_t iteration = 0; !opts.iterations || iteration < opts.iterations; ++iteration)
+		{
+			std::this_thread::sleep_for(opts.interval);
+			const auto now = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration< double >(now - last).count();
+			last = now;
+
+			const std::vector< futex_registry_record > records = view.read();
+			std::map< std::tuple< std::uint32_t, std::int32_t, std::string >, futex_stats_snapshot > current;
+			std::vector< row > rows;
+			for (const futex_registry_record& record : records)
+			{
+				auto key = std::make_tuple(record.slot, record.pid, record.name);
+				auto it = previous.find(key);
+				const futex_stats_snapshot diff = it != previous.end() ? delta(record.stats, it->second) : record.stats;
+				current.emplace(std::move(key), record.stats);
+
+				rows.push_back({ &record,
+					static_cast< double >(diff.acquisitions) / seconds, static_cast< double >(diff.contended) / seconds,
+					static_cast< double >(diff.spin_successes) / seconds, static_cast< double >(diff.futex_waits) / seconds,
+					static_cast< double >(diff.futex_wakes) / seconds, static_cast< double >(diff.spurious_wakeups) / seconds,
+					percentile(diff.wait_ns, 0.5), percentile(diff.wait_ns, 0.99),
+					percentile(diff.hold_ns, 0.5), percentile(diff.hold_ns, 0.99) });
+			}
+			previous.swap(current);
+			print(opts, rows, records.size(), seconds);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "lock_top: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}